@@ -9,7 +9,11 @@
 #include "definitions.hpp"
 #include "rle_string.hpp"
 #include "sparse_sd_vector.hpp"
+#include "bwt_construction.hpp"
 #include "permuted_lcp.hpp"
+#include "sequence_boundaries.hpp"
+#include "interleaved_lcp.hpp"
+#include "query_stats.hpp"
 #include "utils.hpp"
 
 namespace bri {
@@ -84,257 +88,42 @@ public:
      * \param input: string on which br-index is built
      * \param sais: flag determining if we use SAIS for suffix sort. 
      *              otherwise we use divsufsort
+     * \param threads: with more than one thread, the structures of text and
+     *                 textR are built concurrently
+     * \param pfp: build BWT and SA samples from the prefix-free parses of
+     *             text and textR instead of their suffix arrays
      */
-    br_index(std::string const& input, bool sais = true)
-    {
-        
-        this->sais = sais;
-
-        if (input.size() < 1)
-        {
-
-            std::cout << "Error: input string is empty" << std::endl;
-            exit(1);
-
-        }
-
-        std::cout << "Text length = " << input.size() << std::endl << std::endl;
-
-        std::cout << "(1/4) Remapping alphabet ... " << std::flush;
-        
-        // build RLBWT
-
-        // configure & build indexes for sufsort & plcp
-        sdsl::cache_config cc;
-
-        // remap alphabet
-        remap = std::vector<uchar>(256,0);
-        remap_inv = std::vector<uchar>(256,0);
-        {
-            sigma = 1;
-            std::vector<ulint> freqs(256,0);
-            for (size_t i = 0; i < input.size(); ++i)
-            {
-                if (freqs[(uchar)input[i]]++ == 0) sigma++;
-                if (sigma >= 255)
-                {
-                    std::cout << "Error: alphabet cannot be remapped (overflow)" << std::endl;
-                    exit(1);
-                }
-            }
-            uchar new_c = 2; // avoid reserved chars
-            for (ulint c = 2; c < 256; ++c)
-            {
-                if (freqs[(uchar)c] != 0)
-                {
-                    remap[(uchar)c] = new_c;
-                    remap_inv[new_c++] = (uchar)c;
-                }
-            }
-        }
-
-        std::cout << "done." << std::endl;
-        std::cout << "(2/4) Building BWT, BWT^R, PLCP and computing SA samples";
-        if (sais) std::cout << " (SA-SAIS) ... " << std::flush;
-        else std::cout << " (DIVSUFSORT) ... " << std::flush;
-
-        // remap input text
-        sdsl::int_vector<8> text(input.size());
-        for (size_t i = 0; i < input.size(); ++i)
-            text[i] = remap[(uchar)input[i]];
-
-        sdsl::append_zero_symbol(text);
-
-        // cache text
-        sdsl::store_to_cache(text, sdsl::conf::KEY_TEXT, cc);
-        sdsl::construct_config::byte_algo_sa = sais ? sdsl::SE_SAIS : sdsl::LIBDIVSUFSORT;
-        
-        // cache SA
-        sdsl::construct_sa<8>(cc);
-        // cache ISA 
-        sdsl::construct_isa(cc);
-
-        
-        sdsl::int_vector_buffer<> sa(sdsl::cache_file_name(sdsl::conf::KEY_SA, cc));
-        last_SA_val = sa[sa.size()-1];
-        auto bwt_and_samples = sufsort(text,sa);
-
-        plcp = permuted_lcp<>(cc);
-
-        // remove cache of text and SA
-        sdsl::remove(sdsl::cache_file_name(sdsl::conf::KEY_TEXT, cc));
-        sdsl::remove(sdsl::cache_file_name(sdsl::conf::KEY_SA, cc));
-        sdsl::remove(sdsl::cache_file_name(sdsl::conf::KEY_ISA, cc));
-
-
-
-
-        // configure & build reversed indexes for sufsort
-        sdsl::cache_config ccR;
-
-        sdsl::int_vector<8> textR(input.size());
-        for (ulint i = 0; i < input.size(); ++i)
-            textR[i] = remap[(uchar)input[input.size()-1-i]];
-
-        sdsl::append_zero_symbol(textR);
-
-        // cache textR
-        sdsl::store_to_cache(textR, sdsl::conf::KEY_TEXT, ccR);
-        sdsl::construct_config::byte_algo_sa = sais ? sdsl::SE_SAIS : sdsl::LIBDIVSUFSORT;
-        
-        // cache SAR
-        sdsl::construct_sa<8>(ccR);
-        // cache ISAR
-        //sdsl::construct_isa(ccR);
+    br_index(std::string const& input, bool sais = true, ulint threads = 1, bool pfp = false)
+        : br_index(input, build_config(sais, threads, pfp)) {}
 
-        sdsl::int_vector_buffer<> saR(sdsl::cache_file_name(sdsl::conf::KEY_SA, ccR));
-        auto bwt_and_samplesR = sufsort(textR,saR);
-
-        // plcp is not needed in the reversed case
-
-        // remove cache of textR and SAR
-        sdsl::remove(sdsl::cache_file_name(sdsl::conf::KEY_TEXT, ccR));
-        sdsl::remove(sdsl::cache_file_name(sdsl::conf::KEY_SA, ccR));
-
-
-
-
-
-        std::string& bwt_s = std::get<0>(bwt_and_samples);
-        std::vector<range_t>& samples_first_vec = std::get<1>(bwt_and_samples);
-        std::vector<range_t>& samples_last_vec = std::get<2>(bwt_and_samples);
-
-        std::string& bwt_sR = std::get<0>(bwt_and_samplesR);
-        std::vector<range_t>& samples_first_vecR = std::get<1>(bwt_and_samplesR);
-        std::vector<range_t>& samples_last_vecR = std::get<2>(bwt_and_samplesR);
-
-        std::cout << "done.\n(3/4) Run-length encoding BWT ... " << std::flush;
-
-
-        // run length compression on BWT and BWTR
-        bwt = rle_string_t(bwt_s);
-        bwtR = rle_string_t(bwt_sR);
-
-        // build F column (common between text and textR)
-        F = std::vector<ulint>(256,0);
-
-        for (uchar c : bwt_s) 
-            F[c]++;
-
-        for (ulint i = 255; i > 0; --i) 
-            F[i] = F[i-1];
-
-        F[0] = 0;
-
-        for(ulint i = 1; i < 256; ++i) 
-            F[i] += F[i-1];
-
-
-        // remember BWT position of terminator
-		for(ulint i = 0; i < bwt_s.size(); ++i)
-			if(bwt_s[i]==TERMINATOR)
-				terminator_position = i;
-        
-        for(ulint i = 0; i < bwt_sR.size(); ++i)
-			if(bwt_sR[i]==TERMINATOR)
-				terminator_positionR = i;
-
-        assert(input.size() + 1 == bwt.size());
-
-        std::cout << "done." << std::endl << std::endl;
-
-
-        r = bwt.number_of_runs();
-        rR = bwtR.number_of_runs();
-
-        assert(samples_first_vec.size() == r);
-        assert(samples_last_vec.size() == r);
-
-        assert(samples_first_vecR.size() == rR);
-        assert(samples_last_vecR.size() == rR);
-
-        int log_r = bitsize(r);
-        int log_rR = bitsize(rR);
-        int log_n = bitsize(bwt.size());
-
-        std::cout << "Number of BWT equal-letter runs: r = " << r << std::endl;
-		std::cout << "Rate n/r = " << double(bwt.size())/r << std::endl;
-		std::cout << "log2(r) = " << std::log2(double(r)) << std::endl;
-		std::cout << "log2(n/r) = " << std::log2(double(bwt.size())/r) << std::endl;
-
-        std::cout << "Number of BWT^R equal-letter runs: rR = " << rR << std::endl << std::endl;
-
-        // Phi, Phi inverse is needed only in forward case
-        std::cout << "(4/4) Building predecessor for toehold lemma & Phi/Phi^{-1} function ..." << std::flush;
-
-        
-        samples_last = sdsl::int_vector<>(r,0,log_n);
-        samples_first = sdsl::int_vector<>(r,0,log_n);
-        
-        samples_firstR = sdsl::int_vector<>(rR,0,log_n);
-        samples_lastR = sdsl::int_vector<>(rR,0,log_n);
-
-        for (ulint i = 0; i < r; ++i)
-        {
-            samples_last[i] = samples_last_vec[i].first;
-            samples_first[i] = samples_first_vec[i].first;
-        }
-        for (ulint i = 0; i < rR; ++i)
-        {
-            samples_lastR[i] = samples_last_vecR[i].first;
-            samples_firstR[i] = samples_first_vecR[i].first;
-        }
-
-        // sort samples of first positions in runs according to text position
-        std::sort(samples_first_vec.begin(), samples_first_vec.end());
-        // sort samples of last positions in runs according to text position
-        std::sort(samples_last_vec.begin(), samples_last_vec.end());
-
-        // build Elias-Fano predecessor
-        {
-            std::vector<bool> first_bv(bwt_s.size(),false);
-            for (auto p: samples_first_vec)
-            {
-                assert(p.first < first_bv.size());
-                first_bv[p.first] = true;
-            }
-            first = sparse_bitvector_t(first_bv);
-        }
-        {
-            std::vector<bool> last_bv(bwt_s.size(),false);
-            for (auto p: samples_last_vec)
-            {
-                assert(p.first < last_bv.size());
-                last_bv[p.first] = true;
-            }
-            last = sparse_bitvector_t(last_bv);
-        }
-
-        assert(first.rank(first.size()) == r);
-        assert(last.rank(last.size()) == r);
-
-        first_to_run = sdsl::int_vector<>(r,0,log_r);
-
-        last_to_run = sdsl::int_vector<>(r,0,log_r);
-
-        // construct first_to_run
-        for (ulint i = 0; i < samples_first_vec.size(); ++i)
-        {
-            first_to_run[i] = samples_first_vec[i].second;
-        }
-
-        // construct last_to_run
-        for (ulint i = 0; i < samples_last_vec.size(); ++i)
-        {
-            last_to_run[i] = samples_last_vec[i].second;
-        }
-
-        // release ISA cache
-        //sdsl::remove(sdsl::cache_file_name(sdsl::conf::KEY_ISA, cc));
-        //sdsl::remove(sdsl::cache_file_name(sdsl::conf::KEY_ISA, ccR));
+    /*
+     * constructor with the options of build_config, which also sets the
+     * suffix sorting backend, the directory of the temporary files and the
+     * RAM budget
+     */
+    br_index(std::string const& input, build_config config)
+    {
+        bwt_construction bc(input, config, false);
+        build(input, bc);
+        bc.report.print();
+    }
 
-        std::cout << " done. " << std::endl << std::endl;
+    /*
+     * constructor from the steps shared with br_index_nplcp (bri-build -both).
+     * bc is left usable for building the other index
+     */
+    br_index(std::string const& input, bwt_construction& bc)
+    {
+        build(input, bc);
+    }
 
+    /*
+     * constructor from the steps of bwt_merge, which knows the PLCP values:
+     * the text is not needed
+     */
+    br_index(bwt_construction& bc)
+    {
+        build(std::string(), bc);
     }
 
     /*
@@ -352,6 +141,7 @@ public:
      */
     range_t LF(range_t rn, uchar c)
     {
+        BRI_COUNT(lf_calls);
 
         if ((c == 255 && F[c] == bwt.size()) || F[c] >= F[c+1]) return {1,0};
 
@@ -374,6 +164,7 @@ public:
      */
     range_t LFR(range_t rn, uchar c)
     {
+        BRI_COUNT(lf_calls);
 
         if ((c == 255 && F[c] == bwt.size()) || F[c] >= F[c+1]) return {1,0};
 
@@ -395,6 +186,7 @@ public:
      */
     ulint Phi(ulint i)
     {
+        BRI_COUNT(phi_calls);
         assert(i != bwt.size() - 1);
 
         ulint jr = first.predecessor_rank_circular(i);
@@ -415,12 +207,36 @@ public:
 
         return (prev_sample + delta) % bwt.size();
     }
+    /*
+     * Phi, also updating doc to the document of the result
+     */
+    ulint Phi(ulint i, ulint& doc)
+    {
+        BRI_COUNT(phi_calls);
+        assert(i != bwt.size() - 1);
+
+        ulint jr = first.predecessor_rank_circular(i);
+        ulint k = first.select(jr);
+
+        // distance from predecessor
+        ulint delta = k < i ? i - k : i + 1;
+
+        assert(first_to_run[jr] > 0);
+
+        ulint run = first_to_run[jr]-1;
+        ulint prev_sample = samples_last[run];
+        ulint res = (prev_sample + delta) % bwt.size();
+
+        doc = shifted_document(docs_last[run],prev_sample,res);
+        return res;
+    }
     /*
      * Phi inverse
      * get SA[i] from SA[i-1]
      */
     ulint PhiI(ulint i)
     {
+        BRI_COUNT(phi_calls);
         assert(i != last_SA_val);
 
         ulint jr = last.predecessor_rank_circular(i);
@@ -442,14 +258,40 @@ public:
         return (prev_sample + delta) % bwt.size();
     }
 
+    /*
+     * Phi inverse, also updating doc to the document of the result
+     */
+    ulint PhiI(ulint i, ulint& doc)
+    {
+        BRI_COUNT(phi_calls);
+        assert(i != last_SA_val);
+
+        ulint jr = last.predecessor_rank_circular(i);
+        ulint k = last.select(jr);
+
+        // distance from predecessor
+        ulint delta = k < i ? i - k : i + 1;
+
+        assert(last_to_run[jr] < r-1);
+
+        ulint run = last_to_run[jr]+1;
+        ulint prev_sample = samples_first[run];
+        ulint res = (prev_sample + delta) % bwt.size();
+
+        doc = shifted_document(docs_first[run],prev_sample,res);
+        return res;
+    }
+
     ulint LF(ulint i)
     {
+        BRI_COUNT(lf_calls);
         auto c = bwt[i];
         return F[c] + bwt.rank(i,c);
     }
 
     ulint LFR(ulint i)
     {
+        BRI_COUNT(lf_calls);
         auto c = bwtR[i];
         return F[c] + bwtR.rank(i,c);
     }
@@ -516,6 +358,51 @@ public:
 
     }
 
+    /*
+     * characters of the text, terminator excluded, in increasing order
+     */
+    std::string alphabet()
+    {
+        std::string res;
+        for (ulint c = TERMINATOR + 1; c < 256; ++c)
+            if (F[c] < (c < 255 ? F[c+1] : bwt_size())) res.push_back((char)remap_inv[c]);
+        return res;
+    }
+
+    /*
+     * BWT^R ranges of Pc for every character c following P, from the BWT^R
+     * range of P (all-symbol LF): a single interval_symbols on BWT^R
+     * instead of a rank pair per character. res gets the pairs (c, range
+     * of Pc) in increasing order of c, terminator excluded
+     */
+    void right_ranges(range_t rangeR, std::vector<std::pair<uchar,range_t> >& res)
+    {
+        BRI_COUNT(lf_calls);
+        res.clear();
+        if (rangeR.first > rangeR.second) return;
+
+        // per thread, since the index is shared by the threads of bri-kmers
+        static thread_local std::vector<uchar> cs;
+        static thread_local std::vector<ulint> rank_i, rank_j;
+
+        ulint k = bwtR.interval_symbols(rangeR.first,rangeR.second+1,cs,rank_i,rank_j);
+        for (ulint t = 0; t < k; ++t)
+        {
+            uchar c = cs[t];
+            if (c == TERMINATOR) continue;
+            res.push_back({remap_inv[c],{F[c]+rank_i[t],F[c]+rank_j[t]-1}});
+        }
+
+        // interval_symbols returns the symbols in the order of the leaves of
+        // the (Huffman shaped) wavelet tree, not by code. the remapping keeps
+        // the order of the characters, so sorting by the original character
+        // is sorting by code
+        std::sort(res.begin(),res.end(),[](std::pair<uchar,range_t> const& a, std::pair<uchar,range_t> const& b)
+        {
+            return a.first < b.first;
+        });
+    }
+
     /*
      * get a sample corresponding to an empty string
      */
@@ -777,6 +664,107 @@ public:
 		return res;
     }
 
+    /*
+     * locate occurrences of current pattern P with their BWT row,
+     * as (text position, row) pairs in increasing order of row
+     */
+    std::vector<std::pair<ulint,ulint> > locate_rows(br_sample const& sample)
+    {
+        assert(sample.j >= sample.d);
+
+        ulint sa = sample.j - sample.d;
+        ulint pos = sa;
+
+        // the rows before the one of the sample, from the closest
+        std::vector<ulint> before;
+        while (plcp[pos] >= sample.len)
+        {
+            pos = Phi(pos);
+            before.push_back(pos);
+        }
+
+        std::vector<std::pair<ulint,ulint> > res;
+        res.reserve(sample.range.second + 1 - sample.range.first);
+
+        ulint row = sample.range.first;
+        for (ulint k = before.size(); k-- > 0; ) res.push_back({before[k],row++});
+        res.push_back({sa,row++});
+
+        pos = sa;
+        while (pos != last_SA_val)
+        {
+            pos = PhiI(pos);
+            if (plcp[pos] < sample.len) break;
+            res.push_back({pos,row++});
+        }
+
+        return res;
+    }
+
+    /*
+     * list the distinct documents containing the current pattern P,
+     * in increasing order. documents are the sequences of an index built
+     * from FASTA, otherwise the whole text is document 0.
+     *
+     * only the first occurrence in the SA range of each document is
+     * visited: the rows of the runs of ILCP below |P| (interleaved_lcp.hpp),
+     * by Phi from the sample of their run, the document of each coming from
+     * the per-run document samples. the time is proportional to the number
+     * of documents listed, not to the number of occurrences.
+     */
+    std::vector<ulint> list_documents_sample(br_sample const& sample)
+    {
+        std::unordered_set<ulint> seen;
+        std::vector<ulint> res;
+        collect_documents(sample,seen,res);
+        std::sort(res.begin(),res.end());
+        return res;
+    }
+
+    std::vector<ulint> list_documents_samples(std::unordered_map<range_t,br_sample,range_hash> const& samples)
+    {
+        std::unordered_set<ulint> seen;
+        std::vector<ulint> res;
+        for (auto it = samples.begin(); it != samples.end() && res.size() < number_of_documents(); ++it)
+        {
+            collect_documents(it->second,seen,res);
+        }
+        std::sort(res.begin(),res.end());
+        return res;
+    }
+
+    ulint count_documents_sample(br_sample const& sample)
+    {
+        return list_documents_sample(sample).size();
+    }
+
+    ulint count_documents_samples(std::unordered_map<range_t,br_sample,range_hash> const& samples)
+    {
+        return list_documents_samples(samples).size();
+    }
+
+    /*
+     * list the documents containing a given pattern
+     */
+    std::vector<ulint> list_documents(std::string const& pattern)
+    {
+        br_sample sample(get_initial_sample());
+        for (size_t i = 0; i < pattern.size(); ++i)
+        {
+            sample = left_extension(pattern[pattern.size()-1-i],sample);
+            if (sample.is_invalid()) return {};
+        }
+        return list_documents_sample(sample);
+    }
+
+    /*
+     * count the documents containing a given pattern
+     */
+    ulint count_documents(std::string const& pattern)
+    {
+        return list_documents(pattern).size();
+    }
+
     /*
      * count the number of a given pattern
      */
@@ -831,6 +819,90 @@ public:
         }
     }
 
+    /*
+     * search a batch of patterns backward, sharing the extensions of their
+     * common suffixes (e.g. all the k-mers of a panel): the patterns are
+     * visited in the order of their reversed strings, keeping the samples of
+     * every suffix of the previous pattern, so that a pattern only extends
+     * the sample of the longest suffix it shares with the previous one.
+     *
+     * returns a sample per pattern, in input order, invalid if the pattern
+     * does not occur. full: samples of left_extension, as backward_search
+     * (for locate_sample and extensions in both directions); otherwise of
+     * left_only, as count and locate (for count_sample and
+     * locate_sample_backward only)
+     */
+    std::vector<br_sample> search_batch(std::vector<std::string> const& patterns, bool full=true)
+    {
+        std::vector<ulint> order(patterns.size());
+        for (ulint i = 0; i < order.size(); ++i) order[i] = i;
+
+        // the order of the reversed patterns
+        std::sort(order.begin(), order.end(), [&](ulint a, ulint b)
+        {
+            return std::lexicographical_compare(patterns[a].rbegin(), patterns[a].rend(),
+                                                patterns[b].rbegin(), patterns[b].rend());
+        });
+
+        std::vector<br_sample> res(patterns.size());
+
+        // path[k]: sample of the suffix of length k of the previous pattern,
+        // as long as it occurs
+        std::vector<br_sample> path(1, get_initial_sample());
+        std::string const* prev = nullptr;
+
+        for (ulint i: order)
+        {
+            std::string const& p = patterns[i];
+            ulint m = p.size();
+
+            // longest common suffix with the previous pattern
+            ulint l = 0;
+            if (prev != nullptr)
+                while (l < m && l < prev->size() && p[m-1-l] == (*prev)[prev->size()-1-l]) ++l;
+            if (path.size() > l + 1) path.resize(l + 1);
+            prev = &p;
+
+            while (path.size() <= m)
+            {
+                uchar c = p[m - path.size()];
+                br_sample sample(full ? left_extension(c,path.back()) : left_only(c,path.back()));
+                if (sample.is_invalid()) break;
+                path.push_back(sample);
+            }
+
+            if (path.size() == m + 1) res[i] = path.back();
+            else res[i].range = {1,0};
+        }
+        return res;
+    }
+
+    /*
+     * count of each pattern of a batch, as count (see search_batch)
+     */
+    std::vector<ulint> count_batch(std::vector<std::string> const& patterns)
+    {
+        auto samples = search_batch(patterns,false);
+
+        std::vector<ulint> res(samples.size(),0);
+        for (ulint i = 0; i < samples.size(); ++i)
+            if (!samples[i].is_invalid()) res[i] = count_sample(samples[i]);
+        return res;
+    }
+
+    /*
+     * occurrences of each pattern of a batch, as locate (see search_batch)
+     */
+    std::vector<std::vector<ulint>> locate_batch(std::vector<std::string> const& patterns)
+    {
+        auto samples = search_batch(patterns,false);
+
+        std::vector<std::vector<ulint>> res(samples.size());
+        for (ulint i = 0; i < samples.size(); ++i)
+            if (!samples[i].is_invalid()) res[i] = locate_sample_backward(samples[i]);
+        return res;
+    }
+
     ulint count_with_mismatch(std::string const& pattern, ulint allowed_mis=0)
     {
         auto samples = search_with_mismatch(pattern,allowed_mis);
@@ -858,6 +930,7 @@ public:
         {
             br_sample sample(backward_search(pattern,0,m-1,init_sample));
             if (sample.is_invalid()) return res;
+            BRI_COUNT(hash_inserts);
             res[sample.range] = sample;
             return res;
         }
@@ -899,6 +972,8 @@ public:
     void backward_dfs(std::unordered_map<range_t,br_sample,range_hash>& res, std::string const& pattern,
                     ulint m, ulint allowed_mis, ulint left_pos, ulint right_pos, ulint mis, br_sample prev_sample)
     {
+        BRI_COUNT(dfs_nodes);
+
         uchar c = remap[pattern[left_pos]];
 
         //std::cout << mis << " " << allowed_mis << "  ";
@@ -910,7 +985,11 @@ public:
             br_sample sample(prev_sample);
 
             sample.range = LF(prev_sample.range,c);
-            if (sample.is_invalid()) return;
+            if (sample.is_invalid())
+            {
+                BRI_COUNT(dfs_pruned);
+                return;
+            }
 
             if (sample.range.second - sample.range.first == 
                 prev_sample.range.second - prev_sample.range.first)
@@ -940,6 +1019,7 @@ public:
 
             if (left_pos == 0)
             {
+                BRI_COUNT(hash_inserts);
                 res[sample.range] = sample;
             }
             else 
@@ -957,11 +1037,22 @@ public:
                 br_sample sample(prev_sample);
 
                 sample.range = LF(prev_sample.range,(uchar)a);
-                if (sample.is_invalid()) continue;
+                if (sample.is_invalid())
+                {
+                    BRI_COUNT(dfs_pruned);
+                    continue;
+                }
+
+                if (a == 1)
+                {
+                    acc++;
+                    continue;
+                }
 
-                if (a == 1)
+                // substitutions never run across two sequences
+                if (a == separator)
                 {
-                    acc++;
+                    acc += sample.range.second + 1 - sample.range.first;
                     continue;
                 }
                 
@@ -990,6 +1081,7 @@ public:
                 {
                     if (left_pos == 0)
                     {
+                        BRI_COUNT(hash_inserts);
                         res[sample.range] = sample;
                     }
                     else 
@@ -1001,6 +1093,7 @@ public:
                 {
                     if (left_pos == 0)
                     {
+                        BRI_COUNT(hash_inserts);
                         res[sample.range] = sample;
                     }
                     else
@@ -1015,6 +1108,8 @@ public:
     void forward_dfs(std::unordered_map<range_t,br_sample,range_hash>& res, std::string const& pattern,
                     ulint m, ulint allowed_mis, ulint left_pos, ulint right_pos, ulint mis, br_sample prev_sample)
     {
+        BRI_COUNT(dfs_nodes);
+
         uchar c = remap[pattern[right_pos]];
 
         if (mis == allowed_mis)
@@ -1024,7 +1119,11 @@ public:
             br_sample sample(prev_sample);
 
             sample.rangeR = LFR(prev_sample.rangeR,c);
-            if (sample.is_invalid()) return;
+            if (sample.is_invalid())
+            {
+                BRI_COUNT(dfs_pruned);
+                return;
+            }
 
 
             if (sample.rangeR.second - sample.rangeR.first != 
@@ -1051,6 +1150,7 @@ public:
 
             if (left_pos == 0 && right_pos >= m - 1)
             {
+                BRI_COUNT(hash_inserts);
                 res[sample.range] = sample;
             }
             else if (right_pos >= m-1)
@@ -1071,13 +1171,24 @@ public:
                 br_sample sample(prev_sample);
 
                 sample.rangeR = LFR(prev_sample.rangeR,(uchar)a);
-                if (sample.is_invalid()) continue;
+                if (sample.is_invalid())
+                {
+                    BRI_COUNT(dfs_pruned);
+                    continue;
+                }
 
                 if (a == 1)
                 {
                     acc++;
                     continue;
                 }
+
+                // substitutions never run across two sequences
+                if (a == separator)
+                {
+                    acc += sample.rangeR.second + 1 - sample.rangeR.first;
+                    continue;
+                }
                 
                 if (sample.rangeR.second - sample.rangeR.first != 
                     prev_sample.rangeR.second - prev_sample.rangeR.first)
@@ -1100,6 +1211,7 @@ public:
                 {
                     if (left_pos == 0 && right_pos >= m - 1)
                     {
+                        BRI_COUNT(hash_inserts);
                         res[sample.range] = sample;
                     }
                     else if (right_pos >= m - 1)
@@ -1115,6 +1227,7 @@ public:
                 {
                     if (left_pos == 0 && right_pos >= m - 1)
                     {
+                        BRI_COUNT(hash_inserts);
                         res[sample.range] = sample;
                     }
                     else if (right_pos >= m - 1)
@@ -1157,6 +1270,42 @@ public:
         return terminator_positionR;
     }
 
+    /*
+     * get the last len characters of the indexed text (all of it by
+     * default), by LF from the row of the terminator suffix
+     */
+    std::string get_text(ulint len = -1)
+    {
+        std::string res(std::min(len,text_size()),0);
+        ulint row = 0;
+        for (ulint k = res.size(); k > 0; --k)
+        {
+            uchar c = bwt[row];
+            res[k-1] = remap_inv[c];
+            row = F[c] + bwt.rank(row,c);
+        }
+        return res;
+    }
+
+    /*
+     * get the (at most) len characters of the text preceding the suffix of
+     * BWT row i, by LF, or with forward its first len characters, by FL.
+     * stops at the start (end) of the text
+     */
+    std::string extract(ulint i, ulint len, bool forward = false)
+    {
+        std::string res;
+        for (; res.size() < len; )
+        {
+            uchar c = forward ? F_at(i) : bwt[i];
+            if (c == TERMINATOR) break;
+            res.push_back(remap_inv[c]);
+            i = forward ? FL(i) : LF(i);
+        }
+        if (!forward) std::reverse(res.begin(),res.end());
+        return res;
+    }
+
     /*
      * get string representation of BWT
      */
@@ -1215,6 +1364,14 @@ public:
 
         w_bytes += plcp.serialize(out);
 
+        w_bytes += sequences.serialize(out);
+        if (sequences.size() > 0)
+        {
+            w_bytes += docs_first.serialize(out);
+            w_bytes += docs_last.serialize(out);
+            w_bytes += ilcp.serialize(out);
+        }
+
         return w_bytes;
     
     }
@@ -1255,6 +1412,15 @@ public:
 
         plcp.load(in);
 
+        sequences.load(in);
+        separator = sequences.size() > 0 ? remap[SEQUENCE_SEPARATOR] : 0;
+        if (sequences.size() > 0)
+        {
+            docs_first.load(in);
+            docs_last.load(in);
+            ilcp.load(in);
+        }
+
     }
 
     /*
@@ -1285,6 +1451,55 @@ public:
 
     ulint text_size() { return bwt.size() - 1; }
 
+    /*
+     * store the start positions and names of the sequences concatenated
+     * in the text, separated by SEQUENCE_SEPARATOR (FASTA mode of bri-build)
+     */
+    void set_sequences(std::vector<ulint> const& starts, std::vector<std::string> const& names)
+    {
+        set_documents(starts,names);
+
+        // ILCP from the rows in SA order, by Phi^-1 from the terminator suffix
+        ulint sa = text_size();
+        ilcp = interleaved_lcp<sparse_bitvector_t>(bwt.size(), sequences.size(), [&](ulint& s, ulint& lcp, ulint& doc)
+        {
+            s = sa;
+            lcp = plcp[sa];
+            doc = document_of(sa);
+            if (sa != last_SA_val) sa = PhiI(sa);
+        });
+    }
+
+    /*
+     * as above, for the index built from bc by bwt_merge, which merged the
+     * ILCP runs: O(r) instead of a visit of the n rows
+     */
+    void set_sequences(std::vector<ulint> const& starts, std::vector<std::string> const& names, bwt_construction const& bc)
+    {
+        set_documents(starts,names);
+        ilcp = interleaved_lcp<sparse_bitvector_t>(bwt.size(), bc.ilcp_heads, bc.ilcp_values, bc.ilcp_samples);
+    }
+
+    /*
+     * number of sequences in the text (0 if not built from FASTA)
+     */
+    ulint number_of_sequences() { return sequences.size(); }
+
+    /*
+     * number of documents listed by list_documents
+     */
+    ulint number_of_documents() { return sequences.size() > 0 ? sequences.size() : 1; }
+
+    /*
+     * (sequence id, offset in the sequence) of text position i
+     * (0,i) if the text was not built from FASTA
+     */
+    std::pair<ulint,ulint> sequence_position(ulint i) { return sequences.to_sequence_position(i); }
+
+    std::string const& sequence_name(ulint id) { return sequences.name(id); }
+
+    ulint sequence_start(ulint id) { return sequences.start(id); }
+
     ulint bwt_size(bool reversed=false) { return bwt.size(); }
 
     uchar get_terminator() {
@@ -1292,75 +1507,94 @@ public:
     }
 
     /*
-     * get statistics
+     * space of the components, in the order they are serialized
      */
-    ulint print_space() 
+    space_node space_tree(std::string const& name = "br_index") const
     {
+        space_node res(name, sizeof(sigma)
+                           + 256*sizeof(uchar)
+                           + 256*sizeof(uchar)
+                           + sizeof(terminator_position)
+                           + sizeof(terminator_positionR)
+                           + sizeof(last_SA_val)
+                           + 256*sizeof(ulint));
 
-        std::cout << "text length           : " << bwt.size() << std::endl;
-        std::cout << "alphabet size         : " << sigma << std::endl;
-        std::cout << "number of runs in bwt : " << bwt.number_of_runs() << std::endl;
-        std::cout << "numbef of runs in bwtR: " << bwtR.number_of_runs() << std::endl << std::endl;
-        
-        ulint tot_bytes = sizeof(sigma)
-                        + 256*sizeof(uchar)
-                        + 256*sizeof(uchar)
-                        + sizeof(terminator_position)
-                        + sizeof(terminator_positionR)
-                        + sizeof(last_SA_val)
-                        + 256*sizeof(ulint);
-        
-        tot_bytes += bwt.print_space();
-        tot_bytes += bwtR.print_space();
-        std::cout << "total space for BWT: " << tot_bytes << " bytes" << std::endl << std::endl;
-
-        tot_bytes += plcp.print_space();
-
-        std::ofstream out("/dev/null");
+        res.add(bwt.space_tree("bwt"));
+        res.add(bwtR.space_tree("bwtR"));
 
-        ulint bytes = 0;
+        res.add(space_node::of("samples_first", samples_first));
+        res.add(space_node::of("samples_last", samples_last));
 
-        
-        bytes =  samples_first.serialize(out);
-        tot_bytes += bytes;
-        std::cout << "samples_first: " << bytes << " bytes" << std::endl;
+        res.add(first.space_tree("first"));
+        res.add(space_node::of("first_to_run", first_to_run));
 
-        bytes =  samples_last.serialize(out);
-        tot_bytes += bytes;
-        std::cout << "samples_last: " << bytes << " bytes" << std::endl;
+        res.add(last.space_tree("last"));
+        res.add(space_node::of("last_to_run", last_to_run));
 
+        res.add(space_node::of("samples_firstR", samples_firstR));
+        res.add(space_node::of("samples_lastR", samples_lastR));
 
-        bytes =  first.serialize(out);
-        tot_bytes += bytes;
-        std::cout << "first: " << bytes << " bytes" << std::endl;
+        res.add(plcp.space_tree("plcp"));
 
-        bytes =  first_to_run.serialize(out);
-        tot_bytes += bytes;
-        std::cout << "first_to_run: " << bytes << " bytes" << std::endl;
+        res.add(sequences.space_tree("sequences"));
+        if (sequences.size() > 0)
+        {
+            res.add(space_node::of("docs_first", docs_first));
+            res.add(space_node::of("docs_last", docs_last));
+            res.add(ilcp.space_tree("ilcp"));
+        }
 
+        return res;
+    }
 
-        bytes =  last.serialize(out);
-        tot_bytes += bytes;
-        std::cout << "last: " << bytes << " bytes" << std::endl;
+    ulint size_in_bytes() const
+    {
+        return space_tree().bytes;
+    }
 
-        bytes =  last_to_run.serialize(out);
-        tot_bytes += bytes;
-        std::cout << "last_to_run: " << bytes << " bytes" << std::endl;
+    /*
+     * get statistics
+     */
+    ulint print_space() 
+    {
 
+        std::cout << "text length           : " << bwt.size() << std::endl;
+        std::cout << "alphabet size         : " << sigma << std::endl;
+        std::cout << "number of runs in bwt : " << bwt.number_of_runs() << std::endl;
+        std::cout << "numbef of runs in bwtR: " << bwtR.number_of_runs() << std::endl << std::endl;
 
-        bytes =  samples_firstR.serialize(out);
-        tot_bytes += bytes;
-        std::cout << "samples_firstR: " << bytes << " bytes" << std::endl;
+        auto space = space_tree();
+        space.print(std::cout);
 
-        bytes =  samples_lastR.serialize(out);
-        tot_bytes += bytes;
-        std::cout << "samples_lastR: " << bytes << " bytes" << std::endl;
+        std::cout << std::endl << "<total space of br-index>: " << space.bytes << " bytes" << std::endl << std::endl;
+        std::cout << "<bits/symbol>            : " << (double) space.bytes * 8 / (double) bwt.size() << std::endl;
 
-        std::cout << "<total space of br-index>: " << tot_bytes << " bytes" << std::endl << std::endl;
-        std::cout << "<bits/symbol>            : " << (double) tot_bytes * 8 / (double) bwt.size() << std::endl;
+        return space.bytes;
 
-        return tot_bytes;
+    }
 
+    /*
+     * statistics and space of the components as a JSON object. bits per run
+     * are per run of the BWT
+     */
+    void write_space_json(std::ostream& out)
+    {
+        auto space = space_tree();
+        ulint runs = bwt.number_of_runs();
+
+        out << "{" << std::endl;
+        out << "\"text_length\": " << bwt.size() << "," << std::endl;
+        out << "\"alphabet_size\": " << sigma << "," << std::endl;
+        out << "\"runs\": " << runs << "," << std::endl;
+        out << "\"runsR\": " << bwtR.number_of_runs() << "," << std::endl;
+        out << "\"bytes\": " << space.bytes << "," << std::endl;
+        out << "\"bits_per_symbol\": " << (double) space.bytes * 8 / bwt.size() << "," << std::endl;
+        out << "\"bits_per_run\": " << (double) space.bytes * 8 / runs << "," << std::endl;
+        out << "\"support_bytes\": " << space.support_bytes << "," << std::endl;
+        out << "\"support_fraction\": " << (double) space.support_bytes / space.bytes << "," << std::endl;
+        out << "\"components\": ";
+        space.write_json(out);
+        out << std::endl << "}" << std::endl;
     }
 
     /*
@@ -1368,39 +1602,125 @@ public:
      */
     ulint get_space()
     {
+        return size_in_bytes();
+    }
+
+private:
+
+    friend class bwt_merge;
+    friend class index_bench;
+
+    /*
+     * sequences and documents of the run samples, for set_sequences
+     */
+    void set_documents(std::vector<ulint> const& starts, std::vector<std::string> const& names)
+    {
+        sequences = sequence_boundaries<sparse_bitvector_t>(starts,names,text_size());
+        separator = sequences.size() > 0 ? remap[SEQUENCE_SEPARATOR] : 0;
 
-        ulint tot_bytes = sizeof(sigma)
-                        + 256*sizeof(uchar)
-                        + 256*sizeof(uchar)
-                        + sizeof(terminator_position)
-                        + sizeof(terminator_positionR)
-                        + sizeof(last_SA_val)
-                        + 256*sizeof(ulint);
+        // documents of the run samples
+        int log_docs = bitsize(uint64_t(sequences.size()));
+        docs_first = sdsl::int_vector<>(r,0,log_docs);
+        docs_last = sdsl::int_vector<>(r,0,log_docs);
+        for (ulint i = 0; i < r; ++i)
+        {
+            docs_first[i] = document_of(samples_first[i]);
+            docs_last[i] = document_of(samples_last[i]);
+        }
+    }
+
+    /*
+     * document of text position i. the terminator belongs to the last one
+     */
+    ulint document_of(ulint i)
+    {
+        if (sequences.size() == 0) return 0;
+        if (i >= text_size()) return sequences.size() - 1;
+        return sequences.sequence_of(i);
+    }
+
+    /*
+     * document of pos = sample + delta, where sample lies in document doc:
+     * only the start of the next document is checked, unless pos wrapped
+     * around the terminator or moved past it
+     */
+    ulint shifted_document(ulint doc, ulint sample, ulint pos)
+    {
+        if (pos < sample) return document_of(pos);
+        if (doc + 1 >= sequences.size() || pos < sequences.start(doc+1)) return doc;
+        return document_of(pos);
+    }
 
-        tot_bytes += bwt.get_space();
-        tot_bytes += bwtR.get_space();
+    /*
+     * add the documents of the occurrences of sample not in seen to res
+     */
+    void collect_documents(br_sample const& sample, std::unordered_set<ulint>& seen, std::vector<ulint>& res)
+    {
+        ulint ndoc = number_of_documents();
 
-        tot_bytes += plcp.get_space();
+        if (sequences.size() == 0)
+        {
+            if (seen.insert(0).second) res.push_back(0);
+            return;
+        }
 
-        std::ofstream out("/dev/null");
+        auto add = [&](ulint doc) { if (seen.insert(doc).second) res.push_back(doc); };
 
-        tot_bytes += samples_first.serialize(out);
-        tot_bytes += samples_last.serialize(out);
+        ulint sp = sample.range.first;
+        ulint ep = sample.range.second;
+        ulint first_run = ilcp.run_of(sp);
+        ulint last_run = ilcp.run_of(ep);
 
-        tot_bytes += first.serialize(out);
-        tot_bytes += first_to_run.serialize(out);
+        if (first_run < last_run && sample.len > 0)
+        {
+            // ILCP[sp] < |P|, so the rows from sp to the end of its run are
+            // all listed: by Phi from the sample of the next run
+            ulint pos = ilcp.sample(first_run+1);
+            ulint doc;
+            for (ulint i = ilcp.head(first_run+1); i > sp; --i)
+            {
+                pos = Phi(pos,doc);
+                add(doc);
+            }
 
-        tot_bytes += last.serialize(out);
-        tot_bytes += last_to_run.serialize(out);
+            // then the rows of the next runs below |P|, by Phi^-1
+            ilcp.runs_below(first_run+1, last_run, sample.len, [&](ulint k)
+            {
+                pos = ilcp.sample(k);
+                doc = document_of(pos);
+                add(doc);
 
-        tot_bytes += samples_firstR.serialize(out);
-        tot_bytes += samples_lastR.serialize(out);
+                ulint end = k == last_run ? ep : ilcp.head(k+1) - 1;
+                for (ulint i = ilcp.head(k); i < end; ++i)
+                {
+                    pos = PhiI(pos,doc);
+                    add(doc);
+                }
+            });
+            return;
+        }
 
-        return tot_bytes;
+        // a single run of ILCP: every occurrence is in a distinct document
+        ulint sa = sample.j - sample.d;
+        ulint pos = sa;
+        ulint doc = document_of(sa);
 
-    }
+        add(doc);
 
-private:
+        while (res.size() < ndoc && plcp[pos] >= sample.len)
+        {
+            pos = Phi(pos,doc);
+            add(doc);
+        }
+        pos = sa;
+        while (res.size() < ndoc)
+        {
+            if (pos == last_SA_val) break;
+            pos = PhiI(pos,doc);
+            if (plcp[pos] < sample.len) break;
+            add(doc);
+        }
+    }
 
     /*
      * only updates range for SA
@@ -1529,83 +1849,184 @@ private:
     }
 
     /*
-     * builds BWT
+     * steps (3/4) and (4/4) of the construction
      */
-    std::tuple<std::string, std::vector<range_t>, std::vector<range_t> > 
-    sufsort(sdsl::int_vector<8>& text, sdsl::int_vector_buffer<>& sa)
+    void build(std::string const& input, bwt_construction& bc)
     {
-        std::string bwt_s;
-        std::vector<range_t> samples_first;
-        std::vector<range_t> samples_last;
+        remap = bc.remap;
+        remap_inv = bc.remap_inv;
+        sigma = bc.sigma;
+        last_SA_val = bc.last_SA_val;
+
+        std::launch policy = bc.threads > 1 ? std::launch::async : std::launch::deferred;
+
+        // samples of text are copied since they are sorted below
+        rle_string_builder& bwt_b = std::get<0>(bc.bwt_and_samples);
+        std::vector<range_t> samples_first_vec = std::get<1>(bc.bwt_and_samples);
+        std::vector<range_t> samples_last_vec = std::get<2>(bc.bwt_and_samples);
+
+        rle_string_builder& bwt_bR = std::get<0>(bc.bwt_and_samplesR);
+        std::vector<range_t> const& samples_first_vecR = std::get<1>(bc.bwt_and_samplesR);
+        std::vector<range_t> const& samples_last_vecR = std::get<2>(bc.bwt_and_samplesR);
+
+        ulint n = bwt_b.size();
+
+        std::cout << "(3/4) Building PLCP and run-length encoding BWT ... " << std::flush;
+
+        // PLCP from the text and the run samples, still in run order here.
+        // neither ISA nor LCP are needed
+        auto plcp_b = std::async(policy, [&]()
+        {
+            if (bc.plcp_irreducible.empty())
+                plcp = permuted_lcp<>(input,samples_first_vec,samples_last_vec);
+            else
+                plcp = permuted_lcp<>(n,bc.plcp_irreducible);
+        });
+
+
+        // run length compression on BWT and BWTR
+        auto rleR = std::async(policy, [&]()
+        {
+            bwtR = rle_string_t(bwt_bR);
+
+            terminator_positionR = bwtR.select(0,TERMINATOR);
+        });
+
+        bwt = rle_string_t(bwt_b);
+
+        // build F column (common between text and textR)
+        F = std::vector<ulint>(256,0);
+
+        for (ulint c = 0; c < 256; ++c) 
+            F[c] = bwt.rank(bwt.size(),(uchar)c);
+
+        for (ulint i = 255; i > 0; --i) 
+            F[i] = F[i-1];
+
+        F[0] = 0;
+
+        for(ulint i = 1; i < 256; ++i) 
+            F[i] += F[i-1];
+
+
+        // remember BWT position of terminator
+        terminator_position = bwt.select(0,TERMINATOR);
+
+        rleR.get();
+        plcp_b.get();
+
+        assert(n == bwt.size() && (input.empty() || input.size() + 1 == n));
+
+        bc.report.phase("(3/4) PLCP & run-length encoding");
+
+        std::cout << "done." << std::endl << std::endl;
+
+
+        r = bwt.number_of_runs();
+        rR = bwtR.number_of_runs();
+
+        assert(samples_first_vec.size() == r);
+        assert(samples_last_vec.size() == r);
+
+        assert(samples_first_vecR.size() == rR);
+        assert(samples_last_vecR.size() == rR);
+
+        int log_r = bitsize(r);
+        int log_rR = bitsize(rR);
+        int log_n = bitsize(bwt.size());
+
+        std::cout << "Number of BWT equal-letter runs: r = " << r << std::endl;
+		std::cout << "Rate n/r = " << double(bwt.size())/r << std::endl;
+		std::cout << "log2(r) = " << std::log2(double(r)) << std::endl;
+		std::cout << "log2(n/r) = " << std::log2(double(bwt.size())/r) << std::endl;
+
+        std::cout << "Number of BWT^R equal-letter runs: rR = " << rR << std::endl << std::endl;
+
+        // Phi, Phi inverse is needed only in forward case
+        std::cout << "(4/4) Building predecessor for toehold lemma & Phi/Phi^{-1} function ..." << std::flush;
 
+        
+        samples_last = sdsl::int_vector<>(r,0,log_n);
+        samples_first = sdsl::int_vector<>(r,0,log_n);
+        
+        samples_firstR = sdsl::int_vector<>(rR,0,log_n);
+        samples_lastR = sdsl::int_vector<>(rR,0,log_n);
+
+        for (ulint i = 0; i < r; ++i)
+        {
+            samples_last[i] = samples_last_vec[i].first;
+            samples_first[i] = samples_first_vec[i].first;
+        }
+        for (ulint i = 0; i < rR; ++i)
+        {
+            samples_lastR[i] = samples_last_vecR[i].first;
+            samples_firstR[i] = samples_first_vecR[i].first;
+        }
+
+        // the first and last samples are sorted and indexed independently
+        auto firsts = std::async(policy, [&]()
         {
-            for (ulint i = 0; i < sa.size(); ++i)
+            // sort samples of first positions in runs according to text position
+            std::sort(samples_first_vec.begin(), samples_first_vec.end());
+
+            // build Elias-Fano predecessor
+            std::vector<ulint> first_ones;
+            first_ones.reserve(samples_first_vec.size());
+            for (auto p: samples_first_vec)
             {
-                auto x = sa[i];
+                assert(p.first < bwt.size());
+                first_ones.push_back(p.first);
+            }
+            first = sparse_bitvector_t(first_ones,bwt.size());
 
-                assert(x <= text.size());
+            assert(first.rank(first.size()) == r);
 
-                if (x > 0) 
-                    bwt_s.push_back((uchar)text[x-1]);
-                else 
-                    bwt_s.push_back(TERMINATOR);
-                
-                // insert samples at beginnings of runs
-                if (i > 0)
-                {
-                    if (i==1 || (i>1 && bwt_s[i-1] != bwt_s[i-2]))
-                    {
-                        samples_first.push_back({
-                            sa[i-1] > 0
-                            ? sa[i-1] - 1
-                            : sa.size() - 1,
-                            samples_first.size()
-                        });
-                    }
-                    if (i==sa.size()-1 && bwt_s[i] != bwt_s[i-1])
-                    {
-                        samples_first.push_back({
-                            sa[i] > 0
-                            ? sa[i] - 1
-                            : sa.size() - 1,
-                            samples_first.size()
-                        });
-                    }
-                }
+            // construct first_to_run
+            first_to_run = sdsl::int_vector<>(r,0,log_r);
+            for (ulint i = 0; i < samples_first_vec.size(); ++i)
+            {
+                first_to_run[i] = samples_first_vec[i].second;
+            }
+        });
 
-                // insert samples at ends of runs
-                if (i > 0)
-                {
-                    if (bwt_s[i-1] != bwt_s[i])
-                    {
-                        samples_last.push_back({
-                            sa[i-1] > 0
-                            ? sa[i-1] - 1
-                            : sa.size() - 1,
-                            samples_last.size()
-                        });
-                    }
-                    if (i == sa.size()-1)
-                    {
-                        samples_last.push_back({
-                            sa[i] > 0
-                            ? sa[i] - 1
-                            : sa.size() - 1,
-                            samples_last.size()
-                        });
-                    }
-                }
+        // sort samples of last positions in runs according to text position
+        std::sort(samples_last_vec.begin(), samples_last_vec.end());
+
+        // build Elias-Fano predecessor
+        {
+            std::vector<ulint> last_ones;
+            last_ones.reserve(samples_last_vec.size());
+            for (auto p: samples_last_vec)
+            {
+                assert(p.first < bwt.size());
+                last_ones.push_back(p.first);
             }
+            last = sparse_bitvector_t(last_ones,bwt.size());
+        }
+
+        assert(last.rank(last.size()) == r);
+
+        // construct last_to_run
+        last_to_run = sdsl::int_vector<>(r,0,log_r);
+        for (ulint i = 0; i < samples_last_vec.size(); ++i)
+        {
+            last_to_run[i] = samples_last_vec[i].second;
         }
 
-        return std::tuple<std::string, std::vector<range_t>, std::vector<range_t> >
-            (bwt_s, samples_first, samples_last);
+        firsts.get();
+
+        // release ISA cache
+        //sdsl::remove(sdsl::cache_file_name(sdsl::conf::KEY_ISA, cc));
+        //sdsl::remove(sdsl::cache_file_name(sdsl::conf::KEY_ISA, ccR));
+
+        bc.report.phase("(4/4) predecessors");
+
+        std::cout << " done. " << std::endl << std::endl;
+
     }
 
     static const uchar TERMINATOR = 1;
 
-    bool sais = true;
-
     /*
      * sparse RLBWT for text & textR
      */
@@ -1648,6 +2069,18 @@ private:
     // needed for determining the end of locate
     permuted_lcp<> plcp;
 
+    // boundaries of the sequences in the text
+    sequence_boundaries<sparse_bitvector_t> sequences;
+    // remapped separator between sequences, 0 if none
+    uchar separator = 0;
+
+    // documents of samples_first/samples_last, needed for document listing
+    sdsl::int_vector<> docs_first;
+    sdsl::int_vector<> docs_last;
+
+    // runs of ILCP, for document listing
+    interleaved_lcp<sparse_bitvector_t> ilcp;
+
 };
 
 };
@@ -0,0 +1,152 @@
+#include <iostream>
+#include <string>
+
+#include "br_index.hpp"
+#include "index_bench.hpp"
+#include "perf_counters.hpp"
+
+using namespace std;
+using namespace bri;
+
+long ops = 1000000;
+long seed = 1;
+long flush_mb = 64;
+long cold_ops = 1000;
+string output = string();
+bool use_perf = false;
+
+void help(){
+	cout << "bri-bench: time per operation (ns/op) of the primitives of a br-index, as JSON" << endl << endl;
+	cout << "Usage: bri-bench [options] <index>" << endl;
+	cout << "   -n <number>  queries per primitive, access pattern (random, sequential) and warm pass. 1000000 by" << endl;
+	cout << "                default" << endl;
+	cout << "   -cold <n>    queries of a cold pass, the first n of the warm one, each timed on its own after a" << endl;
+	cout << "                flush of the caches (1000 by default, at most -n)" << endl;
+	cout << "   -seed <n>    seed of the random queries (1 by default)" << endl;
+	cout << "   -flush <MB>  size of the buffer written to evict the caches before a cold query (64 by default)," << endl;
+	cout << "                larger than the last level cache" << endl;
+	cout << "   -o <file>    write the JSON results to this file instead of the standard output" << endl;
+	cout << "   -perf        also report cycles, instructions, LLC, dTLB and branch misses per operation, and of the" << endl;
+	cout << "                index load, with the hardware counters (Linux perf_event_open), if available" << endl;
+	cout << "   <index>      index file (with extension .bri)" << endl;
+	exit(0);
+}
+
+void parse_args(char** argv, int argc, int &ptr){
+
+	assert(ptr<argc);
+
+	string s(argv[ptr]);
+	ptr++;
+
+	long* value = nullptr;
+	long min_value = 0;
+
+	if (s.compare("-n") == 0)
+	{
+		value = &ops;
+		min_value = 1;
+	}
+	else if (s.compare("-cold") == 0)
+	{
+		value = &cold_ops;
+		min_value = 1;
+	}
+	else if (s.compare("-seed") == 0)
+	{
+		value = &seed;
+	}
+	else if (s.compare("-flush") == 0)
+	{
+		value = &flush_mb;
+	}
+	else if (s.compare("-perf") == 0)
+	{
+		use_perf = true;
+		return;
+	}
+	else if (s.compare("-o") == 0)
+	{
+
+		if(ptr >= argc-1){
+			cout << "Error: missing parameter after -o option." << endl;
+			help();
+		}
+
+		output = string(argv[ptr]);
+		ptr++;
+		return;
+
+	}
+	else
+	{
+		cout << "Error: unrecognized '" << s << "' option." << endl;
+		help();
+	}
+
+	if(ptr >= argc-1){
+		cout << "Error: missing parameter after " << s << " option." << endl;
+		help();
+	}
+
+	char* e;
+	*value = strtol(argv[ptr],&e,10);
+
+	if(*e != '\0' || *value < min_value){
+		cout << "Error: invalid value after " << s << " option." << endl;
+		help();
+	}
+
+	ptr++;
+
+}
+
+int main(int argc, char** argv){
+
+	if(argc < 2)
+		help();
+
+	int ptr = 1;
+	while (ptr < argc-1) parse_args(argv, argc, ptr);
+
+	string idx_file(argv[ptr]);
+
+	perf_counters perf(use_perf);
+	auto p1 = perf.now();
+
+	br_index<> idx;
+	idx.load_from_file(idx_file);
+
+	perf.add("load", p1, perf.now());
+
+	index_bench bench(ops, seed, (ulint)flush_mb << 20, use_perf ? &perf : nullptr, cold_ops);
+	auto results = bench.run(idx);
+
+	if (output.compare(string()) != 0)
+	{
+		ofstream out(output);
+		if (!out)
+		{
+			cout << "Error: cannot open output file " << output << endl;
+			exit(1);
+		}
+		index_bench::write_json(out, idx_file, idx, ops, results, use_perf ? &perf : nullptr, cold_ops);
+
+		for (auto& res: results)
+		{
+			cout << res.structure << "::" << res.op << " (" << res.access << ", " << res.cache << "): "
+			     << res.ns_per_op << " ns/op";
+			for (auto& p: res.perf) cout << ", " << p.second << " " << p.first;
+			cout << endl;
+		}
+		perf.print(cout);
+	}
+	else
+	{
+		index_bench::write_json(cout, idx_file, idx, ops, results, use_perf ? &perf : nullptr, cold_ops);
+	}
+
+	// keeps the operations from being optimized away
+	if (bench.sink == 1) cerr << " ";
+
+}
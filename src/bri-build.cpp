@@ -1,9 +1,12 @@
 #include <chrono>
 #include <iostream> 
 #include <string>
+#include <unistd.h>
 
 #include "br_index.hpp"
 #include "br_index_nplcp.hpp"
+#include "gz_input.hpp"
+#include "sharded_index.hpp"
 #include "utils.hpp"
 
 using namespace std;
@@ -12,7 +15,16 @@ using namespace bri;
 string out_basename = string();
 string input_file = string();
 bool sais = true;
+bool parallel_sa = false;
 bool nplcp = false;
+bool both = false;
+bool fasta = false;
+bool pfp = false;
+long threads = 1;
+string tmp_dir = "./";
+ulint max_ram = 0;
+long shards = 0;
+long overlap = 1000;
 
 void help(){
 	cout << "bri-build: builds the bidirectional r-index. Extension .bri/.brin is automatically added to output index file" << endl << endl;
@@ -20,9 +32,29 @@ void help(){
 	cout << "   -o <basename>        use 'basename' as prefix for all index files. Default: basename is the specified input_file_name"<<endl;
 	cout << "   -divsufsort          use divsufsort algorithm to build the BWT (fast, 7.5n Bytes of RAM). By default,"<<endl;
 	cout << "                        SE-SAIS is used (about 4 time slower than divsufsort, 4n Bytes of RAM)."<<endl;
+    cout << "   -parallel-sa         use the in-tree parallel suffix sorting (prefix doubling) with the threads of -t, split"<<endl;
+    cout << "                        between the text and the reversed text (25n Bytes of RAM). The index is the same."<<endl;
     cout << "   -nplcp               use the version without PLCP. When locating, calculate LF^d(p) first."<<endl;
     cout << "                        fast when occ is very high, but takes slightly larger space than the normal version."<<endl;
-	cout << "   <input_file_name>    input text file." << endl;
+    cout << "   -both                build both <basename>.bri and <basename>.brin, sharing suffix sorting, BWT and SA"<<endl;
+    cout << "                        samples. Only PLCP and the samples of the version without PLCP are built twice."<<endl;
+    cout << "   -fasta               the input is a FASTA file. Headers and line breaks are removed, the sequences are"<<endl;
+    cout << "                        separated by '#' and located occurrences are reported per sequence."<<endl;
+    cout << "   -pfp                 build BWT, SA samples and PLCP from the prefix-free parse of the text instead of"<<endl;
+    cout << "                        its suffix array. Memory is proportional to the parse, much smaller than the text"<<endl;
+    cout << "                        on highly repetitive collections."<<endl;
+	cout << "   -t <threads>         number of threads (1 by default). With 2 or more, the structures of the text and of the"<<endl;
+    cout << "                        reversed text are built concurrently (about twice the peak memory), and BGZF input"<<endl;
+    cout << "                        is decompressed in parallel."<<endl;
+	cout << "   --tmp-dir <dir>      directory of the temporary files (text and suffix array). Default: current directory"<<endl;
+	cout << "   --max-ram <MB>       RAM budget of the construction. Over budget, divsufsort falls back to SE-SAIS (semi-"<<endl;
+    cout << "                        external, suffix array streamed from --tmp-dir) and -t no longer sorts the text and the"<<endl;
+    cout << "                        reversed text concurrently. The peak RSS of each phase is printed at the end."<<endl;
+	cout << "   -shards <k>          split the text into k shards, indexed separately as <basename>.<i>.bri and listed in"<<endl;
+    cout << "                        the manifest <basename>.brs, which bri-count and bri-locate accept as the index."<<endl;
+	cout << "   -overlap <length>    with -shards, characters of the next shard also indexed by each shard (1000 by"<<endl;
+    cout << "                        default). Patterns up to length+1 characters can be searched."<<endl;
+	cout << "   <input_file_name>    input text file, optionally gzip/BGZF compressed." << endl;
 	exit(0);
 }
 
@@ -51,11 +83,129 @@ void parse_args(char** argv, int argc, int &ptr){
 		sais = false;
 
 	}
+    else if (s.compare("-parallel-sa") == 0)
+    {
+
+        parallel_sa = true;
+
+    }
     else if (s.compare("-nplcp") == 0)
     {
 
         nplcp = true;
 
+    }
+    else if (s.compare("-both") == 0)
+    {
+
+        both = true;
+
+    }
+    else if (s.compare("-fasta") == 0)
+    {
+
+        fasta = true;
+
+    }
+    else if (s.compare("-pfp") == 0)
+    {
+
+        pfp = true;
+
+    }
+    else if (s.compare("-t") == 0)
+    {
+
+		if(ptr >= argc-1){
+			cout << "Error: missing parameter after -t option." << endl;
+			help();
+		}
+
+		char* e;
+		threads = strtol(argv[ptr],&e,10);
+
+		if(*e != '\0' || threads < 1){
+			cout << "Error: invalid value after -t option." << endl;
+			help();
+		}
+
+		ptr++;
+
+    }
+    else if (s.compare("--tmp-dir") == 0)
+    {
+
+		if(ptr >= argc-1){
+			cout << "Error: missing parameter after --tmp-dir option." << endl;
+			help();
+		}
+
+		tmp_dir = string(argv[ptr]);
+		ptr++;
+
+		if(access(tmp_dir.c_str(), W_OK) != 0){
+			cout << "Error: temporary directory " << tmp_dir << " is not writable." << endl;
+			exit(1);
+		}
+
+    }
+    else if (s.compare("-shards") == 0)
+    {
+
+		if(ptr >= argc-1){
+			cout << "Error: missing parameter after -shards option." << endl;
+			help();
+		}
+
+		char* e;
+		shards = strtol(argv[ptr],&e,10);
+
+		if(*e != '\0' || shards < 1){
+			cout << "Error: invalid value after -shards option." << endl;
+			help();
+		}
+
+		ptr++;
+
+    }
+    else if (s.compare("-overlap") == 0)
+    {
+
+		if(ptr >= argc-1){
+			cout << "Error: missing parameter after -overlap option." << endl;
+			help();
+		}
+
+		char* e;
+		overlap = strtol(argv[ptr],&e,10);
+
+		if(*e != '\0' || overlap < 0){
+			cout << "Error: invalid value after -overlap option." << endl;
+			help();
+		}
+
+		ptr++;
+
+    }
+    else if (s.compare("--max-ram") == 0)
+    {
+
+		if(ptr >= argc-1){
+			cout << "Error: missing parameter after --max-ram option." << endl;
+			help();
+		}
+
+		char* e;
+		long mb = strtol(argv[ptr],&e,10);
+
+		if(*e != '\0' || mb < 1){
+			cout << "Error: invalid value after --max-ram option." << endl;
+			help();
+		}
+
+		max_ram = (ulint)mb * 1024 * 1024;
+		ptr++;
+
     }
     else
     {
@@ -92,29 +242,77 @@ int main(int argc, char** argv)
     if (nplcp) idx_file.append(".brin");
     else idx_file.append(".bri");
 
+    if (shards > 0 && (nplcp || both || fasta))
+    {
+        cout << "Error: -shards is not supported with -nplcp, -both or -fasta." << endl;
+        exit(1);
+    }
+
     cout << "Building br-index of input file " << input_file << endl;
-    cout << "Index will be saved to " << idx_file << endl;
+    if (shards > 0) cout << "Index will be saved to " << shards << " shards listed in " << out_basename << ".brs" << endl;
+    else if (both) cout << "Index will be saved to " << out_basename << ".bri and " << out_basename << ".brin" << endl;
+    else cout << "Index will be saved to " << idx_file << endl;
 
-    string input;
+    string input = gz_input::read_all(input_file, threads);
 
-    {
-        std::ifstream fs(input_file);
-        std::stringstream buffer;
-        buffer << fs.rdbuf();
+    vector<ulint> starts;
+    vector<string> names;
 
-        input = buffer.str();
+    if (fasta)
+    {
+        try {
+            sequence_boundaries<>::parse_fasta(input, starts, names);
+        } catch (const std::exception& e) {
+            cout << "Error: " << e.what() << endl;
+            exit(1);
+        }
+        cout << "Number of sequences: " << names.size() << endl;
     }
 
-    std::ofstream out(idx_file);
+    build_config config(sais,threads,pfp);
+    if (parallel_sa) config.sorter = std::make_shared<parallel_suffix_sorter>();
+    config.tmp_dir = tmp_dir;
+    config.max_ram = max_ram;
 
-    if (nplcp)
+    if (shards > 0)
     {
-        br_index_nplcp<> idx(input,sais);
+        try {
+            sharded_index<>::build(input,shards,overlap,out_basename,config);
+        } catch (const std::exception& e) {
+            cout << "Error: " << e.what() << endl;
+            exit(1);
+        }
+    }
+    else if (both)
+    {
+        // the shared steps once, then each index is finished from them
+        bwt_construction bc(input,config,true);
+        {
+            std::ofstream out(out_basename + ".bri");
+            br_index<> idx(input,bc);
+            if (fasta) idx.set_sequences(starts,names);
+            idx.serialize(out);
+        }
+        {
+            std::ofstream out(out_basename + ".brin");
+            br_index_nplcp<> idx(input,bc);
+            if (fasta) idx.set_sequences(starts,names);
+            idx.serialize(out);
+        }
+        bc.report.print();
+    }
+    else if (nplcp)
+    {
+        std::ofstream out(idx_file);
+        br_index_nplcp<> idx(input,config);
+        if (fasta) idx.set_sequences(starts,names);
         idx.serialize(out);
     } 
     else 
     {
-        br_index<> idx(input,sais);
+        std::ofstream out(idx_file);
+        br_index<> idx(input,config);
+        if (fasta) idx.set_sequences(starts,names);
         idx.serialize(out);
     }
 
@@ -122,6 +320,4 @@ int main(int argc, char** argv)
 
     ulint total = duration_cast<duration<double, std::ratio<1>>>(t2-t1).count();
     cout << "Build time: " << get_time(total) << endl;
-
-    out.close();
 }
\ No newline at end of file
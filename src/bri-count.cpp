@@ -1,9 +1,15 @@
 #include <iostream>
 #include <chrono>
+#include <memory>
 
 #include "br_index.hpp"
 #include "br_index_nplcp.hpp"
 #include "utils.hpp"
+#include "fastx_reader.hpp"
+#include "sharded_index.hpp"
+#include "query_stats.hpp"
+#include "perf_counters.hpp"
+#include "query_trace.hpp"
 #include "nucleotide.h"
 
 using namespace bri;
@@ -11,116 +17,12 @@ using namespace std;
 
 long allowed = 0;
 bool nplcp = false;
-struct ReadRecord {
-    string id;
-    string read;
-
-    string qual;
-
-    /**
-     * Deep copies the strings
-     */
-    ReadRecord(string id, string read, string qual)
-        : id(id), read(read), qual(qual) {
-    }
-};
-
-string getFileExt(const string& s) {
-
-    size_t i = s.rfind('.', s.length());
-    if (i != string::npos) {
-        return (s.substr(i + 1, s.length() - i));
-    }
-
-    return ("");
-}
-
-vector<ReadRecord> getReads(const string& file) {
-    vector<ReadRecord> reads;
-    reads.reserve(200000);
-
-    const auto& extension = getFileExt(file);
-
-    bool fasta =
-        (extension == "FASTA") || (extension == "fasta") || (extension == "fa");
-    bool fastq = (extension == "fq") || (extension == "fastq");
-
-    ifstream ifile(file.c_str());
-    if (!ifile) {
-        throw runtime_error("Cannot open file " + file);
-    }
-    if (!fasta && !fastq) {
-        // this is a not readable
-
-        throw runtime_error("extension " + extension +
-                            " is not a valid extension for the readsfile");
-    } else if (fasta) {
-        // fasta file
-        string read = "";
-        string id = "";
-        string qual = ""; // empty quality string for fasta
-        string line;
-
-        while (getline(ifile, line)) {
-            if (line.empty()) {
-                continue; // Skip empty lines
-            }
-
-            if (line[0] == '>' || line[0] == '@') {
-                // This is an ID line
-                if (!id.empty()) {
-                    // If we already have data, process it and clear
-                    reads.emplace_back(id, read, qual);
-                    reads.emplace_back(id, Nucleotide::getRevCompl(read), qual);
-                    id.clear();
-                    read.clear();
-                }
-                id = line.substr(1); // Extract ID (skip '>')
-            } else {
-                // This is a sequence line
-                read += line;
-            }
-        }
-
-        // Process the last entry if it exists
-        if (!id.empty()) {
-            reads.emplace_back(id, read, qual);
-            reads.emplace_back(id, Nucleotide::getRevCompl(read), qual);
-        }
-    } else {
-        // fastQ
-        string read = "";
-        string id = "";
-        string qual = "";
-        string plusLine = ""; // Skip the '+' line
-        string line;
-
-        while (getline(ifile, id) && getline(ifile, read) &&
-               getline(ifile, plusLine) && // Skip the '+' line
-               getline(ifile, qual)) {
-            if (!id.empty() && id[0] != '@') {
-                throw runtime_error("File " + file +
-                                    "doesn't appear to be in FastQ format");
-            }
-
-            if (id.back() == '\n') {
-                id.pop_back();
-            }
-            if (!read.empty() && read.back() == '\n') {
-                read.pop_back();
-            }
-
-            assert(id.size() > 1);
-            id = (id.substr(1));
-            reads.emplace_back(id, read, qual);
-            reverse(qual.begin(), qual.end());
-            reads.emplace_back(id, Nucleotide::getRevCompl(read), qual);
-            id.clear(), read.clear(), qual.clear();
-        }
-    }
-
-    return reads;
-}
+long threads = 1;
+bool processes = false;
+long slowest = 0;
+bool use_perf = false;
+bool batch = false;
+string trace_file = string();
 
 void help()
 {
@@ -130,8 +32,19 @@ void help()
 	cout << "Usage: bri-count [options] <index> <patterns>" << endl;
     cout << "   -nplcp       use the version without PLCP."<<endl;
     cout << "   -m <number>  number of mismatched characters allowed (0 by default)" << endl;
-	cout << "   <index>      index file (with extension .bri)" << endl;
-	cout << "   <patterns>   file in pizza&chili format containing the patterns." << endl;
+    cout << "   -t <threads> number of threads decompressing BGZF reads (1 by default)" << endl;
+    cout << "   -processes   with a sharded index, serve each shard by a child process instead of a thread" << endl;
+    cout << "   -slowest <n> print the n slowest patterns with the operations of their search (if built with" << endl;
+    cout << "                -DBRI_OP_COUNTERS=ON). search latency percentiles are always printed" << endl;
+    cout << "   -perf        count cycles, instructions, LLC, dTLB and branch misses of the load and search phases" << endl;
+    cout << "                with the hardware counters (Linux perf_event_open), if available. reading them adds a" << endl;
+    cout << "                system call to each pattern" << endl;
+    cout << "   -trace <out> record every pattern, with its count and latency, to this binary trace (see bri-replay)" << endl;
+    cout << "   -batch       count the patterns of each chunk of reads together, sharing the search of their common" << endl;
+    cout << "                suffixes (sorted read sets, k-mer panels). only with -m 0; per-pattern latencies," << endl;
+    cout << "                -slowest and -trace are not available" << endl;
+	cout << "   <index>      index file (with extension .bri), or manifest of a sharded index (.brs, bri-build -shards)" << endl;
+	cout << "   <patterns>   FASTA/FASTQ file containing the reads, optionally gzip/BGZF compressed." << endl;
 	exit(0);
 }
 
@@ -166,6 +79,74 @@ void parse_args(char** argv, int argc, int &ptr){
 
         nplcp = true;
 
+    }
+    else if (s.compare("-trace") == 0)
+    {
+
+        if(ptr>=argc-1){
+            cout << "Error: missing parameter after -trace option." << endl;
+            help();
+        }
+
+        trace_file = string(argv[ptr]);
+        ptr++;
+
+    }
+    else if (s.compare("-perf") == 0)
+    {
+
+        use_perf = true;
+
+    }
+    else if (s.compare("-batch") == 0)
+    {
+
+        batch = true;
+
+    }
+    else if (s.compare("-processes") == 0)
+    {
+
+        processes = true;
+
+    }
+    else if (s.compare("-slowest") == 0)
+    {
+
+        if(ptr>=argc-1){
+            cout << "Error: missing parameter after -slowest option." << endl;
+            help();
+        }
+
+        char* e;
+        slowest = strtol(argv[ptr],&e,10);
+
+        if(*e != '\0' || slowest < 0){
+            cout << "Error: invalid negative value after -slowest option." << endl;
+            help();
+        }
+
+        ptr++;
+
+    }
+    else if (s.compare("-t") == 0)
+    {
+
+        if(ptr>=argc-1){
+            cout << "Error: missing parameter after -t option." << endl;
+            help();
+        }
+
+        char* e;
+        threads = strtol(argv[ptr],&e,10);
+
+        if(*e != '\0' || threads < 1){
+            cout << "Error: invalid value after -t option." << endl;
+            help();
+        }
+
+        ptr++;
+
     }
     else 
     {
@@ -176,6 +157,90 @@ void parse_args(char** argv, int argc, int &ptr){
     }
 }
 
+/*
+ * count_all on the shards listed by a manifest, queried in parallel
+ */
+void count_sharded(string const& manifest, string patterns)
+{
+    using std::chrono::high_resolution_clock;
+    using std::chrono::duration_cast;
+    using std::chrono::milliseconds;
+    using std::chrono::nanoseconds;
+
+    auto t1 = high_resolution_clock::now();
+
+    sharded_index<> idx(manifest, processes);
+
+    auto t2 = high_resolution_clock::now();
+
+    cout << "Number of shards: " << idx.number_of_shards() << endl;
+    cout << "searching patterns with mismatches at most " << allowed << " ... " << endl;
+
+    cout << "Reading in reads from " << patterns << endl;
+    unique_ptr<fastx_stream> reads;
+    try {
+        reads.reset(new fastx_stream(patterns,1<<14,threads));
+    } catch (const exception& e) {
+        string er = e.what();
+        er += " Did you provide a valid reads file?";
+        throw runtime_error(er);
+    }
+
+    ulint n = 0;
+    ulint last_perc = 0;
+    ulint occ_tot = 0;
+
+    latency_histogram query_latency;
+
+    string p;
+
+    vector<read_record> const* chunk;
+    while (ulint k = reads->next(chunk))
+    {
+        ulint perc = reads->progress();
+        if (perc > last_perc)
+        {
+            cout << perc << "% done ..." << endl;
+            last_perc = perc;
+        }
+
+        for (ulint i = 0; i < k; ++i)
+        {
+            n += 2;
+
+            p = (*chunk)[i].read;
+
+            for (int strand = 0; strand < 2; ++strand)
+            {
+                // Now also match the reverse complement
+                if (strand == 1) Nucleotide::revCompl(p);
+
+                auto t4 = high_resolution_clock::now();
+                occ_tot += idx.count(p,allowed);
+                query_latency.record(duration_cast<nanoseconds>(high_resolution_clock::now()-t4).count());
+            }
+        }
+    }
+
+    double occ_avg = (double)occ_tot / n*2;
+
+    cout << endl << occ_avg << " average occurrences per pattern" << endl;
+
+    auto t3 = high_resolution_clock::now();
+
+    ulint load = duration_cast<milliseconds>(t2-t1).count();
+    cout << "Load time  : " << load << " milliseconds" << endl;
+
+    ulint search = duration_cast<milliseconds>(t3-t2).count();
+    cout << "Number of patterns             n = " << n/2 << endl;
+	cout << "Total number of occurrences  occ = " << occ_tot << endl << endl;
+
+    cout << "Total time : " << search << " milliseconds" << endl;
+	cout << "Search time: " << (double)search/n*2 << " milliseconds/pattern (total: " << n/2 << " patterns)" << endl << endl;
+
+    query_latency.print(cout, "Query latency");
+}
+
 template<class T>
 void count_all(ifstream& in, string patterns)
 {
@@ -183,11 +248,15 @@ void count_all(ifstream& in, string patterns)
     using std::chrono::duration_cast;
     using std::chrono::duration;
     using std::chrono::milliseconds;
+    using std::chrono::nanoseconds;
 
     string text;
     bool c = false;
 
 
+    perf_counters perf(use_perf);
+    auto p1 = perf.now();
+
     auto t1 = high_resolution_clock::now();
 
     T idx;
@@ -196,52 +265,104 @@ void count_all(ifstream& in, string patterns)
 
     auto t2 = high_resolution_clock::now();
 
+    perf.add("load", p1, perf.now());
+
     cout << "searching patterns with mismatches at most " << allowed << " ... " << endl;
 
     cout << "Reading in reads from " << patterns << endl;
-    vector<ReadRecord> reads;
+    unique_ptr<fastx_stream> reads;
     try {
-        reads = getReads(patterns);
+        reads.reset(new fastx_stream(patterns,1<<14,threads));
     } catch (const exception& e) {
         string er = e.what();
         er += " Did you provide a valid reads file?";
         throw runtime_error(er);
     }
-    // ifstream ifs(patterns);
-
-    //read header of the pizza&chilli input file
-	//header example:
-	//# number=7 length=10 file=genome.fasta forbidden=\n\t
-    // string header;
-    // getline(ifs,header);
 
-    ulint n = reads.size();
-    // ulint m = get_patterns_length(header);
+    // n counts a read and its reverse complement as two patterns
+    ulint n = 0;
 
     ulint last_perc = 0;
 
     ulint occ_tot = 0;
 
-    // extract patterns from file and search them in the index
-    for (unsigned int i = 0; i < n; i += 2) {
-        ulint perc = 100 * i / n;
+    latency_histogram search_latency;
+    slowest_queries slow(slowest);
+
+    unique_ptr<query_trace_writer> trace;
+    if (trace_file.compare(string()) != 0) trace.reset(new query_trace_writer(trace_file));
+    auto trace_start = high_resolution_clock::now();
+
+    // reverse complement, computed on demand into a reused buffer
+    string p;
+
+    // both strands of the reads of a chunk, with -batch
+    vector<string> patts;
+
+    // extract patterns from file chunk by chunk and search them in the index
+    vector<read_record> const* chunk;
+    while (ulint k = reads->next(chunk))
+    {
+        ulint perc = reads->progress();
         if (perc > last_perc)
         {
             cout << perc << "% done ..." << endl;
             last_perc = perc;
         }
 
-        string p = reads[i].read;
-
-        auto samples = idx.search_with_mismatch(p,allowed);
-        occ_tot += idx.count_samples(samples);
-
-        // Now also match the reverse complement
-        p = reads[i+1].read;
+        if (batch)
+        {
+            patts.clear();
+            for (ulint i = 0; i < k; ++i)
+            {
+                patts.push_back((*chunk)[i].read);
+                patts.push_back((*chunk)[i].read);
+                Nucleotide::revCompl(patts.back());
+            }
+            n += 2 * k;
 
-        samples = idx.search_with_mismatch(p,allowed);
-        occ_tot += idx.count_samples(samples);
+            auto p4 = perf.now();
+            for (ulint occs: idx.count_batch(patts)) occ_tot += occs;
+            perf.add("search", p4, perf.now());
+            continue;
+        }
 
+        for (ulint i = 0; i < k; ++i)
+        {
+            n += 2;
+
+            p = (*chunk)[i].read;
+
+            for (char strand: {'+', '-'})
+            {
+                // Now also match the reverse complement
+                if (strand == '-') Nucleotide::revCompl(p);
+
+                query_stats::local().reset();
+                auto p4 = perf.now();
+                auto t4 = high_resolution_clock::now();
+                auto samples = idx.search_with_mismatch(p,allowed);
+                ulint occs = idx.count_samples(samples);
+                ulint search_ns = duration_cast<nanoseconds>(high_resolution_clock::now()-t4).count();
+                perf.add("search", p4, perf.now());
+
+                occ_tot += occs;
+                search_latency.record(search_ns);
+                slow.push((*chunk)[i].id, strand, search_ns, 0, occs, query_stats::local());
+
+                if (trace)
+                {
+                    trace_record r;
+                    r.op = trace_record::COUNT;
+                    r.mismatches = allowed;
+                    r.occ = occs;
+                    r.start_ns = duration_cast<nanoseconds>(t4-trace_start).count();
+                    r.latency_ns = search_ns;
+                    r.pattern = p;
+                    trace->write(r);
+                }
+            }
+        }
     }
 
     double occ_avg = (double)occ_tot / n*2;
@@ -263,7 +384,11 @@ void count_all(ifstream& in, string patterns)
 
     cout << "Total time : " << search << " milliseconds" << endl;
 	cout << "Search time: " << (double)search/n*2 << " milliseconds/pattern (total: " << n/2 << " patterns)" << endl;
-	cout << "Search time: " << (double)search/occ_tot << " milliseconds/occurrence (total: " << occ_tot << " occurrences)" << endl;
+	cout << "Search time: " << (double)search/occ_tot << " milliseconds/occurrence (total: " << occ_tot << " occurrences)" << endl << endl;
+
+    if (!batch) search_latency.print(cout, "Search latency");
+    slow.print(cout);
+    perf.print(cout);
 }
 
 
@@ -276,9 +401,34 @@ int main(int argc, char** argv)
 
     while (ptr < argc - 2) parse_args(argv, argc, ptr);
 
+    if (batch && (allowed > 0 || slowest > 0 || trace_file.compare(string()) != 0))
+    {
+        cout << "Error: -batch is not supported with -m, -slowest and -trace." << endl;
+        exit(1);
+    }
+
     string idx_file(argv[ptr]);
     string patt_file(argv[ptr+1]);
 
+    // manifest of a sharded index
+    if (idx_file.size() > 4 && idx_file.compare(idx_file.size() - 4, 4, ".brs") == 0)
+    {
+        if (nplcp || slowest > 0 || use_perf || batch || trace_file.compare(string()) != 0)
+        {
+            cout << "Error: -nplcp, -slowest, -perf, -batch and -trace are not supported with a sharded index." << endl;
+            exit(1);
+        }
+
+        cout << "Loading sharded br-index" << endl;
+        try {
+            count_sharded(idx_file, patt_file);
+        } catch (const exception& e) {
+            cout << "Error: " << e.what() << endl;
+            exit(1);
+        }
+        return 0;
+    }
+
     ifstream in(idx_file);
 
     cout << "Loading br-index" << endl;
@@ -0,0 +1,189 @@
+#include <iostream>
+#include <string>
+
+#include "synthetic_collection.hpp"
+
+using namespace std;
+using namespace bri;
+
+synthetic_config config;
+synthetic_read_config reads;
+string read_format = "fastq";
+bool plain = false;
+
+void help(){
+	cout << "bri-gen: generates a repetitive collection (a random base genome and mutated copies of it) and reads from it" << endl << endl;
+	cout << "Usage: bri-gen [options] <output>" << endl;
+	cout << "   -n <length>         length of the base genome (1000000 by default)" << endl;
+	cout << "   -copies <N>         number of mutated copies of the base genome (10 by default)" << endl;
+	cout << "   -snp <rate>         substitutions per base of a copy (0.001 by default)" << endl;
+	cout << "   -indel <rate>       indels per base of a copy (0.0001 by default)" << endl;
+	cout << "   -indel-len <l>      mean length of an indel, of the copies and of the reads (3 by default)" << endl;
+	cout << "   -sigma <k>          alphabet size: ACGT, then other letters and digits (4 by default, at most 62)" << endl;
+	cout << "   -seed <s>           seed of the generator (1 by default)" << endl;
+	cout << "   -text               write the concatenation of the sequences to <output>.txt instead of FASTA to <output>.fa" << endl;
+	cout << "   -reads <count>      also write count reads (0 by default)" << endl;
+	cout << "   -read-len <m>       length of the reads (100 by default)" << endl;
+	cout << "   -read-sub <rate>    substitutions per base of a read (0.01 by default)" << endl;
+	cout << "   -read-mis <k>       exactly k substitutions per read, instead of -read-sub" << endl;
+	cout << "   -read-indel <rate>  indels per base of a read (0 by default)" << endl;
+	cout << "   -read-format <f>    fastq (<output>.fq), fasta (<output>.reads.fa) or pizza: Pizza&Chili patterns" << endl;
+	cout << "                       for bri-seedex (<output>.patt). fastq by default" << endl;
+	cout << "   <output>            basename of the output files" << endl << endl;
+	cout << "The id of a read is followed by where it comes from: sequence, position, strand (reverse complement over ACGT" << endl;
+	cout << "only), substitutions and indels. The Pizza&Chili format has no ids." << endl;
+	exit(0);
+}
+
+ulint parse_ulint(string const& opt, char* arg){
+
+	char* e;
+	long v = strtol(arg,&e,10);
+
+	if(*e != '\0' || v < 0){
+		cout << "Error: invalid value after " << opt << " option." << endl;
+		help();
+	}
+
+	return v;
+
+}
+
+double parse_rate(string const& opt, char* arg){
+
+	char* e;
+	double v = strtod(arg,&e);
+
+	if(*e != '\0' || v < 0 || v > 1){
+		cout << "Error: invalid value after " << opt << " option." << endl;
+		help();
+	}
+
+	return v;
+
+}
+
+void parse_args(char** argv, int argc, int &ptr){
+
+	assert(ptr<argc);
+
+	string s(argv[ptr]);
+	ptr++;
+
+	if (s.compare("-text") == 0)
+	{
+
+		plain = true;
+		return;
+
+	}
+
+	if(ptr >= argc-1){
+		cout << "Error: missing parameter after " << s << " option." << endl;
+		help();
+	}
+
+	char* arg = argv[ptr];
+	ptr++;
+
+	if (s.compare("-n") == 0) config.length = parse_ulint(s, arg);
+	else if (s.compare("-copies") == 0) config.copies = parse_ulint(s, arg);
+	else if (s.compare("-snp") == 0) config.snp_rate = parse_rate(s, arg);
+	else if (s.compare("-indel") == 0) config.indel_rate = parse_rate(s, arg);
+	else if (s.compare("-indel-len") == 0) config.indel_length = parse_ulint(s, arg);
+	else if (s.compare("-sigma") == 0) config.sigma = parse_ulint(s, arg);
+	else if (s.compare("-seed") == 0) config.seed = parse_ulint(s, arg);
+	else if (s.compare("-reads") == 0) reads.count = parse_ulint(s, arg);
+	else if (s.compare("-read-len") == 0) reads.length = parse_ulint(s, arg);
+	else if (s.compare("-read-sub") == 0) reads.sub_rate = parse_rate(s, arg);
+	else if (s.compare("-read-mis") == 0) reads.exact_subs = parse_ulint(s, arg);
+	else if (s.compare("-read-indel") == 0) reads.indel_rate = parse_rate(s, arg);
+	else if (s.compare("-read-format") == 0)
+	{
+
+		read_format = arg;
+
+		if (read_format != "fastq" && read_format != "fasta" && read_format != "pizza"){
+			cout << "Error: invalid value after -read-format option." << endl;
+			help();
+		}
+
+	}
+	else
+	{
+		cout << "Error: unrecognized '" << s << "' option." << endl;
+		help();
+	}
+
+}
+
+int main(int argc, char** argv){
+
+	if(argc < 2)
+		help();
+
+	int ptr = 1;
+	while (ptr < argc-1) parse_args(argv, argc, ptr);
+
+	string out_base(argv[ptr]);
+
+	try {
+
+		cout << "Generating " << config.copies << " copies of a base genome of length " << config.length << " ..." << endl;
+
+		synthetic_collection coll(config);
+
+		string coll_file = out_base + (plain ? ".txt" : ".fa");
+		ofstream out(coll_file);
+		if (!out) throw runtime_error("cannot write " + coll_file);
+
+		if (plain) coll.write_text(out);
+		else coll.write_fasta(out);
+		out.close();
+
+		cout << "Sequences  : " << coll.sequences().size() << endl;
+		cout << "Total n    : " << coll.total_length() << endl;
+		cout << "Sigma      : " << config.sigma << endl;
+		cout << "SNPs       : " << coll.snps << endl;
+		cout << "Indels     : " << coll.indels << endl;
+		cout << "Written to " << coll_file << endl;
+
+		if (reads.count == 0) return 0;
+
+		string reads_file = out_base + (read_format == "fastq" ? ".fq" : read_format == "fasta" ? ".reads.fa" : ".patt");
+		ofstream rout(reads_file);
+		if (!rout) throw runtime_error("cannot write " + reads_file);
+
+		if (read_format == "pizza")
+			rout << "# number=" << reads.count << " length=" << reads.length << " file=" << coll_file << endl;
+
+		ulint subs = 0, indels = 0;
+		for (ulint i = 0; i < reads.count; ++i)
+		{
+			synthetic_read r = coll.next_read(reads);
+			subs += r.subs;
+			indels += r.indels;
+
+			if (read_format == "pizza")
+			{
+				rout << r.seq;
+				continue;
+			}
+
+			rout << (read_format == "fastq" ? '@' : '>') << "read_" << i + 1 << ' '
+			     << coll.sequence_names()[r.sequence] << ':' << r.pos << ':' << (r.reverse ? '-' : '+')
+			     << " subs=" << r.subs << " indels=" << r.indels << '\n' << r.seq << '\n';
+			if (read_format == "fastq") rout << "+\n" << string(r.seq.size(), 'I') << '\n';
+		}
+
+		cout << endl << "Reads      : " << reads.count << " of length " << reads.length << endl;
+		cout << "Read subs  : " << subs << endl;
+		cout << "Read indels: " << indels << endl;
+		cout << "Written to " << reads_file << endl;
+
+	} catch (const exception& e) {
+		cout << "Error: " << e.what() << endl;
+		exit(1);
+	}
+
+}
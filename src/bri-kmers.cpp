@@ -0,0 +1,180 @@
+#include <iostream>
+#include <chrono>
+
+#include "br_index.hpp"
+#include "br_index_nplcp.hpp"
+#include "kmer_spectrum.hpp"
+
+using namespace std;
+using namespace bri;
+
+bool nplcp = false;
+bool text = false;
+ulint k = 31;
+ulint min_count = 1;
+ulint max_count = -1;
+ulint threads = 1;
+string alphabet = string();
+
+void help(){
+	cout << "bri-kmers: enumerates the distinct k-mers of the indexed text with their number of occurrences" << endl << endl;
+	cout << "Usage: bri-kmers [options] <index> <output>" << endl;
+	cout << "   -nplcp          use the version without PLCP." << endl;
+	cout << "   -k <k>          length of the k-mers (31 by default)" << endl;
+	cout << "   -min <count>    only the k-mers occurring at least count times (1 by default)" << endl;
+	cout << "   -max <count>    only the k-mers occurring at most count times" << endl;
+	cout << "   -t <threads>    number of threads of the enumeration (1 by default)" << endl;
+	cout << "   -alphabet <s>   characters of the k-mers, e.g. ACGT to skip those with N. by default all the" << endl;
+	cout << "                   characters of the text but the separator of the sequences of a FASTA index" << endl;
+	cout << "   -text           write a k-mer and its count per line instead of the packed binary list" << endl;
+	cout << "   <index>         index file (with extension .bri)" << endl;
+	cout << "   <output>        k-mer file, sorted: the k-mers packed on ceil(log2(sigma)) bits per character," << endl;
+	cout << "                   each followed by its count (see kmer_spectrum.hpp)" << endl;
+	exit(0);
+}
+
+ulint parse_ulint(string const& opt, char* arg){
+
+	char* e;
+	long v = strtol(arg,&e,10);
+
+	if(*e != '\0' || v < 1){
+		cout << "Error: invalid value after " << opt << " option." << endl;
+		help();
+	}
+
+	return v;
+
+}
+
+void parse_args(char** argv, int argc, int &ptr){
+
+	assert(ptr<argc);
+
+	string s(argv[ptr]);
+	ptr++;
+
+	if (s.compare("-nplcp") == 0)
+	{
+
+		nplcp = true;
+		return;
+
+	}
+	if (s.compare("-text") == 0)
+	{
+
+		text = true;
+		return;
+
+	}
+
+	if(ptr >= argc-2){
+		cout << "Error: missing parameter after " << s << " option." << endl;
+		help();
+	}
+
+	char* arg = argv[ptr];
+	ptr++;
+
+	if (s.compare("-k") == 0) k = parse_ulint(s, arg);
+	else if (s.compare("-min") == 0) min_count = parse_ulint(s, arg);
+	else if (s.compare("-max") == 0) max_count = parse_ulint(s, arg);
+	else if (s.compare("-t") == 0) threads = parse_ulint(s, arg);
+	else if (s.compare("-alphabet") == 0) alphabet = arg;
+	else
+	{
+		cout << "Error: unrecognized '" << s << "' option." << endl;
+		help();
+	}
+
+}
+
+template<class T>
+void kmers(string const& idx_file, string const& out_file){
+
+	using std::chrono::high_resolution_clock;
+	using std::chrono::duration_cast;
+	using std::chrono::milliseconds;
+
+	auto t1 = high_resolution_clock::now();
+
+	cout << "Loading br-index" << endl;
+	T idx;
+	idx.load_from_file(idx_file);
+
+	auto t2 = high_resolution_clock::now();
+
+	string sigma = idx.alphabet();
+	if (alphabet.compare(string()) != 0)
+	{
+		// the requested characters occurring in the text, sorted
+		sort(alphabet.begin(), alphabet.end());
+		alphabet.erase(unique(alphabet.begin(), alphabet.end()), alphabet.end());
+
+		string res;
+		for (char c: alphabet)
+			if (sigma.find(c) != string::npos) res.push_back(c);
+		sigma = res;
+	}
+	else if (idx.number_of_sequences() > 0)
+		sigma.erase(remove(sigma.begin(), sigma.end(), (char)SEQUENCE_SEPARATOR), sigma.end());
+
+	if (sigma.empty()) throw runtime_error("no character of the alphabet occurs in the text");
+
+	cout << "Enumerating the " << k << "-mers over " << sigma << " with " << threads << " threads ..." << endl;
+
+	kmer_spectrum<T> spectrum(idx, k, sigma, min_count, max_count);
+
+	if (text)
+	{
+		ofstream out(out_file);
+		if (!out) throw runtime_error("cannot write " + out_file);
+
+		kmer_codec const& codec = spectrum.get_codec();
+		spectrum.enumerate(threads, [&](ulint const* kmer, ulint count)
+		{
+			out << codec.unpack(kmer) << '\t' << count << '\n';
+		});
+	}
+	else spectrum.write(out_file, threads);
+
+	auto t3 = high_resolution_clock::now();
+
+	cout << "Distinct k-mers      : " << spectrum.distinct << endl;
+	cout << "Total occurrences    : " << spectrum.total << endl;
+	cout << "Bits per character   : " << spectrum.get_codec().bits << endl;
+	cout << "Written to " << out_file << endl << endl;
+
+	cout << "Load time       : " << duration_cast<milliseconds>(t2-t1).count() << " milliseconds" << endl;
+	cout << "Enumeration time: " << duration_cast<milliseconds>(t3-t2).count() << " milliseconds" << endl;
+
+}
+
+int main(int argc, char** argv){
+
+	if(argc < 3)
+		help();
+
+	int ptr = 1;
+	while (ptr < argc-2) parse_args(argv, argc, ptr);
+
+	if (min_count > max_count)
+	{
+		cout << "Error: -min is larger than -max." << endl;
+		exit(1);
+	}
+
+	try {
+
+		if (nplcp)
+			kmers<br_index_nplcp<> >(argv[ptr], argv[ptr+1]);
+		else
+			kmers<br_index<> >(argv[ptr], argv[ptr+1]);
+
+	} catch (const exception& e) {
+		cout << "Error: " << e.what() << endl;
+		exit(1);
+	}
+
+}
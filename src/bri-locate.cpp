@@ -1,129 +1,38 @@
 #include <iostream>
 #include <chrono>
+#include <memory>
 #include <cstdlib>
 
 #include "br_index.hpp"
 #include "br_index_nplcp.hpp"
 #include "utils.hpp"
+#include "fastx_reader.hpp"
+#include "paired_end.hpp"
+#include "sharded_index.hpp"
+#include "query_stats.hpp"
+#include "perf_counters.hpp"
+#include "query_trace.hpp"
+#include "read_cache.hpp"
 #include "nucleotide.h"
 
 using namespace bri;
 using namespace std;
 
 string check = string();
+string output = string();
 long allowed = 0;
 bool nplcp = false;
-
-struct ReadRecord {
-    string id;
-    string read;
-
-    string qual;
-
-    /**
-     * Deep copies the strings
-     */
-    ReadRecord(string id, string read, string qual)
-        : id(id), read(read), qual(qual) {
-    }
-};
-
-string getFileExt(const string& s) {
-
-    size_t i = s.rfind('.', s.length());
-    if (i != string::npos) {
-        return (s.substr(i + 1, s.length() - i));
-    }
-
-    return ("");
-}
-
-vector<ReadRecord> getReads(const string& file) {
-    vector<ReadRecord> reads;
-    reads.reserve(200000);
-
-    const auto& extension = getFileExt(file);
-
-    bool fasta =
-        (extension == "FASTA") || (extension == "fasta") || (extension == "fa");
-    bool fastq = (extension == "fq") || (extension == "fastq");
-
-    ifstream ifile(file.c_str());
-    if (!ifile) {
-        throw runtime_error("Cannot open file " + file);
-    }
-    if (!fasta && !fastq) {
-        // this is a not readable
-
-        throw runtime_error("extension " + extension +
-                            " is not a valid extension for the readsfile");
-    } else if (fasta) {
-        // fasta file
-        string read = "";
-        string id = "";
-        string qual = ""; // empty quality string for fasta
-        string line;
-
-        while (getline(ifile, line)) {
-            if (line.empty()) {
-                continue; // Skip empty lines
-            }
-
-            if (line[0] == '>' || line[0] == '@') {
-                // This is an ID line
-                if (!id.empty()) {
-                    // If we already have data, process it and clear
-                    reads.emplace_back(id, read, qual);
-                    reads.emplace_back(id, Nucleotide::getRevCompl(read), qual);
-                    id.clear();
-                    read.clear();
-                }
-                id = line.substr(1); // Extract ID (skip '>')
-            } else {
-                // This is a sequence line
-                read += line;
-            }
-        }
-
-        // Process the last entry if it exists
-        if (!id.empty()) {
-            reads.emplace_back(id, read, qual);
-            reads.emplace_back(id, Nucleotide::getRevCompl(read), qual);
-        }
-    } else {
-        // fastQ
-        string read = "";
-        string id = "";
-        string qual = "";
-        string plusLine = ""; // Skip the '+' line
-        string line;
-
-        while (getline(ifile, id) && getline(ifile, read) &&
-               getline(ifile, plusLine) && // Skip the '+' line
-               getline(ifile, qual)) {
-            if (!id.empty() && id[0] != '@') {
-                throw runtime_error("File " + file +
-                                    "doesn't appear to be in FastQ format");
-            }
-
-            if (id.back() == '\n') {
-                id.pop_back();
-            }
-            if (!read.empty() && read.back() == '\n') {
-                read.pop_back();
-            }
-
-            assert(id.size() > 1);
-            id = (id.substr(1));
-            reads.emplace_back(id, read, qual);
-            reverse(qual.begin(), qual.end());
-            reads.emplace_back(id, Nucleotide::getRevCompl(read), qual);
-            id.clear(), read.clear(), qual.clear();
-        }
-    }
-
-    return reads;
-}
+bool docs = false;
+long threads = 1;
+string mates = string();
+long min_insert = 0;
+long max_insert = 500;
+long max_occ = 1000;
+bool processes = false;
+long slowest = 0;
+bool use_perf = false;
+string trace_file = string();
+long cache_mb = 0;
 
 void help()
 {
@@ -132,10 +41,37 @@ void help()
 
 	cout << "Usage: bri-locate [options] <index> <patterns>" << endl;
     cout << "   -nplcp       use the version without PLCP." << endl;
+    cout << "   -d           list the documents (sequences of an index built with bri-build -fasta) containing" << endl;
+    cout << "                each read instead of locating all its occurrences" << endl;
     cout << "   -m <number>  max number of mismatched characters allowed (0 by default)" << endl;
+    cout << "   -t <threads> number of threads decompressing BGZF reads (1 by default)" << endl;
 	cout << "   -c <text>    check correctness of each pattern occurrence on this text file (must be the same indexed)" << endl;
-	cout << "   <index>      index file (with extension .bri)" << endl;
-	cout << "   <patterns>   file in pizza&chili format containing the patterns." << endl;
+    cout << "   -o <file>    write the occurrences to this file, one per line: read id, strand, sequence name, offset." << endl;
+    cout << "                with -d, one line per document: read id, strand, sequence name." << endl;
+    cout << "                sequence name is * if the index was not built with bri-build -fasta" << endl;
+    cout << "   -p <mates>   paired-end mode: <patterns> holds the first mates and this FASTQ file the second mates," << endl;
+    cout << "                in the same order. concordant pairs are reported first; with -o, one line per placement:" << endl;
+    cout << "                read id, concordant/unpaired, sequence name, forward mate (1/2, with the strand if unpaired)," << endl;
+    cout << "                its offset, offset of the other mate and insert size (* if unpaired)" << endl;
+    cout << "   -I <number>  minimum insert size of a concordant pair (0 by default)" << endl;
+    cout << "   -X <number>  maximum insert size of a concordant pair (500 by default)" << endl;
+    cout << "   -maxocc <n>  paired-end mode: do not locate a mate with more than n occurrences on a strand (1000 by default);" << endl;
+    cout << "                its placements are searched in the insert window of each occurrence of the other mate." << endl;
+    cout << "                if no concordant pair is found, the occurrences of the rarer mate are reported" << endl;
+    cout << "   -processes   with a sharded index, serve each shard by a child process instead of a thread" << endl;
+    cout << "   -slowest <n> print the n slowest patterns (search + locate time) with the operations of their" << endl;
+    cout << "                query (if built with -DBRI_OP_COUNTERS=ON). search and locate latency percentiles" << endl;
+    cout << "                are always printed" << endl;
+    cout << "   -perf        count cycles, instructions, LLC, dTLB and branch misses of the load, search and locate" << endl;
+    cout << "                phases with the hardware counters (Linux perf_event_open), if available. reading them" << endl;
+    cout << "                adds a system call to each phase of each pattern" << endl;
+    cout << "   -trace <out> record every pattern, with its result size and latency, to this binary trace" << endl;
+    cout << "                (see bri-replay)" << endl;
+    cout << "   -cache <MB>  search and locate identical reads (or reverse complements of each other) once, keeping" << endl;
+    cout << "                the results of the reads in a cache of at most this many megabytes (0, disabled, by" << endl;
+    cout << "                default). reads found in the cache are not counted in the latencies, -slowest and -trace" << endl;
+	cout << "   <index>      index file (with extension .bri), or manifest of a sharded index (.brs, bri-build -shards)" << endl;
+	cout << "   <patterns>   FASTA/FASTQ file containing the reads, optionally gzip/BGZF compressed." << endl;
 	exit(0);
 }
 
@@ -157,6 +93,18 @@ void parse_args(char** argv, int argc, int &ptr){
 		check = string(argv[ptr]);
 		ptr++;
     
+    }
+    else if (s.compare("-o") == 0)
+    {
+
+        if(ptr>=argc-1){
+            cout << "Error: missing parameter after -o option." << endl;
+            help();
+        }
+
+        output = string(argv[ptr]);
+        ptr++;
+
     }
     else if (s.compare("-m") == 0)
     {
@@ -182,6 +130,162 @@ void parse_args(char** argv, int argc, int &ptr){
 
         nplcp = true;
 
+    }
+    else if (s.compare("-d") == 0)
+    {
+
+        docs = true;
+
+    }
+    else if (s.compare("-trace") == 0)
+    {
+
+        if(ptr>=argc-1){
+            cout << "Error: missing parameter after -trace option." << endl;
+            help();
+        }
+
+        trace_file = string(argv[ptr]);
+        ptr++;
+
+    }
+    else if (s.compare("-perf") == 0)
+    {
+
+        use_perf = true;
+
+    }
+    else if (s.compare("-processes") == 0)
+    {
+
+        processes = true;
+
+    }
+    else if (s.compare("-t") == 0)
+    {
+
+        if(ptr>=argc-1){
+            cout << "Error: missing parameter after -t option." << endl;
+            help();
+        }
+
+        char* e;
+        threads = strtol(argv[ptr],&e,10);
+
+        if(*e != '\0' || threads < 1){
+            cout << "Error: invalid value after -t option." << endl;
+            help();
+        }
+
+        ptr++;
+
+    }
+    else if (s.compare("-p") == 0)
+    {
+
+        if(ptr>=argc-1){
+            cout << "Error: missing parameter after -p option." << endl;
+            help();
+        }
+
+        mates = string(argv[ptr]);
+        ptr++;
+
+    }
+    else if (s.compare("-I") == 0)
+    {
+
+        if(ptr>=argc-1){
+            cout << "Error: missing parameter after -I option." << endl;
+            help();
+        }
+
+        char* e;
+        min_insert = strtol(argv[ptr],&e,10);
+
+        if(*e != '\0' || min_insert < 0){
+            cout << "Error: invalid negative value after -I option." << endl;
+            help();
+        }
+
+        ptr++;
+
+    }
+    else if (s.compare("-X") == 0)
+    {
+
+        if(ptr>=argc-1){
+            cout << "Error: missing parameter after -X option." << endl;
+            help();
+        }
+
+        char* e;
+        max_insert = strtol(argv[ptr],&e,10);
+
+        if(*e != '\0' || max_insert < 0){
+            cout << "Error: invalid negative value after -X option." << endl;
+            help();
+        }
+
+        ptr++;
+
+    }
+    else if (s.compare("-slowest") == 0)
+    {
+
+        if(ptr>=argc-1){
+            cout << "Error: missing parameter after -slowest option." << endl;
+            help();
+        }
+
+        char* e;
+        slowest = strtol(argv[ptr],&e,10);
+
+        if(*e != '\0' || slowest < 0){
+            cout << "Error: invalid negative value after -slowest option." << endl;
+            help();
+        }
+
+        ptr++;
+
+    }
+    else if (s.compare("-cache") == 0)
+    {
+
+        if(ptr>=argc-1){
+            cout << "Error: missing parameter after -cache option." << endl;
+            help();
+        }
+
+        char* e;
+        cache_mb = strtol(argv[ptr],&e,10);
+
+        if(*e != '\0' || cache_mb < 0){
+            cout << "Error: invalid value after -cache option." << endl;
+            help();
+        }
+
+        ptr++;
+
+    }
+    else if (s.compare("-maxocc") == 0)
+    {
+
+        if(ptr>=argc-1){
+            cout << "Error: missing parameter after -maxocc option." << endl;
+            help();
+        }
+
+        char* e;
+        max_occ = strtol(argv[ptr],&e,10);
+
+        if(*e != '\0' || max_occ < 1){
+            cout << "Error: invalid value after -maxocc option." << endl;
+            help();
+        }
+
+        ptr++;
+
     }
     else
     {
@@ -193,6 +297,42 @@ void parse_args(char** argv, int argc, int &ptr){
 
 }
 
+/*
+ * write the occurrences of a read as (sequence name, offset) lines
+ */
+template<class T>
+void write_occurrences(ofstream& out, T& idx, string const& id, char strand, vector<ulint> const& occs)
+{
+    string name = id.substr(0, id.find_first_of(" \t"));
+
+    for (auto o : occs)
+    {
+        auto pos = idx.sequence_position(o);
+
+        out << name << '\t' << strand << '\t';
+        if (idx.number_of_sequences() > 0) out << idx.sequence_name(pos.first);
+        else out << '*';
+        out << '\t' << pos.second << '\n';
+    }
+}
+
+/*
+ * write the documents containing a read, one per line
+ */
+template<class T>
+void write_documents(ofstream& out, T& idx, string const& id, char strand, vector<ulint> const& ds)
+{
+    string name = id.substr(0, id.find_first_of(" \t"));
+
+    for (auto d : ds)
+    {
+        out << name << '\t' << strand << '\t';
+        if (idx.number_of_sequences() > 0) out << idx.sequence_name(d);
+        else out << '*';
+        out << '\n';
+    }
+}
+
 template<class T>
 void locate_all(ifstream& in, string patterns)
 {
@@ -201,6 +341,7 @@ void locate_all(ifstream& in, string patterns)
     using std::chrono::duration;
     using std::chrono::milliseconds;
     using std::chrono::microseconds;
+    using std::chrono::nanoseconds;
 
     string text;
     bool c = false;
@@ -215,6 +356,9 @@ void locate_all(ifstream& in, string patterns)
         text = ss.str();
     }
 
+    perf_counters perf(use_perf);
+    auto p1 = perf.now();
+
     auto t1 = high_resolution_clock::now();
 
     T idx;
@@ -223,95 +367,252 @@ void locate_all(ifstream& in, string patterns)
 
     auto t2 = high_resolution_clock::now();
 
+    perf.add("load", p1, perf.now());
+
+    // the text of an index built from FASTA is the concatenation of its sequences
+    if (c && idx.number_of_sequences() > 0)
+    {
+        vector<ulint> starts;
+        vector<string> names;
+        sequence_boundaries<>::parse_fasta(text, starts, names);
+    }
+
+    ofstream out;
+    if (output.compare(string()) != 0)
+    {
+        out.open(output);
+        if (!out) throw runtime_error("Cannot open output file " + output);
+    }
+
     cout << "searching patterns with mismatches at most " << allowed << " ... " << endl;
 
     cout << "Reading in reads from " << patterns << endl;
-    vector<ReadRecord> reads;
+    unique_ptr<fastx_stream> reads;
     try {
-        reads = getReads(patterns);
+        reads.reset(new fastx_stream(patterns,1<<14,threads));
     } catch (const exception& e) {
         string er = e.what();
         er += " Did you provide a valid reads file?";
         throw runtime_error(er);
     }
-    // ifstream ifs(patterns);
 
-    //read header of the pizza&chilli input file
-	//header example:
-	//# number=7 length=10 file=genome.fasta forbidden=\n\t
-    // string header;
-    // getline(ifs,header);
-
-    ulint n = reads.size();
-    // ulint m = get_patterns_length(header);
+    // n counts a read and its reverse complement as two patterns
+    ulint n = 0;
 
     ulint last_perc = 0;
 
     ulint occ_tot = 0;
+    ulint doc_tot = 0;
 
     auto t3 = high_resolution_clock::now();
     auto t4 = high_resolution_clock::now();
     auto t5 = high_resolution_clock::now();
+    auto p3 = perf.now();
+    auto p4 = p3;
+    auto p5 = p3;
     ulint count_time = 0;
     ulint locate_time = 0;
     ulint tot_time = 0;
 
-    // extract patterns from file and search them in the index
-    for (unsigned int i = 0; i < n; i += 2) {
-        ulint perc = 100 * i / n;
+    latency_histogram search_latency;
+    latency_histogram locate_latency;
+    slowest_queries slow(slowest);
+
+    unique_ptr<query_trace_writer> trace;
+    if (trace_file.compare(string()) != 0) trace.reset(new query_trace_writer(trace_file));
+    auto trace_start = high_resolution_clock::now();
+
+    // reverse complement, computed on demand into a reused buffer
+    string p;
+
+    // results of the reads already searched, with -cache
+    unique_ptr<read_cache> cache;
+    if (cache_mb > 0) cache.reset(new read_cache((ulint)cache_mb << 20));
+    string rc;
+    cached_read cached;
+
+    // outputs the results of a read found in the cache
+    auto fan_out = [&](string const& id)
+    {
+        for (ulint s = 0; s < 2; ++s)
+        {
+            char strand = s == 0 ? '+' : '-';
+            occ_tot += cached.occ[s];
+            if (docs) doc_tot += cached.values[s].size();
+
+            if (!out.is_open()) continue;
+            if (docs) write_documents(out, idx, id, strand, cached.values[s]);
+            else write_occurrences(out, idx, id, strand, cached.values[s]);
+        }
+    };
+
+    // latencies of the last pattern p, t3 to t4 and t4 to t5
+    auto record = [&](string const& id, char strand, ulint occs)
+    {
+        perf.add("search", p3, p4);
+        perf.add("locate", p4, p5);
+
+        ulint search_ns = duration_cast<nanoseconds>(t4-t3).count();
+        ulint locate_ns = duration_cast<nanoseconds>(t5-t4).count();
+        search_latency.record(search_ns);
+        locate_latency.record(locate_ns);
+        slow.push(id, strand, search_ns, locate_ns, occs, query_stats::local());
+
+        if (trace)
+        {
+            trace_record r;
+            r.op = docs ? trace_record::DOCUMENTS : trace_record::LOCATE;
+            r.mismatches = allowed;
+            r.occ = occs;
+            r.start_ns = duration_cast<nanoseconds>(t3-trace_start).count();
+            r.latency_ns = search_ns + locate_ns;
+            r.pattern = p;
+            trace->write(r);
+        }
+    };
+
+    // extract patterns from file chunk by chunk and search them in the index
+    vector<read_record> const* chunk;
+    while (ulint k = reads->next(chunk))
+    {
+        ulint perc = reads->progress();
         if (perc > last_perc)
         {
             cout << perc << "% done ..." << endl;
             last_perc = perc;
         }
 
-        string p = reads[i].read;
-
-        t3 = high_resolution_clock::now();
-        auto samples = idx.search_with_mismatch(p,allowed);
-        t4 = high_resolution_clock::now();
-        auto occs = idx.locate_samples(samples);
-        t5 = high_resolution_clock::now();
-
-        count_time += duration_cast<microseconds>(t4-t3).count();
-        locate_time += duration_cast<microseconds>(t5-t4).count();
-        occ_tot += occs.size();
-        tot_time += duration_cast<microseconds>(t4-t3).count() + duration_cast<microseconds>(t5-t4).count();
+        for (ulint i = 0; i < k; ++i)
+        {
+            n += 2;
 
-        // Now also match the reverse complement
-        p = reads[i+1].read;
+            p = (*chunk)[i].read;
 
-        t3 = high_resolution_clock::now();
-        samples = idx.search_with_mismatch(p,allowed);
-        t4 = high_resolution_clock::now();
-        occs = idx.locate_samples(samples);
-        t5 = high_resolution_clock::now();
+            if (cache)
+            {
+                rc = p;
+                Nucleotide::revCompl(rc);
 
-        count_time += duration_cast<microseconds>(t4-t3).count();
-        locate_time += duration_cast<microseconds>(t5-t4).count();
-        occ_tot += occs.size();
-        tot_time += duration_cast<microseconds>(t4-t3).count() + duration_cast<microseconds>(t5-t4).count();
+                auto t6 = high_resolution_clock::now();
+                if (cache->find(p, rc, cached))
+                {
+                    fan_out((*chunk)[i].id);
+                    tot_time += duration_cast<microseconds>(high_resolution_clock::now()-t6).count();
+                    continue;
+                }
+            }
 
-        if (c) // check occurrences
-        {
-            cout << "number of occs with at most " << allowed << " mismatch   : " << occs.size() << endl;
-            for (auto o : occs)
+            query_stats::local().reset();
+            p3 = perf.now();
+            t3 = high_resolution_clock::now();
+            auto samples = idx.search_with_mismatch(p,allowed);
+            t4 = high_resolution_clock::now();
+            p4 = perf.now();
+            if (docs)
             {
-                int mismatches = 0;
-                for (size_t i = 0; i < p.size(); ++i)
+                auto ds = idx.list_documents_samples(samples);
+                t5 = high_resolution_clock::now();
+                p5 = perf.now();
+
+                cached.occ[0] = idx.count_samples(samples);
+                doc_tot += ds.size();
+                occ_tot += cached.occ[0];
+                count_time += duration_cast<microseconds>(t4-t3).count();
+                locate_time += duration_cast<microseconds>(t5-t4).count();
+                tot_time += duration_cast<microseconds>(t5-t3).count();
+                record((*chunk)[i].id, '+', ds.size());
+                if (out.is_open()) write_documents(out, idx, (*chunk)[i].id, '+', ds);
+                if (cache) cached.values[0] = ds;
+
+                Nucleotide::revCompl(p);
+
+                query_stats::local().reset();
+                p3 = perf.now();
+                t3 = high_resolution_clock::now();
+                samples = idx.search_with_mismatch(p,allowed);
+                t4 = high_resolution_clock::now();
+                p4 = perf.now();
+                ds = idx.list_documents_samples(samples);
+                t5 = high_resolution_clock::now();
+                p5 = perf.now();
+
+                cached.occ[1] = idx.count_samples(samples);
+                doc_tot += ds.size();
+                occ_tot += cached.occ[1];
+                count_time += duration_cast<microseconds>(t4-t3).count();
+                locate_time += duration_cast<microseconds>(t5-t4).count();
+                tot_time += duration_cast<microseconds>(t5-t3).count();
+                record((*chunk)[i].id, '-', ds.size());
+                if (out.is_open()) write_documents(out, idx, (*chunk)[i].id, '-', ds);
+
+                if (cache)
                 {
-                    if (text[o+i] != p[i]) mismatches++;
+                    cached.values[1] = ds;
+                    cache->insert((*chunk)[i].read, rc, cached);
                 }
-                if (mismatches > allowed) 
+
+                continue;
+            }
+            auto occs = idx.locate_samples(samples);
+            t5 = high_resolution_clock::now();
+            p5 = perf.now();
+
+            count_time += duration_cast<microseconds>(t4-t3).count();
+            locate_time += duration_cast<microseconds>(t5-t4).count();
+            occ_tot += occs.size();
+            tot_time += duration_cast<microseconds>(t4-t3).count() + duration_cast<microseconds>(t5-t4).count();
+            record((*chunk)[i].id, '+', occs.size());
+
+            if (out.is_open()) write_occurrences(out, idx, (*chunk)[i].id, '+', occs);
+            if (cache) cached.values[0] = occs;
+
+            // Now also match the reverse complement
+            Nucleotide::revCompl(p);
+
+            query_stats::local().reset();
+            p3 = perf.now();
+            t3 = high_resolution_clock::now();
+            samples = idx.search_with_mismatch(p,allowed);
+            t4 = high_resolution_clock::now();
+            p4 = perf.now();
+            occs = idx.locate_samples(samples);
+            t5 = high_resolution_clock::now();
+            p5 = perf.now();
+
+            count_time += duration_cast<microseconds>(t4-t3).count();
+            locate_time += duration_cast<microseconds>(t5-t4).count();
+            occ_tot += occs.size();
+            tot_time += duration_cast<microseconds>(t4-t3).count() + duration_cast<microseconds>(t5-t4).count();
+            record((*chunk)[i].id, '-', occs.size());
+
+            if (out.is_open()) write_occurrences(out, idx, (*chunk)[i].id, '-', occs);
+
+            if (cache)
+            {
+                cached.values[1] = occs;
+                for (ulint s = 0; s < 2; ++s) cached.occ[s] = cached.values[s].size();
+                cache->insert((*chunk)[i].read, rc, cached);
+            }
+
+            if (c) // check occurrences
+            {
+                cout << "number of occs with at most " << allowed << " mismatch   : " << occs.size() << endl;
+                for (auto o : occs)
                 {
-                    cout << "Error: wrong occurrence:  " << o << endl;
-                    cout << "       original pattern:  " << p << endl;
-                    cout << "       wrong    pattern:  " << text.substr(o,p.size()) << endl;
+                    int mismatches = 0;
+                    for (size_t i = 0; i < p.size(); ++i)
+                    {
+                        if (text[o+i] != p[i]) mismatches++;
+                    }
+                    if (mismatches > allowed) 
+                    {
+                        cout << "Error: wrong occurrence:  " << o << endl;
+                        cout << "       original pattern:  " << p << endl;
+                        cout << "       wrong    pattern:  " << text.substr(o,p.size()) << endl;
+                    }
                 }
             }
         }
-
-        
     }
 
     double occ_avg = (double)occ_tot / n*2;
@@ -325,15 +626,405 @@ void locate_all(ifstream& in, string patterns)
 
     cout << "Number of patterns             n = " << n/2 << endl;
 	// cout << "Pattern length                 m = " << m << endl;
-	cout << "Total number of occurrences  occ = " << occ_tot << endl << endl;
+	cout << "Total number of occurrences  occ = " << occ_tot << endl;
+    if (docs) cout << "Total number of documents   ndoc = " << doc_tot << endl;
+    cout << endl;
 
     cout << "LF-mapping time: " << count_time << " microseconds" << endl;
     cout << "Phi        time: " << locate_time << " microseconds" << endl;
     cout << "Total time     : " << tot_time << " microseconds" << endl;
 	cout << "Search time    : " << (double)tot_time/n*2 << " microseconds/pattern (total: " << n/2 << " patterns)" << endl;
-	cout << "Search time    : " << (double)tot_time/occ_tot << " microseconds/occurrence (total: " << occ_tot << " occurrences)" << endl;
+	cout << "Search time    : " << (double)tot_time/occ_tot << " microseconds/occurrence (total: " << occ_tot << " occurrences)" << endl << endl;
+
+    search_latency.print(cout, "Search latency");
+    locate_latency.print(cout, "Locate latency");
+    if (cache) cache->print(cout);
+    slow.print(cout);
+    perf.print(cout);
+}
+
+
+/*
+ * locate_all on the shards listed by a manifest, queried in parallel
+ */
+void locate_sharded(string const& manifest, string patterns)
+{
+    using std::chrono::high_resolution_clock;
+    using std::chrono::duration_cast;
+    using std::chrono::milliseconds;
+    using std::chrono::microseconds;
+    using std::chrono::nanoseconds;
+
+    string text;
+    bool c = false;
+
+    if (check.compare(string()) != 0)
+    {
+        c = true;
+
+        ifstream ifs1(check);
+        stringstream ss;
+        ss << ifs1.rdbuf();
+        text = ss.str();
+    }
+
+    auto t1 = high_resolution_clock::now();
+
+    sharded_index<> idx(manifest, processes);
+
+    auto t2 = high_resolution_clock::now();
+
+    cout << "Number of shards: " << idx.number_of_shards() << endl;
+
+    ofstream out;
+    if (output.compare(string()) != 0)
+    {
+        out.open(output);
+        if (!out) throw runtime_error("Cannot open output file " + output);
+    }
+
+    cout << "searching patterns with mismatches at most " << allowed << " ... " << endl;
+
+    cout << "Reading in reads from " << patterns << endl;
+    unique_ptr<fastx_stream> reads;
+    try {
+        reads.reset(new fastx_stream(patterns,1<<14,threads));
+    } catch (const exception& e) {
+        string er = e.what();
+        er += " Did you provide a valid reads file?";
+        throw runtime_error(er);
+    }
+
+    ulint n = 0;
+    ulint last_perc = 0;
+    ulint occ_tot = 0;
+    ulint tot_time = 0;
+
+    latency_histogram query_latency;
+
+    string p;
+
+    vector<read_record> const* chunk;
+    while (ulint k = reads->next(chunk))
+    {
+        ulint perc = reads->progress();
+        if (perc > last_perc)
+        {
+            cout << perc << "% done ..." << endl;
+            last_perc = perc;
+        }
+
+        for (ulint i = 0; i < k; ++i)
+        {
+            n += 2;
+
+            p = (*chunk)[i].read;
+            string name = (*chunk)[i].id.substr(0, (*chunk)[i].id.find_first_of(" \t"));
+
+            for (char strand: {'+', '-'})
+            {
+                // the reverse complement second
+                if (strand == '-') Nucleotide::revCompl(p);
+
+                auto t3 = high_resolution_clock::now();
+                auto occs = idx.locate(p,allowed);
+                auto t4 = high_resolution_clock::now();
+
+                tot_time += duration_cast<microseconds>(t4-t3).count();
+                query_latency.record(duration_cast<nanoseconds>(t4-t3).count());
+                occ_tot += occs.size();
+
+                if (out.is_open())
+                    for (auto o: occs) out << name << '\t' << strand << "\t*\t" << o << '\n';
+
+                if (c) // check occurrences
+                {
+                    for (auto o : occs)
+                    {
+                        long mismatches = 0;
+                        for (size_t j = 0; j < p.size(); ++j)
+                            if (text[o+j] != p[j]) mismatches++;
+
+                        if (mismatches > allowed)
+                        {
+                            cout << "Error: wrong occurrence:  " << o << endl;
+                            cout << "       original pattern:  " << p << endl;
+                            cout << "       wrong    pattern:  " << text.substr(o,p.size()) << endl;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    double occ_avg = (double)occ_tot / n*2;
+
+    cout << endl << occ_avg << " average occurrences per pattern" << endl;
+
+    ulint load = duration_cast<milliseconds>(t2-t1).count();
+    cout << "Load time  : " << load << " milliseconds" << endl;
+
+    cout << "Number of patterns             n = " << n/2 << endl;
+	cout << "Total number of occurrences  occ = " << occ_tot << endl << endl;
+
+    cout << "Total time     : " << tot_time << " microseconds" << endl;
+	cout << "Search time    : " << (double)tot_time/n*2 << " microseconds/pattern (total: " << n/2 << " patterns)" << endl;
+	cout << "Search time    : " << (double)tot_time/occ_tot << " microseconds/occurrence (total: " << occ_tot << " occurrences)" << endl << endl;
+
+    query_latency.print(cout, "Query latency");
 }
 
+/*
+ * occurrences of a mate on one strand, sorted.
+ * empty if there are more than max_occ of them (not located)
+ */
+template<class T, class S>
+vector<ulint> locate_mate(T& idx, S const& samples, ulint cnt)
+{
+    vector<ulint> res;
+    if (cnt == 0 || cnt > (ulint)max_occ) return res;
+    res = idx.locate_samples(samples);
+    sort(res.begin(), res.end());
+    return res;
+}
+
+/*
+ * concordant pairs of a forward mate and a reverse complemented one
+ * (rev, as it occurs in the text). if one of them is not located, its
+ * placements are searched in the insert window of those of the other
+ */
+template<class T, class S>
+void join_strands(T& idx, S const& sf, ulint cf, vector<ulint> const& of, string const& fwd,
+                  S const& sr, ulint cr, vector<ulint> const& orv, string const& rev, vector<mate_pair>& hits)
+{
+    bool fwd_located = cf > 0 && cf <= (ulint)max_occ;
+    bool rev_located = cr > 0 && cr <= (ulint)max_occ;
+
+    if (fwd_located && rev_located) join_mates(of, orv, rev.size(), min_insert, max_insert, hits);
+    else if (fwd_located && cr > 0) join_window(idx, sf, true, fwd.size(), rev, allowed, min_insert, max_insert, hits);
+    else if (rev_located && cf > 0) join_window(idx, sr, false, rev.size(), fwd, allowed, min_insert, max_insert, hits);
+}
+
+template<class T>
+void locate_pairs(ifstream& in, string mates1, string mates2)
+{
+    using std::chrono::high_resolution_clock;
+    using std::chrono::duration_cast;
+    using std::chrono::duration;
+    using std::chrono::milliseconds;
+    using std::chrono::microseconds;
+    using std::chrono::nanoseconds;
+
+    perf_counters perf(use_perf);
+    auto p1 = perf.now();
+
+    auto t1 = high_resolution_clock::now();
+
+    T idx;
+
+    idx.load(in);
+
+    auto t2 = high_resolution_clock::now();
+
+    perf.add("load", p1, perf.now());
+
+    ofstream out;
+    if (output.compare(string()) != 0)
+    {
+        out.open(output);
+        if (!out) throw runtime_error("Cannot open output file " + output);
+    }
+
+    cout << "searching read pairs with mismatches at most " << allowed << " and insert size in ["
+         << min_insert << "," << max_insert << "] ... " << endl;
+
+    cout << "Reading in mates from " << mates1 << " and " << mates2 << endl;
+    unique_ptr<fastx_stream> reads1;
+    unique_ptr<fastx_stream> reads2;
+    try {
+        reads1.reset(new fastx_stream(mates1,1<<14,threads));
+        reads2.reset(new fastx_stream(mates2,1<<14,threads));
+    } catch (const exception& e) {
+        string er = e.what();
+        er += " Did you provide a valid reads file?";
+        throw runtime_error(er);
+    }
+
+    ulint n = 0;
+    ulint last_perc = 0;
+
+    ulint concordant_pairs = 0;
+    ulint concordant_tot = 0;
+    ulint unpaired_pairs = 0;
+    ulint unpaired_tot = 0;
+    ulint skipped = 0;
+
+    ulint search_time = 0;
+    ulint locate_time = 0;
+    ulint join_time = 0;
+
+    // per pair, the four strands of the mates together
+    latency_histogram search_latency;
+    latency_histogram locate_latency;
+    slowest_queries slow(slowest);
+
+    // reverse complemented mates
+    string r1c;
+    string r2c;
+    vector<mate_pair> hits;
+
+    vector<read_record> const* chunk1;
+    vector<read_record> const* chunk2;
+    while (ulint k = reads1->next(chunk1))
+    {
+        if (reads2->next(chunk2) != k)
+            throw runtime_error("Mate files " + mates1 + " and " + mates2 + " have different numbers of reads");
+
+        ulint perc = reads1->progress();
+        if (perc > last_perc)
+        {
+            cout << perc << "% done ..." << endl;
+            last_perc = perc;
+        }
+
+        for (ulint i = 0; i < k; ++i)
+        {
+            n++;
+
+            string const& r1 = (*chunk1)[i].read;
+            string const& r2 = (*chunk2)[i].read;
+
+            // search both strands of both mates
+            query_stats::local().reset();
+            auto p3 = perf.now();
+            auto t3 = high_resolution_clock::now();
+            auto s1f = idx.search_with_mismatch(r1,allowed);
+            r1c = r1;
+            Nucleotide::revCompl(r1c);
+            auto s1r = idx.search_with_mismatch(r1c,allowed);
+            auto s2f = idx.search_with_mismatch(r2,allowed);
+            r2c = r2;
+            Nucleotide::revCompl(r2c);
+            auto s2r = idx.search_with_mismatch(r2c,allowed);
+            auto t4 = high_resolution_clock::now();
+            auto p4 = perf.now();
+
+            ulint c1f = idx.count_samples(s1f);
+            ulint c1r = idx.count_samples(s1r);
+            ulint c2f = idx.count_samples(s2f);
+            ulint c2r = idx.count_samples(s2r);
+
+            for (auto c : {c1f, c1r, c2f, c2r})
+                if (c > (ulint)max_occ) skipped++;
+
+            // the locate effort is capped for repetitive mates
+            vector<ulint> o1f = locate_mate(idx, s1f, c1f);
+            vector<ulint> o1r = locate_mate(idx, s1r, c1r);
+            vector<ulint> o2f = locate_mate(idx, s2f, c2f);
+            vector<ulint> o2r = locate_mate(idx, s2r, c2r);
+            auto t5 = high_resolution_clock::now();
+            perf.add("search", p3, p4);
+            perf.add("locate", p4, perf.now());
+
+            // mate 1 forward and mate 2 reverse complemented, or vice versa
+            hits.clear();
+            join_strands(idx, s1f, c1f, o1f, r1, s2r, c2r, o2r, r2c, hits);
+            ulint hits1 = hits.size();
+            join_strands(idx, s2f, c2f, o2f, r2, s1r, c1r, o1r, r1c, hits);
+
+            string name = (*chunk1)[i].id.substr(0, (*chunk1)[i].id.find_first_of(" \t"));
+
+            ulint concordant = 0;
+            for (ulint h = 0; h < hits.size(); ++h)
+            {
+                auto pos = idx.sequence_position(hits[h].fwd);
+
+                // both mates must lie in the same sequence
+                if (idx.number_of_sequences() > 0 &&
+                    idx.sequence_position(hits[h].rev).first != pos.first) continue;
+
+                concordant++;
+                if (out.is_open())
+                {
+                    out << name << "\tconcordant\t";
+                    if (idx.number_of_sequences() > 0) out << idx.sequence_name(pos.first);
+                    else out << '*';
+                    out << '\t' << (h < hits1 ? 1 : 2) << '\t' << pos.second << '\t'
+                        << idx.sequence_position(hits[h].rev).second << '\t' << hits[h].insert << '\n';
+                }
+            }
+
+            // no concordant pair: fall back to the occurrences of the rarer mate
+            if (concordant == 0)
+            {
+                bool first_rarer = c1f + c1r > 0 && (c2f + c2r == 0 || c1f + c1r <= c2f + c2r);
+                vector<ulint>& of = first_rarer ? o1f : o2f;
+                vector<ulint>& orc = first_rarer ? o1r : o2r;
+
+                if (of.size() + orc.size() > 0) unpaired_pairs++;
+                unpaired_tot += of.size() + orc.size();
+
+                if (out.is_open())
+                {
+                    for (int strand = 0; strand < 2; ++strand)
+                    {
+                        for (auto o : (strand == 0 ? of : orc))
+                        {
+                            auto pos = idx.sequence_position(o);
+                            out << name << "\tunpaired\t";
+                            if (idx.number_of_sequences() > 0) out << idx.sequence_name(pos.first);
+                            else out << '*';
+                            out << '\t' << (first_rarer ? 1 : 2) << (strand == 0 ? '+' : '-') << '\t'
+                                << pos.second << "\t*\t*\n";
+                        }
+                    }
+                }
+            }
+            else
+            {
+                concordant_pairs++;
+                concordant_tot += concordant;
+            }
+            auto t6 = high_resolution_clock::now();
+
+            search_time += duration_cast<microseconds>(t4-t3).count();
+            locate_time += duration_cast<microseconds>(t5-t4).count();
+            join_time += duration_cast<microseconds>(t6-t5).count();
+
+            ulint search_ns = duration_cast<nanoseconds>(t4-t3).count();
+            ulint locate_ns = duration_cast<nanoseconds>(t5-t4).count();
+            search_latency.record(search_ns);
+            locate_latency.record(locate_ns);
+            slow.push(name, '*', search_ns, locate_ns, o1f.size() + o1r.size() + o2f.size() + o2r.size(), query_stats::local());
+        }
+    }
+
+    if (reads2->next(chunk2) != 0)
+        throw runtime_error("Mate files " + mates1 + " and " + mates2 + " have different numbers of reads");
+
+    ulint tot_time = search_time + locate_time + join_time;
+
+    ulint load = duration_cast<milliseconds>(t2-t1).count();
+    cout << endl << "Load time  : " << load << " milliseconds" << endl;
+
+    cout << "Number of read pairs                      n = " << n << endl;
+    cout << "Pairs with concordant placements            = " << concordant_pairs << endl;
+    cout << "Total number of concordant placements       = " << concordant_tot << endl;
+    cout << "Pairs placed by the rarer mate only         = " << unpaired_pairs << endl;
+    cout << "Total number of rarer mate occurrences      = " << unpaired_tot << endl;
+    cout << "Mate strands not located (occ > -maxocc)    = " << skipped << endl << endl;
+
+    cout << "LF-mapping time: " << search_time << " microseconds" << endl;
+    cout << "Phi        time: " << locate_time << " microseconds" << endl;
+    cout << "Join       time: " << join_time << " microseconds" << endl;
+    cout << "Total time     : " << tot_time << " microseconds" << endl;
+    cout << "Search time    : " << (double)tot_time/n << " microseconds/pair (total: " << n << " pairs)" << endl << endl;
+
+    search_latency.print(cout, "Search latency", "pairs");
+    locate_latency.print(cout, "Locate latency", "pairs");
+    slow.print(cout);
+    perf.print(cout);
+}
 
 
 int main(int argc, char** argv)
@@ -347,11 +1038,49 @@ int main(int argc, char** argv)
     string idx_file(argv[ptr]);
     string patt_file(argv[ptr+1]);
 
+    // manifest of a sharded index
+    if (idx_file.size() > 4 && idx_file.compare(idx_file.size() - 4, 4, ".brs") == 0)
+    {
+        if (nplcp || docs || mates.compare(string()) != 0 || slowest > 0 || use_perf || trace_file.compare(string()) != 0 || cache_mb > 0)
+        {
+            cout << "Error: -nplcp, -d, -p, -slowest, -perf, -trace and -cache are not supported with a sharded index." << endl;
+            exit(1);
+        }
+
+        cout << "Loading sharded br-index" << endl;
+        try {
+            locate_sharded(idx_file, patt_file);
+        } catch (const exception& e) {
+            cout << "Error: " << e.what() << endl;
+            exit(1);
+        }
+        return 0;
+    }
+
     ifstream in(idx_file);
 
     cout << "Loading br-index" << endl;
 
-    if (nplcp)
+    if (mates.compare(string()) != 0)
+    {
+        if (min_insert > max_insert)
+        {
+            cout << "Error: minimum insert size is larger than the maximum." << endl;
+            help();
+        }
+
+        if (trace_file.compare(string()) != 0 || cache_mb > 0)
+        {
+            cout << "Error: -trace and -cache are not supported in paired-end mode." << endl;
+            exit(1);
+        }
+
+        if (nplcp)
+            locate_pairs<br_index_nplcp<> >(in, patt_file, mates);
+        else
+            locate_pairs<br_index<> >(in, patt_file, mates);
+    }
+    else if (nplcp)
         locate_all<br_index_nplcp<> >(in, patt_file);
     else 
         locate_all<br_index<> >(in, patt_file);
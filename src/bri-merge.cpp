@@ -0,0 +1,173 @@
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include "br_index.hpp"
+#include "bwt_merge.hpp"
+#include "gz_input.hpp"
+#include "utils.hpp"
+
+using namespace std;
+using namespace bri;
+
+string out_basename = string();
+string index_file = string();
+string batch_file = string();
+long threads = 1;
+
+void help(){
+	cout << "bri-merge: adds a batch of new text to a br-index (.bri), without building it again from scratch." << endl << endl;
+	cout << "Usage: bri-merge [options] <index_file> <batch_file>" << endl;
+	cout << "   -o <basename>        save the merged index to <basename>.bri. Default: the index file is overwritten"<<endl;
+	cout << "   -t <threads>         number of threads (1 by default). With 2 or more, the BWT and the reversed BWT"<<endl;
+    cout << "                        are merged concurrently."<<endl;
+	cout << "   <index_file>         index file (with extension .bri). A .brin index (-nplcp) cannot be merged: build it"<<endl;
+    cout << "                        again with bri-build" << endl;
+	cout << "   <batch_file>         text to add, optionally gzip/BGZF compressed. If the index was built with -fasta, a FASTA"<<endl;
+    cout << "                        file whose sequences are numbered before the indexed ones." << endl << endl;
+    cout << "The batch is prepended to the indexed text, as a new sequence closed by the separator for a FASTA index."<<endl;
+    cout << "The BWT is updated by inserting the suffixes of the batch, the reversed BWT by inserting those of the"<<endl;
+    cout << "reversed batch and moving the prefixes of the indexed text repeated after the separator, in time"<<endl;
+    cout << "proportional to the batch, to these prefixes and to the number of runs: the indexed text is not decoded." << endl;
+    cout << "The LCPs of the inserted suffixes with the indexed ones add up to O(batch length x longest such LCP) in"<<endl;
+    cout << "the worst case, for a batch repeating long substrings of the indexed text." << endl;
+    cout << "For a FASTA index the ILCP used to list documents is merged too, splitting its runs at the inserted rows." << endl;
+	exit(0);
+}
+
+void parse_args(char** argv, int argc, int &ptr){
+
+	assert(ptr<argc);
+
+	string s(argv[ptr]);
+	ptr++;
+
+	if (s.compare("-o") == 0)
+    {
+
+		if(ptr >= argc-2){
+			cout << "Error: missing parameter after -o option." << endl;
+			help();
+		}
+
+		out_basename = string(argv[ptr]);
+		ptr++;
+
+	}
+    else if (s.compare("-t") == 0)
+    {
+
+		if(ptr >= argc-2){
+			cout << "Error: missing parameter after -t option." << endl;
+			help();
+		}
+
+		char* e;
+		threads = strtol(argv[ptr],&e,10);
+
+		if(*e != '\0' || threads < 1){
+			cout << "Error: invalid value after -t option." << endl;
+			help();
+		}
+
+		ptr++;
+
+    }
+    else
+    {
+		cout << "Error: unrecognized '" << s << "' option." << endl;
+		help();
+	}
+
+}
+
+int main(int argc, char** argv)
+{
+    using std::chrono::high_resolution_clock;
+    using std::chrono::duration_cast;
+    using std::chrono::duration;
+
+    auto t1 = high_resolution_clock::now();
+
+    int ptr = 1;
+
+    if (argc < 3) help();
+
+    while (ptr < argc-2) parse_args(argv, argc, ptr);
+
+    index_file = string(argv[ptr]);
+    batch_file = string(argv[ptr+1]);
+
+    if (index_file.size() >= 5 && index_file.compare(index_file.size() - 5, 5, ".brin") == 0)
+    {
+        cout << "Error: a .brin index cannot be merged, build it again with bri-build" << endl;
+        exit(1);
+    }
+
+    string out_file = out_basename.compare("") == 0 ? index_file : out_basename + ".bri";
+
+    cout << "Merging " << batch_file << " into br-index " << index_file << endl;
+    cout << "Index will be saved to " << out_file << endl;
+
+    string batch = gz_input::read_all(batch_file, threads);
+
+    // merged text: batch (+ separator) + indexed text
+    vector<ulint> starts;
+    vector<string> names;
+    bwt_construction bc;
+    {
+        br_index<> idx;
+        idx.load_from_file(index_file);
+
+        if (idx.number_of_sequences() > 0)
+        {
+            try {
+                sequence_boundaries<>::parse_fasta(batch, starts, names);
+            } catch (const std::exception& e) {
+                cout << "Error: " << e.what() << endl;
+                exit(1);
+            }
+            batch.push_back(SEQUENCE_SEPARATOR);
+
+            // the indexed sequences follow those of the batch
+            for (ulint id = 0; id < idx.number_of_sequences(); ++id)
+            {
+                starts.push_back(batch.size() + idx.sequence_start(id));
+                names.push_back(idx.sequence_name(id));
+            }
+        }
+
+        if (batch.empty())
+        {
+            cout << "Error: the batch is empty" << endl;
+            exit(1);
+        }
+
+        bc = bwt_merge::merge(idx,batch,threads);
+        batch = string();
+    }
+
+    {
+        br_index<> idx(bc);
+        if (!names.empty()) idx.set_sequences(starts,names,bc);
+
+        // written next to the index, then renamed over it
+        string tmp_file = out_file + ".tmp";
+        {
+            std::ofstream out(tmp_file);
+            idx.serialize(out);
+        }
+        if (std::rename(tmp_file.c_str(), out_file.c_str()) != 0)
+        {
+            cout << "Error: cannot write " << out_file << endl;
+            exit(1);
+        }
+    }
+    bc.report.print();
+
+    auto t2 = high_resolution_clock::now();
+
+    ulint total = duration_cast<duration<double, std::ratio<1>>>(t2-t1).count();
+    cout << "Merge time: " << get_time(total) << endl;
+}
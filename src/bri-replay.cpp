@@ -0,0 +1,252 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "br_index.hpp"
+#include "br_index_nplcp.hpp"
+#include "query_stats.hpp"
+#include "query_trace.hpp"
+
+using namespace std;
+using namespace bri;
+
+bool nplcp = false;
+long threads = 1;
+double rate = 0;
+bool original = false;
+
+void help(){
+	cout << "bri-replay: re-executes the queries of a trace (bri-locate, bri-count or bri-seedex -trace) on an index" << endl << endl;
+	cout << "Usage: bri-replay [options] <index> <trace>" << endl;
+	cout << "   -nplcp       the index is the version without PLCP. Default: if <index> has extension .brin" << endl;
+	cout << "   -t <threads> number of threads running queries concurrently (1 by default)" << endl;
+	cout << "   -rate <qps>  issue the queries at this rate (queries per second) instead of as fast as possible" << endl;
+	cout << "   -original    issue the queries at the times they were recorded" << endl;
+	cout << "   <index>      index file (with extension .bri or .brin)" << endl;
+	cout << "   <trace>      query trace" << endl << endl;
+	cout << "The service latency of a query is its execution time; the response latency also counts the time it" << endl;
+	cout << "waited for a thread after it was issued, with -rate or -original." << endl;
+	exit(0);
+}
+
+void parse_args(char** argv, int argc, int &ptr){
+
+	assert(ptr<argc);
+
+	string s(argv[ptr]);
+	ptr++;
+
+	if (s.compare("-nplcp") == 0)
+	{
+
+		nplcp = true;
+
+	}
+	else if (s.compare("-original") == 0)
+	{
+
+		original = true;
+
+	}
+	else if (s.compare("-t") == 0)
+	{
+
+		if(ptr >= argc-2){
+			cout << "Error: missing parameter after -t option." << endl;
+			help();
+		}
+
+		char* e;
+		threads = strtol(argv[ptr],&e,10);
+
+		if(*e != '\0' || threads < 1){
+			cout << "Error: invalid value after -t option." << endl;
+			help();
+		}
+
+		ptr++;
+
+	}
+	else if (s.compare("-rate") == 0)
+	{
+
+		if(ptr >= argc-2){
+			cout << "Error: missing parameter after -rate option." << endl;
+			help();
+		}
+
+		char* e;
+		rate = strtod(argv[ptr],&e);
+
+		if(*e != '\0' || rate <= 0){
+			cout << "Error: invalid value after -rate option." << endl;
+			help();
+		}
+
+		ptr++;
+
+	}
+	else
+	{
+		cout << "Error: unrecognized '" << s << "' option." << endl;
+		help();
+	}
+
+}
+
+/*
+ * runs the query of r, returns the size of its result
+ */
+template<class T>
+ulint run(T& idx, trace_record const& r)
+{
+	switch (r.op)
+	{
+		case trace_record::COUNT:
+			return idx.count_samples(idx.search_with_mismatch(r.pattern,r.mismatches));
+		case trace_record::DOCUMENTS:
+			return idx.list_documents_samples(idx.search_with_mismatch(r.pattern,r.mismatches)).size();
+		case trace_record::SEED_EXTEND:
+			return idx.locate_samples(idx.seed_and_extend(r.pattern,r.m1,r.m2,r.mismatches)).size();
+		default:
+			return idx.locate_samples(idx.search_with_mismatch(r.pattern,r.mismatches)).size();
+	}
+}
+
+template<class T>
+void replay(string const& idx_file, vector<trace_record> const& trace)
+{
+	using std::chrono::steady_clock;
+	using std::chrono::duration_cast;
+	using std::chrono::milliseconds;
+	using std::chrono::nanoseconds;
+
+	auto t1 = steady_clock::now();
+
+	T idx;
+	idx.load_from_file(idx_file);
+
+	auto t2 = steady_clock::now();
+	cout << "Load time  : " << duration_cast<milliseconds>(t2-t1).count() << " milliseconds" << endl;
+
+	cout << "Replaying " << trace.size() << " queries with " << threads << " threads";
+	if (original) cout << " at their recorded times";
+	else if (rate > 0) cout << " at " << rate << " queries/second";
+	cout << " ..." << endl;
+
+	// per thread
+	vector<latency_histogram> service(threads);
+	vector<latency_histogram> response(threads);
+	vector<vector<ulint> > differ(threads);
+
+	atomic<ulint> next(0);
+	auto start = steady_clock::now();
+
+	auto worker = [&](ulint t)
+	{
+		for (ulint k = next++; k < trace.size(); k = next++)
+		{
+			auto& r = trace[k];
+
+			auto issue = steady_clock::now();
+			if (original || rate > 0)
+			{
+				ulint at = original ? r.start_ns : (ulint)(k * 1e9 / rate);
+				issue = start + nanoseconds(at);
+				std::this_thread::sleep_until(issue);
+			}
+
+			auto t3 = steady_clock::now();
+			ulint occ = run(idx, r);
+			auto t4 = steady_clock::now();
+
+			service[t].record(duration_cast<nanoseconds>(t4-t3).count());
+			response[t].record(duration_cast<nanoseconds>(t4-std::min(issue,t3)).count());
+			if (occ != r.occ) differ[t].push_back(k);
+		}
+	};
+
+	vector<thread> pool;
+	for (ulint t = 1; t < (ulint)threads; ++t) pool.emplace_back(worker, t);
+	worker(0);
+	for (auto& th: pool) th.join();
+
+	auto end = steady_clock::now();
+
+	latency_histogram recorded;
+	for (auto& r: trace) recorded.record(r.latency_ns);
+
+	vector<ulint> differs;
+	for (ulint t = 1; t < (ulint)threads; ++t)
+	{
+		service[0].merge(service[t]);
+		response[0].merge(response[t]);
+	}
+	for (auto& d: differ) differs.insert(differs.end(), d.begin(), d.end());
+	sort(differs.begin(), differs.end());
+
+	double seconds = duration_cast<nanoseconds>(end-start).count() / 1e9;
+	cout << endl << "Replay time: " << seconds << " seconds" << endl;
+	cout << "Throughput : " << trace.size() / max(seconds, 1e-9) << " queries/second" << endl << endl;
+
+	service[0].print(cout, "Service latency ", "queries");
+	response[0].print(cout, "Response latency", "queries");
+	recorded.print(cout, "Recorded latency", "queries");
+
+	cout << endl << "Queries whose result size differs from the trace: " << differs.size() << endl;
+	for (ulint i = 0; i < differs.size() && i < 10; ++i)
+	{
+		auto& r = trace[differs[i]];
+		cout << "    query " << differs[i] << " (" << (char)r.op << ", " << r.mismatches << " mismatches): recorded "
+		     << r.occ << ", replayed " << run(idx, r) << ": " << r.pattern << endl;
+	}
+}
+
+int main(int argc, char** argv){
+
+	if(argc < 3)
+		help();
+
+	int ptr = 1;
+	while (ptr < argc-2) parse_args(argv, argc, ptr);
+
+	string idx_file(argv[ptr]);
+	string trace_file(argv[ptr+1]);
+
+	if (original && rate > 0)
+	{
+		cout << "Error: -rate and -original are exclusive." << endl;
+		exit(1);
+	}
+
+	if (idx_file.size() > 5 && idx_file.compare(idx_file.size() - 5, 5, ".brin") == 0) nplcp = true;
+
+	vector<trace_record> trace;
+	try {
+		trace = query_trace_reader::read_all(trace_file);
+	} catch (const exception& e) {
+		cout << "Error: " << e.what() << endl;
+		exit(1);
+	}
+
+	for (ulint k = 0; k < trace.size(); ++k)
+	{
+		auto& r = trace[k];
+		bool seed = r.op == trace_record::SEED_EXTEND;
+		if (r.pattern.empty() || (seed && (r.m1 >= r.m2 || r.m2 > r.pattern.size())))
+		{
+			cout << "Error: invalid query " << k << " in trace " << trace_file << endl;
+			exit(1);
+		}
+	}
+
+	cout << "Loading br-index" << endl;
+
+	if (nplcp)
+		replay<br_index_nplcp<> >(idx_file, trace);
+	else
+		replay<br_index<> >(idx_file, trace);
+
+}
@@ -1,10 +1,14 @@
 #include <iostream>
 #include <chrono>
 #include <cstdlib>
+#include <memory>
 
 #include "br_index.hpp"
 #include "br_index_nplcp.hpp"
 #include "utils.hpp"
+#include "query_stats.hpp"
+#include "perf_counters.hpp"
+#include "query_trace.hpp"
 
 using namespace bri;
 using namespace std;
@@ -14,6 +18,9 @@ long allowed = 0;
 bool nplcp = false;
 size_t left_len = 0;
 size_t core_len = 0;
+long slowest = 0;
+bool use_perf = false;
+string trace_file = string();
 
 void help()
 {
@@ -24,6 +31,14 @@ void help()
     cout << "   -nplcp       use the version without PLCP." << endl;
     cout << "   -m <number>  max number of mismatched characters allowed (0 by default)" << endl;
 	cout << "   -c <text>    check correctness of each pattern occurrence on this text file (must be the same indexed)" << endl;
+    cout << "   -slowest <n> print the n slowest patterns (search + locate time) with the operations of their" << endl;
+    cout << "                query (if built with -DBRI_OP_COUNTERS=ON), patterns being numbered from 0. search and" << endl;
+    cout << "                locate latency percentiles are always printed" << endl;
+    cout << "   -perf        count cycles, instructions, LLC, dTLB and branch misses of the load, search and locate" << endl;
+    cout << "                phases with the hardware counters (Linux perf_event_open), if available. reading them" << endl;
+    cout << "                adds a system call to each phase of each pattern" << endl;
+    cout << "   -trace <out> record every pattern, with its seed bounds, result size and latency, to this binary" << endl;
+    cout << "                trace (see bri-replay)" << endl;
 	cout << "   <index>      index file (with extension .bri)" << endl;
 	cout << "   <patterns>   file in pizza&chili format containing the patterns." << endl;
     cout << "   <left>       length of the left region" << endl;
@@ -70,6 +85,43 @@ void parse_args(char** argv, int argc, int &ptr){
         ptr++;
 
 	}
+    else if (s.compare("-slowest") == 0)
+    {
+
+        if(ptr>=argc-1){
+            cout << "Error: missing parameter after -slowest option." << endl;
+            help();
+        }
+
+        char* e;
+        slowest = strtol(argv[ptr],&e,10);
+
+        if(*e != '\0' || slowest < 0){
+            cout << "Error: invalid negative value after -slowest option." << endl;
+            help();
+        }
+
+        ptr++;
+
+    }
+    else if (s.compare("-trace") == 0)
+    {
+
+        if(ptr>=argc-1){
+            cout << "Error: missing parameter after -trace option." << endl;
+            help();
+        }
+
+        trace_file = string(argv[ptr]);
+        ptr++;
+
+    }
+    else if (s.compare("-perf") == 0)
+    {
+
+        use_perf = true;
+
+    }
     else if (s.compare("-nplcp") == 0)
     {
 
@@ -94,6 +146,7 @@ void locate_all(ifstream& in, string patterns)
     using std::chrono::duration;
     using std::chrono::milliseconds;
     using std::chrono::microseconds;
+    using std::chrono::nanoseconds;
 
     string text;
     bool c = false;
@@ -108,6 +161,9 @@ void locate_all(ifstream& in, string patterns)
         text = ss.str();
     }
 
+    perf_counters perf(use_perf);
+    auto p1 = perf.now();
+
     auto t1 = high_resolution_clock::now();
 
     T idx;
@@ -116,6 +172,8 @@ void locate_all(ifstream& in, string patterns)
 
     auto t2 = high_resolution_clock::now();
 
+    perf.add("load", p1, perf.now());
+
     cout << "searching patterns with mismatches at most " << allowed << " ... " << endl;
     ifstream ifs(patterns);
 
@@ -139,6 +197,14 @@ void locate_all(ifstream& in, string patterns)
     ulint locate_time = 0;
     ulint tot_time = 0;
 
+    latency_histogram search_latency;
+    latency_histogram locate_latency;
+    slowest_queries slow(slowest);
+
+    unique_ptr<query_trace_writer> trace;
+    if (trace_file.compare(string()) != 0) trace.reset(new query_trace_writer(trace_file));
+    auto trace_start = high_resolution_clock::now();
+
     // extract patterns from file and search them in the index
     for (ulint i = 0; i < n; ++i)
     {
@@ -161,17 +227,42 @@ void locate_all(ifstream& in, string patterns)
         size_t m1 = left_len;
         size_t m2 = left_len + core_len;
 
+        query_stats::local().reset();
+        auto p3 = perf.now();
         t3 = high_resolution_clock::now();
         auto samples = idx.seed_and_extend(p,m1,m2,allowed);
         t4 = high_resolution_clock::now();
+        auto p4 = perf.now();
         auto occs = idx.locate_samples(samples);
         t5 = high_resolution_clock::now();
+        perf.add("search", p3, p4);
+        perf.add("locate", p4, perf.now());
 
         count_time += duration_cast<microseconds>(t4-t3).count();
         locate_time += duration_cast<microseconds>(t5-t4).count();
         occ_tot += occs.size();
         tot_time += duration_cast<microseconds>(t4-t3).count() + duration_cast<microseconds>(t5-t4).count();
 
+        ulint search_ns = duration_cast<nanoseconds>(t4-t3).count();
+        ulint locate_ns = duration_cast<nanoseconds>(t5-t4).count();
+        search_latency.record(search_ns);
+        locate_latency.record(locate_ns);
+        slow.push(to_string(i), '+', search_ns, locate_ns, occs.size(), query_stats::local());
+
+        if (trace)
+        {
+            trace_record r;
+            r.op = trace_record::SEED_EXTEND;
+            r.mismatches = allowed;
+            r.m1 = m1;
+            r.m2 = m2;
+            r.occ = occs.size();
+            r.start_ns = duration_cast<nanoseconds>(t3-trace_start).count();
+            r.latency_ns = search_ns + locate_ns;
+            r.pattern = p;
+            trace->write(r);
+        }
+
 
         if (c) // check occurrences
         {
@@ -226,7 +317,12 @@ void locate_all(ifstream& in, string patterns)
     cout << "Phi        time: " << locate_time << " microseconds" << endl;
     cout << "Total time : " << tot_time << " microseconds" << endl;
 	cout << "Search time: " << (double)tot_time/n << " microseconds/pattern (total: " << n << " patterns)" << endl;
-	cout << "Search time: " << (double)tot_time/occ_tot << " microseconds/occurrence (total: " << occ_tot << " occurrences)" << endl;
+	cout << "Search time: " << (double)tot_time/occ_tot << " microseconds/occurrence (total: " << occ_tot << " occurrences)" << endl << endl;
+
+    search_latency.print(cout, "Search latency");
+    locate_latency.print(cout, "Locate latency");
+    slow.print(cout);
+    perf.print(cout);
 }
 
 
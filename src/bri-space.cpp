@@ -7,11 +7,14 @@ using namespace std;
 using namespace bri;
 
 bool nplcp = false;
+bool json = false;
 
 void help(){
 	cout << "bri-space: breakdown of index space usage" << endl;
 	cout << "Usage:       bri-space [options] <index>" << endl;
 	cout << "   -nplcp    use the version without PLCP." << endl;
+	cout << "   -json     print the statistics and the space of each component as JSON, with the fraction of" << endl;
+	cout << "             the index and the bytes of rank/select supports" << endl;
 	cout << "   <index>   index file (with extension .bri)" << endl;
 	exit(0);
 }
@@ -29,6 +32,12 @@ void parse_args(char** argv, int argc, int &ptr){
         nplcp = true;
 
     }
+	else if (s.compare("-json") == 0)
+	{
+
+		json = true;
+
+	}
     else
     {
 		cout << "Error: unrecognized '" << s << "' option." << endl;
@@ -37,6 +46,26 @@ void parse_args(char** argv, int argc, int &ptr){
 
 }
 
+template<class T>
+void space(string const& idx_file){
+
+	T idx;
+
+	if (json)
+	{
+		idx.load_from_file(idx_file);
+		idx.write_space_json(cout);
+		return;
+	}
+
+	cout << "Loading br-index" << endl;
+	idx.load_from_file(idx_file);
+	cout << "--- Statistics of the text and the breakdown of the br-index space usage ---" << endl;
+
+	idx.print_space();
+
+}
+
 int main(int argc, char** argv){
 
 	if(argc < 2)
@@ -46,24 +75,8 @@ int main(int argc, char** argv){
 	while (ptr < argc-1) parse_args(argv, argc, ptr);
 
 	if (nplcp)
-	{
-		br_index_nplcp<> idx;
-
-		cout << "Loading br-index" << endl;
-		idx.load_from_file(argv[ptr]);
-		cout << "--- Statistics of the text and the breakdown of the br-index space usage ---" << endl;
-		
-		auto space = idx.print_space();
-	}
+		space<br_index_nplcp<> >(argv[ptr]);
 	else 
-	{
-		br_index<> idx;
-
-		cout << "Loading br-index" << endl;
-		idx.load_from_file(argv[ptr]);
-		cout << "--- Statistics of the text and the breakdown of the br-index space usage ---" << endl;
-		
-		auto space = idx.print_space();
-	}
+		space<br_index<> >(argv[ptr]);
 
 }
\ No newline at end of file
@@ -0,0 +1,136 @@
+/*
+ * build_config: construction options of the br-index (bri-build), and the
+ * peak memory report of the construction phases
+ */
+
+#ifndef INCLUDED_BUILD_CONFIG_HPP
+#define INCLUDED_BUILD_CONFIG_HPP
+
+#include "definitions.hpp"
+#include "suffix_sort.hpp"
+
+namespace bri {
+
+struct build_config {
+
+    // suffix sorting of text and textR
+    std::shared_ptr<suffix_sorter> sorter = std::make_shared<sdsl_suffix_sorter>(sdsl::SE_SAIS);
+
+    // with more than one thread, text and textR are built concurrently
+    ulint threads = 1;
+
+    // build from the prefix-free parses instead of the suffix arrays
+    bool pfp = false;
+
+    // directory of the temporary files (text, SA) of sdsl
+    std::string tmp_dir = "./";
+
+    // RAM budget in bytes, 0 if unlimited
+    ulint max_ram = 0;
+
+    build_config() {}
+
+    /*
+     * \param sais: use SE-SAIS for suffix sort, otherwise divsufsort
+     */
+    build_config(bool sais, ulint threads, bool pfp) : threads(threads), pfp(pfp)
+    {
+        sorter = std::make_shared<sdsl_suffix_sorter>(sais ? sdsl::SE_SAIS : sdsl::LIBDIVSUFSORT);
+    }
+
+    bool fits(ulint bytes) const
+    {
+        return max_ram == 0 || bytes <= max_ram;
+    }
+
+    /*
+     * chooses the suffix sorting of a text of length n within max_ram:
+     * about n bytes for the input, held during the whole construction,
+     * plus the bytes of the sorter (4n for the semi-external SE-SAIS), once
+     * per text when text and textR are sorted concurrently. over budget,
+     * the sorter falls back to SE-SAIS and then the two texts are sorted
+     * one after the other.
+     */
+    void fit_suffix_sort(ulint n)
+    {
+        if (pfp || max_ram == 0) return;
+
+        ulint copies = threads > 1 ? 2 : 1;
+
+        if (!sorter->semi_external() && !fits(n + copies * (ulint)(sorter->bytes_per_char() * n)))
+        {
+            std::cout << "RAM budget exceeded by " << sorter->name() << ": using SE-SAIS" << std::endl;
+            sorter = std::make_shared<sdsl_suffix_sorter>(sdsl::SE_SAIS);
+        }
+        ulint sort_bytes = (ulint)(sorter->bytes_per_char() * n);
+        if (copies == 2 && !fits(n + 2 * sort_bytes))
+        {
+            std::cout << "RAM budget exceeded by concurrent suffix sorting: sorting text and reversed text sequentially" << std::endl;
+            threads = 1;
+        }
+        if (!fits(n + sort_bytes))
+            std::cout << "Warning: the RAM budget is below the about " << n + sort_bytes << " bytes of " << sorter->name() << std::endl;
+    }
+
+};
+
+/*
+ * peak resident set size of each construction phase, read from the VmHWM
+ * line of /proc/self/status. the peak is reset between phases through
+ * /proc/self/clear_refs; where that is not possible (not Linux) the peaks
+ * are cumulative.
+ */
+class peak_rss_report {
+
+public:
+
+    peak_rss_report()
+    {
+        reset();
+    }
+
+    // the current phase ends
+    void phase(std::string const& name)
+    {
+        phases.push_back({name, peak_rss()});
+        reset();
+    }
+
+    void print()
+    {
+        std::cout << "Peak RSS per phase:" << std::endl;
+        for (auto& p: phases)
+            std::cout << "- " << p.first << ": " << p.second / (1024 * 1024) << " MB" << std::endl;
+        std::cout << std::endl;
+    }
+
+    /*
+     * peak resident set size in bytes, 0 if unknown
+     */
+    static ulint peak_rss()
+    {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line))
+        {
+            if (line.compare(0, 6, "VmHWM:") == 0)
+                return std::stoull(line.substr(6)) * 1024;
+        }
+        return 0;
+    }
+
+private:
+
+    static void reset()
+    {
+        std::ofstream clear_refs("/proc/self/clear_refs");
+        if (clear_refs) clear_refs << "5" << std::flush;
+    }
+
+    std::vector<std::pair<std::string, ulint> > phases;
+
+};
+
+};
+
+#endif /* INCLUDED_BUILD_CONFIG_HPP */
@@ -0,0 +1,321 @@
+/*
+ * bwt_construction: the first steps of the construction, shared by br_index
+ * and br_index_nplcp
+ *
+ *  the alphabet is remapped, text and textR are suffix sorted (or parsed)
+ *  and their BWTs are run-length encoded together with the SA samples at the
+ *  run boundaries. both indexes are then finished from the same
+ *  bwt_construction, so that .bri and .brin need a single suffix sorting of
+ *  each text (bri-build -both).
+ */
+
+#ifndef INCLUDED_BWT_CONSTRUCTION_HPP
+#define INCLUDED_BWT_CONSTRUCTION_HPP
+
+#include "definitions.hpp"
+#include "build_config.hpp"
+#include "prefix_free_parse.hpp"
+#include "rle_string.hpp"
+
+namespace bri {
+
+class bwt_construction {
+
+public:
+
+    typedef std::tuple<rle_string_builder, std::vector<range_t>, std::vector<range_t> > bwt_and_samples_t;
+
+    // filled by bwt_merge
+    bwt_construction() {}
+
+    /*
+     * steps (1/4) and (2/4) of the construction.
+     * \param input: string on which br-index is built
+     * \param config: construction options
+     * \param isa_at_samplesR: also find the ISA values at the text positions
+     *                         of the samples of textR (br_index_nplcp)
+     */
+    bwt_construction(std::string const& input, build_config config, bool isa_at_samplesR)
+    {
+        if (input.size() < 1)
+        {
+
+            std::cout << "Error: input string is empty" << std::endl;
+            exit(1);
+
+        }
+
+        std::cout << "Text length = " << input.size() << std::endl << std::endl;
+
+        config.fit_suffix_sort(input.size());
+
+        threads = config.threads;
+        bool pfp = config.pfp;
+
+        std::cout << "(1/4) Remapping alphabet ... " << std::flush;
+
+        // remap alphabet
+        remap = std::vector<uchar>(256,0);
+        remap_inv = std::vector<uchar>(256,0);
+        {
+            sigma = 1;
+            std::vector<ulint> freqs(256,0);
+            for (size_t i = 0; i < input.size(); ++i)
+            {
+                if (freqs[(uchar)input[i]]++ == 0) sigma++;
+                if (sigma >= 255)
+                {
+                    std::cout << "Error: alphabet cannot be remapped (overflow)" << std::endl;
+                    exit(1);
+                }
+            }
+            uchar new_c = 2; // avoid reserved chars
+            for (ulint c = 2; c < 256; ++c)
+            {
+                if (freqs[(uchar)c] != 0)
+                {
+                    remap[(uchar)c] = new_c;
+                    remap_inv[new_c++] = (uchar)c;
+                }
+            }
+        }
+
+        report.phase("(1/4) remapping");
+
+        std::cout << "done." << std::endl;
+        std::cout << "(2/4) Building BWT, BWT^R and computing SA samples";
+        if (pfp) std::cout << " (PFP) ... " << std::flush;
+        else std::cout << " (" << config.sorter->name() << ") ... " << std::flush;
+
+        // text and textR share only the remapped alphabet, so their suffix
+        // sorting pipelines are independent. configs are created here since
+        // sdsl generates their ids without synchronization
+        sdsl::cache_config cc(true, config.tmp_dir);
+        sdsl::cache_config ccR(true, config.tmp_dir);
+        config.sorter->configure();
+
+        std::launch policy = threads > 1 ? std::launch::async : std::launch::deferred;
+
+        // threads of each suffix sorting, text and textR being sorted concurrently
+        ulint sort_threads = std::max<ulint>(threads / 2, 1);
+
+        // configure & build reversed indexes for sufsort
+        // (deferred until rev.get() when single-threaded)
+        auto rev = std::async(policy, [&]()
+        {
+            bwt_and_samplesR = reversed_bwt_and_samples(input,remap,config,ccR,sort_threads);
+        });
+
+        // ISA values at the text positions of the samples of textR
+        auto isa_queries = [&]()
+        {
+            std::vector<ulint> queries;
+            for (auto s: std::get<1>(bwt_and_samplesR))
+                queries.push_back(input.size() >= s.first + 1 ? input.size() - 1 - s.first : 0);
+            for (auto s: std::get<2>(bwt_and_samplesR))
+                queries.push_back(input.size() >= s.first + 1 ? input.size() - 1 - s.first : 0);
+            return queries;
+        };
+
+        // configure & build indexes for sufsort
+        if (pfp)
+        {
+            prefix_free_parse parse(input,remap);
+
+            if (isa_at_samplesR)
+            {
+                // there is no ISA to look up later, so the ranks of the text
+                // positions of the samples of textR are found while enumerating SA
+                rev.wait();
+                bwt_and_samples = parse.bwt_and_samples(isa_queries(),isa_rows);
+            }
+            else
+            {
+                bwt_and_samples = parse.bwt_and_samples();
+            }
+            last_SA_val = (std::get<2>(bwt_and_samples).back().first + 1) % (input.size() + 1);
+        }
+        else
+        {
+            // remap input text
+            sdsl::int_vector<8> text(input.size());
+            for (size_t i = 0; i < input.size(); ++i)
+                text[i] = remap[(uchar)input[i]];
+
+            sdsl::append_zero_symbol(text);
+
+            // cache text
+            sdsl::store_to_cache(text, sdsl::conf::KEY_TEXT, cc);
+
+            // cache SA
+            config.sorter->sort(cc,sort_threads);
+
+            sdsl::int_vector_buffer<> sa(sdsl::cache_file_name(sdsl::conf::KEY_SA, cc));
+            last_SA_val = sa[sa.size()-1];
+            bwt_and_samples = sufsort(text,sa);
+            text = sdsl::int_vector<8>();
+
+            if (isa_at_samplesR)
+            {
+                // instead of building ISA (two words per position in RAM), its
+                // values at the samples of textR are found by a second
+                // sequential scan of the cached SA
+                rev.wait();
+                isa_rows = isa_at(sa,isa_queries());
+            }
+
+            // remove cache of text and SA
+            sdsl::remove(sdsl::cache_file_name(sdsl::conf::KEY_TEXT, cc));
+            sdsl::remove(sdsl::cache_file_name(sdsl::conf::KEY_SA, cc));
+        }
+
+        rev.get();
+
+        report.phase("(2/4) BWT & SA samples");
+
+        std::cout << "done." << std::endl;
+    }
+
+    // the structures of text and textR are built concurrently
+    ulint threads = 1;
+
+    // alphabet remapper
+    std::vector<uchar> remap;
+    std::vector<uchar> remap_inv;
+    ulint sigma = 0;
+
+    // SA[n], n being the length of text with the terminator
+    ulint last_SA_val = 0;
+
+    // run-length encoded BWT and SA samples at the first and last position
+    // of each run, in run order
+    bwt_and_samples_t bwt_and_samples;
+    bwt_and_samples_t bwt_and_samplesR;
+
+    // ISA values at the text positions of the first then the last samples
+    // of textR (isa_at_samplesR only)
+    std::vector<ulint> isa_rows;
+
+    peak_rss_report report;
+
+    // (text position, PLCP value) at the first position of each BWT run,
+    // sorted by text position, when already known (bwt_merge). otherwise
+    // PLCP is built from the text and the samples
+    std::vector<range_t> plcp_irreducible;
+
+    // runs of the ILCP of a FASTA index (first rows, values and SA values of
+    // the first rows), when already known (bwt_merge). otherwise ILCP is
+    // built by br_index::set_sequences
+    std::vector<ulint> ilcp_heads;
+    std::vector<ulint> ilcp_values;
+    std::vector<ulint> ilcp_samples;
+
+    /*
+     * BWT and SA samples of the reversed text, built as configured
+     * \param ccR: cache of textR and SAR, created by the caller
+     */
+    static bwt_and_samples_t reversed_bwt_and_samples(std::string const& input, std::vector<uchar> const& remap,
+                                                      build_config const& config, sdsl::cache_config& ccR, ulint threads)
+    {
+        if (config.pfp) return prefix_free_parse(input,remap,true).bwt_and_samples();
+
+        sdsl::int_vector<8> textR(input.size());
+        for (ulint i = 0; i < input.size(); ++i)
+            textR[i] = remap[(uchar)input[input.size()-1-i]];
+
+        sdsl::append_zero_symbol(textR);
+
+        // cache textR
+        sdsl::store_to_cache(textR, sdsl::conf::KEY_TEXT, ccR);
+
+        // cache SAR
+        config.sorter->sort(ccR,threads);
+
+        bwt_and_samples_t res;
+        {
+            sdsl::int_vector_buffer<> saR(sdsl::cache_file_name(sdsl::conf::KEY_SA, ccR));
+            res = sufsort(textR,saR);
+        }
+
+        // remove cache of textR and SAR
+        sdsl::remove(sdsl::cache_file_name(sdsl::conf::KEY_TEXT, ccR));
+        sdsl::remove(sdsl::cache_file_name(sdsl::conf::KEY_SA, ccR));
+
+        return res;
+    }
+
+private:
+
+    /*
+     * builds BWT, run-length encoded while SA is scanned
+     */
+    static bwt_and_samples_t sufsort(sdsl::int_vector<8>& text, sdsl::int_vector_buffer<>& sa)
+    {
+        rle_string_builder bwt_b;
+        std::vector<range_t> samples_first;
+        std::vector<range_t> samples_last;
+
+        // BWT character and SA sample of the previous position
+        uchar prev_c = 0;
+        ulint prev_sample = 0;
+
+        for (ulint i = 0; i < sa.size(); ++i)
+        {
+            auto x = sa[i];
+
+            assert(x <= text.size());
+
+            uchar c = x > 0 ? (uchar)text[x-1] : TERMINATOR;
+            ulint sample = x > 0 ? x - 1 : sa.size() - 1;
+
+            // insert samples at ends and beginnings of runs
+            if (i == 0 || c != prev_c)
+            {
+                if (i > 0) samples_last.push_back({prev_sample, samples_last.size()});
+                samples_first.push_back({sample, samples_first.size()});
+            }
+
+            bwt_b.push(c);
+
+            prev_c = c;
+            prev_sample = sample;
+        }
+        samples_last.push_back({prev_sample, samples_last.size()});
+
+        return bwt_and_samples_t(std::move(bwt_b), std::move(samples_first), std::move(samples_last));
+    }
+
+    /*
+     * ISA values at the text positions queries, found by a sequential scan
+     * of SA (nothing of size n is kept in RAM)
+     */
+    static std::vector<ulint> isa_at(sdsl::int_vector_buffer<>& sa, std::vector<ulint> const& queries)
+    {
+        // query indices grouped by text position
+        std::vector<range_t> by_pos;
+        for (ulint i = 0; i < queries.size(); ++i) by_pos.push_back({queries[i],i});
+        std::sort(by_pos.begin(), by_pos.end());
+
+        std::unordered_map<ulint,ulint> group;
+        for (ulint i = 0; i < by_pos.size(); ++i)
+            if (i == 0 || by_pos[i].first != by_pos[i-1].first) group[by_pos[i].first] = i;
+
+        std::vector<ulint> rows(queries.size());
+        for (ulint i = 0; i < sa.size(); ++i)
+        {
+            auto it = group.find(sa[i]);
+            if (it == group.end()) continue;
+
+            for (ulint j = it->second; j < by_pos.size() && by_pos[j].first == it->first; ++j)
+                rows[by_pos[j].second] = i;
+        }
+        return rows;
+    }
+
+    static const uchar TERMINATOR = 1;
+
+};
+
+};
+
+#endif /* INCLUDED_BWT_CONSTRUCTION_HPP */
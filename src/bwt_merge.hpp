@@ -0,0 +1,979 @@
+/*
+ * bwt_merge: incremental update of a br-index with a batch of new text
+ * (bri-merge)
+ *
+ *  the batch P is prepended to the indexed text T, so that the suffixes of T
+ *  keep their relative order in the BWT of PT. the suffixes of P.T are ranked
+ *  among the old ones by backward search of P from the row of T (LF with the
+ *  rank/select of the old run-length BWT), ordered among themselves by the
+ *  suffix sorting of their (old rank, character) pairs, and the old runs are
+ *  split at their insertion points. SA samples at the split points are
+ *  carried along the backward search as in the toehold lemma, and so are the
+ *  LCPs of each new suffix with the old rows around it: with the old PLCP
+ *  where two old rows stay adjacent they give the irreducible PLCP values.
+ *  T is never decoded. of the two LCPs with the old rows around a new
+ *  suffix the smaller one is the PLCP of these rows; when the search does
+ *  not carry the other one it is found by walking FL from the rows involved
+ *  and, together, Phi^{-1} over the old rows between them, in time
+ *  O(min(l, d)) for an LCP l and d rows between. the LCPs of the new
+ *  suffixes with each other are found as in Kasai et al. in O(|P|) time,
+ *  walking on T only past the end of the batch.
+ *
+ *  in the reversed text T^R P^R the suffixes of T^R are followed by P^R
+ *  instead of the terminator, which changes the order of u and uw only if w
+ *  starts with a character not larger than the first one of P^R (the
+ *  separator closing the batch of a FASTA index). u is then (T[0..k])^R with
+ *  T[0..k] occurring after such a character: these K suffixes, K being
+ *  found by right extensions of the prefixes of T, are removed from BWT^R
+ *  and inserted again with the suffixes of P^R, ranked by backward search on
+ *  the old BWT^R as above. SA^R samples at the split points come from the
+ *  toehold and from Phi/Phi^{-1} of the old SA^R samples next to the removed
+ *  rows. only the O(|P| + K) inserted suffixes are sorted and both BWTs are
+ *  visited run by run: O((|P| + K) log(|P| + K) + r + rR) operations, plus
+ *  the LCP walks. these are bounded by the LCPs of the new suffixes with
+ *  the old ones, O(|P| max LCP) in the worst case (a batch repeating a
+ *  long substring of T), and are usually short. the ILCP of a FASTA index
+ *  is merged the same way, by splitting its runs at the inserted rows.
+ */
+
+#ifndef INCLUDED_BWT_MERGE_HPP
+#define INCLUDED_BWT_MERGE_HPP
+
+#include "definitions.hpp"
+#include "bwt_construction.hpp"
+#include "br_index.hpp"
+#include "suffix_sort.hpp"
+
+namespace bri {
+
+class bwt_merge {
+
+public:
+
+    /*
+     * steps (1/4) and (2/4) of the construction of the br-index of the batch
+     * followed by the text indexed by idx, to be finished by br_index(bc)
+     * \param batch: the new text
+     * \param threads: with 2 or more, BWT and BWT^R are merged concurrently
+     */
+    template<class sparse_bitvector_t, class rle_string_t>
+    static bwt_construction merge(br_index<sparse_bitvector_t,rle_string_t>& idx, std::string const& batch,
+                                  ulint threads = 1)
+    {
+        // rows of the old and of the merged BWT
+        ulint m = batch.size();
+        ulint N1 = idx.bwt.size();
+        ulint N = N1 + m;
+
+        if (m == 0)
+        {
+            std::cout << "Error: the batch is empty" << std::endl;
+            exit(1);
+        }
+
+        std::cout << "Text length = " << N - 1 << " (" << m << " new)" << std::endl << std::endl;
+
+        bwt_construction bc;
+        bc.threads = threads;
+
+        std::cout << "(1/4) Remapping alphabet ... " << std::flush;
+
+        // the old characters and those of the batch, remapped in byte order
+        // as in bwt_construction. the old codes keep their order
+        bc.remap = std::vector<uchar>(256,0);
+        bc.remap_inv = std::vector<uchar>(256,0);
+        {
+            std::vector<bool> present(256,false);
+            for (ulint c = 2; c < 256; ++c) present[c] = idx.remap[c] != 0;
+            for (ulint i = 0; i < m; ++i) present[(uchar)batch[i]] = true;
+
+            bc.sigma = 1;
+            uchar new_c = 2; // avoid reserved chars
+            for (ulint c = 2; c < 256; ++c)
+            {
+                if (!present[c]) continue;
+                if (++bc.sigma >= 255)
+                {
+                    std::cout << "Error: alphabet cannot be remapped (overflow)" << std::endl;
+                    exit(1);
+                }
+                bc.remap[(uchar)c] = new_c;
+                bc.remap_inv[new_c++] = (uchar)c;
+            }
+        }
+
+        // old code -> new code, and occurrences in the old BWT per new code
+        std::vector<uchar> recode(256,0);
+        std::vector<uchar> old_code(256,0);
+        std::vector<ulint> count(256,0);
+        recode[TERMINATOR] = TERMINATOR;
+        old_code[TERMINATOR] = TERMINATOR;
+        for (ulint c = 2; c < 256; ++c)
+        {
+            if (idx.remap[c] == 0) continue;
+            recode[idx.remap[c]] = bc.remap[c];
+            old_code[bc.remap[c]] = idx.remap[c];
+        }
+        for (ulint c = 1; c < 256; ++c)
+            if (old_code[c] != 0)
+                count[c] = (old_code[c] < 255 ? idx.F[old_code[c]+1] : N1) - idx.F[old_code[c]];
+
+        // C[c]: old suffixes starting with a character smaller than c.
+        // prev_char/next_char: closest characters of the old BWT around c
+        std::vector<ulint> C(257,0);
+        for (ulint c = 1; c < 256; ++c) C[c+1] = C[c] + count[c];
+
+        std::vector<uchar> prev_char(256,0);
+        std::vector<uchar> next_char(256,0);
+        for (ulint c = 1, last = 0; c < 256; ++c)
+        {
+            prev_char[c] = (uchar)last;
+            if (count[c] > 0) last = c;
+        }
+        for (ulint c = 255, last = 0; c > 0; --c)
+        {
+            next_char[c] = (uchar)last;
+            if (count[c] > 0) last = c;
+        }
+
+        bc.report.phase("(1/4) remapping");
+
+        std::cout << "done." << std::endl;
+        std::cout << "(2/4) Merging BWT and BWT^R ... " << std::flush;
+
+        std::launch policy = bc.threads > 1 ? std::launch::async : std::launch::deferred;
+        ulint sort_threads = std::max<ulint>(bc.threads / 2, 1);
+
+        auto rev = std::async(policy, [&]()
+        {
+            bc.bwt_and_samplesR = merge_reversed(idx,batch,bc.remap,recode,old_code,count,C,sort_threads);
+        });
+
+        // SA value of the old row LF(y), given SA[y]
+        auto sa_lf = [&](ulint sa) { return (sa + N1 - 1) % N1; };
+        auto sa_first = [&](ulint run) -> ulint { return (idx.samples_first[run] + 1) % N1; };
+        auto sa_last = [&](ulint run) -> ulint { return (idx.samples_last[run] + 1) % N1; };
+
+        // the merged text from a position of the batch, (i,0) with i < m,
+        // or from an old row, (m,y): past the batch, FL on the old BWT.
+        // t_rows: the rows of the first suffixes of T, as far as needed
+        ulint p0 = idx.terminator_position;
+        std::vector<ulint> t_rows(1,p0);
+        auto cursor = [&](ulint i) -> range_t
+        {
+            if (i < m) return range_t(i,0);
+            while (t_rows.size() <= i - m) t_rows.push_back(idx.FL(t_rows.back()));
+            return range_t(m,t_rows[i - m]);
+        };
+        auto char_at = [&](range_t const& u) -> uchar
+        {
+            if (u.first < m) return bc.remap[(uchar)batch[u.first]];
+            uchar c = idx.F_at(u.second);
+            return c == TERMINATOR ? TERMINATOR : recode[c];
+        };
+        auto advance = [&](range_t& u)
+        {
+            if (u.first < m)
+            {
+                if (++u.first == m) u.second = p0;
+            }
+            else u.second = idx.FL(u.second);
+        };
+
+        // LCP of the old rows a < b (SA value sa_a at a), at most cap and
+        // known to be at least floor: by FL from both rows, or as the
+        // minimum of the PLCP values of the rows after a up to b, read by
+        // Phi^{-1}, whichever ends first
+        auto old_lcp = [&](ulint a, ulint sa_a, ulint b, ulint cap, ulint floor) -> ulint
+        {
+            if (cap <= floor) return cap;
+
+            ulint u = a, v = b, l = 0;
+            ulint row = a, sa = sa_a, low = N;
+            while (true)
+            {
+                uchar c = idx.F_at(u);
+                if (c == TERMINATOR || c != idx.F_at(v)) return l;
+                if (++l == cap) return cap;
+                u = idx.FL(u);
+                v = idx.FL(v);
+
+                sa = idx.PhiI(sa);
+                low = std::min<ulint>(low, idx.plcp[sa]);
+                if (++row == b || low <= floor) return std::min(cap, low);
+            }
+        };
+
+        // backward search of the batch from the row p0 of T. the suffix at i
+        // is inserted before old row g[i], between the old rows with SA
+        // values before[i] and at[i] (the latter undefined if g[i] == N1),
+        // with which it shares lcp_before[i] and lcp_at[i] characters. the
+        // suffix T at m is the old row p0 itself.
+        // the smaller of lcp_before[i] and lcp_at[i] is the LCP of the two
+        // old rows, in PLCP: the other one is only walked (old_lcp) if the
+        // search does not carry it and it may be larger
+        std::vector<ulint> g(m+1), at(m+1), before(m+1), lcp_before(m+1), lcp_at(m+1);
+        g[m] = p0;
+        at[m] = 0;
+        before[m] = sa_last(idx.bwt.run_of_position(p0) - 1);
+        lcp_before[m] = idx.plcp[0];
+        lcp_at[m] = N;
+
+        for (ulint i = m; i-- > 0;)
+        {
+            uchar c = bc.remap[(uchar)batch[i]];
+            uchar c_old = old_code[c];
+            ulint k = c_old ? idx.bwt.rank(g[i+1],c_old) : 0;
+            ulint s = g[i+1];
+
+            g[i] = C[c] + k;
+            lcp_at[i] = 0;
+
+            // rows whose LCP with s (s-1) gives lcp_at[i] (lcp_before[i]),
+            // if not carried by the search
+            bool walk_at = false, walk_before = false;
+            ulint y_at = 0, y_before = 0, sa_y_before = 0;
+
+            if (k < count[c])
+            {
+                // first c at or after s: a run head unless at s. the LCP
+                // with LF of it is one more than that of the suffix at i+1
+                // with it, the LCP of rows s and s+1 being in PLCP
+                ulint y = idx.bwt.select(k,c_old);
+                ulint run = idx.bwt.run_of_position(y);
+                at[i] = sa_lf(y == s ? at[i+1] : sa_first(run));
+
+                if (y == s) lcp_at[i] = 1 + lcp_at[i+1];
+                else if (y == s + 1) lcp_at[i] = 1 + std::min(lcp_at[i+1], idx.plcp[sa_first(run)]);
+                else
+                {
+                    walk_at = true;
+                    y_at = y;
+                }
+            }
+            else if (g[i] < N1)
+            {
+                // first row of the next character
+                ulint y = idx.bwt.select(0,old_code[next_char[c]]);
+                at[i] = sa_lf(sa_first(idx.bwt.run_of_position(y)));
+            }
+
+            if (k > 0)
+            {
+                // last c before s: a run tail unless at s-1
+                ulint y = idx.bwt.select(k-1,c_old);
+                ulint sa_y = sa_last(idx.bwt.run_of_position(y));
+                before[i] = sa_lf(y == s - 1 ? before[i+1] : sa_y);
+
+                if (y == s - 1) lcp_before[i] = 1 + lcp_before[i+1];
+                else if (y == s - 2) lcp_before[i] = 1 + std::min(lcp_before[i+1], idx.plcp[before[i+1]]);
+                else
+                {
+                    walk_before = true;
+                    y_before = y;
+                    sa_y_before = sa_y;
+                }
+            }
+            else
+            {
+                // last row of the previous character (at least the terminator)
+                uchar e = prev_char[c];
+                ulint y = idx.bwt.select(count[e] - 1,old_code[e]);
+                before[i] = sa_lf(sa_last(idx.bwt.run_of_position(y)));
+                lcp_before[i] = 0;
+            }
+
+            // both LCPs are at least that of the old rows around the suffix,
+            // and one of them is equal to it
+            ulint around = g[i] < N1 ? idx.plcp[at[i]] : 0;
+            ulint floor = around > 0 ? around - 1 : 0;
+            auto lcp_at_s = [&]() { return 1 + old_lcp(s, at[i+1], y_at, lcp_at[i+1], floor); };
+            auto lcp_before_s = [&]() { return 1 + old_lcp(y_before, sa_y_before, s - 1, lcp_before[i+1], floor); };
+
+            if (walk_at && walk_before)
+            {
+                lcp_at[i] = lcp_at_s();
+                lcp_before[i] = lcp_at[i] > around ? around : lcp_before_s();
+            }
+            else if (walk_at) lcp_at[i] = lcp_before[i] > around ? around : lcp_at_s();
+            else if (walk_before) lcp_before[i] = lcp_at[i] > around ? around : lcp_before_s();
+        }
+
+        // suffixes of the batch in lexicographic order: suffixes inserted at
+        // the same row compare by their first character, then as the
+        // suffixes following it. so they are sorted as the suffixes of the
+        // string of the ranks of (g[i], P[i]), the suffix T at m ranking
+        // after any suffix of the batch inserted at its own row p0
+        std::vector<ulint> order;
+        std::vector<ulint> prev(m,N);
+        {
+            std::vector<ulint> z(m+1);
+            for (ulint i = 0; i <= m; ++i) z[i] = i;
+            auto key = [&](ulint i) { return range_t(g[i], i < m ? (uchar)batch[i] : 256); };
+
+            ulint last = N;
+            for (auto i: sorted_suffixes(z, key, sort_threads))
+            {
+                if (i < m)
+                {
+                    order.push_back(i);
+                    prev[i] = last;
+                }
+                last = i;
+            }
+        }
+
+        // lcp_prev[i]: LCP of the suffix at i with the one at prev[i], the
+        // suffix of PT before it among those at 0...m, up to the end of the
+        // batch (m - i). as in Kasai et al. it is at least lcp_prev[i-1] - 1
+        // if prev[i-1] + 1 is one of them: O(m) comparisons, and the first
+        // m characters of T at most
+        std::vector<ulint> lcp_prev(m,0);
+        for (ulint i = 0, l = 0; i < m; ++i)
+        {
+            ulint j = prev[i];
+            if (j == N)
+            {
+                l = 0;
+                continue;
+            }
+
+            range_t u = cursor(i + l), v = cursor(j + l);
+            for (; l < m - i; ++l)
+            {
+                uchar c = char_at(u);
+                if (c != char_at(v)) break;
+                advance(u);
+                advance(v);
+            }
+            lcp_prev[i] = l;
+            l = j < m && l > 0 ? l - 1 : 0;
+        }
+
+        // merged BWT, emitted in row order
+        rle_string_builder bwt_b;
+        std::vector<range_t> samples_first;
+        std::vector<range_t> samples_last;
+
+        uchar cur_c = 0;
+        ulint rows = 0;
+        ulint prev_sa = 0;  // merged SA value of the previous row
+        ulint prev_new = m; // its position in the batch, m if old
+
+        auto sample = [&](ulint sa) { return sa > 0 ? sa - 1 : N - 1; };
+        auto starts_run = [&](uchar c) { return rows == 0 || c != cur_c; };
+
+        // LCP of the suffix at i with the one at j = prev[i], inserted just
+        // before it at the same old row: lcp_prev unless it reaches the end
+        // of the batch, then one of their LCPs with the old rows around
+        // tells it unless they are equal, else the rest of it is walked
+        // from T and from the suffix at j + m - i
+        auto lcp_new = [&](ulint j, ulint i) -> ulint
+        {
+            if (lcp_prev[i] < m - i) return lcp_prev[i];
+            if (lcp_before[i] < lcp_before[j]) return lcp_before[i];
+            if (g[i] < N1 && lcp_at[j] < lcp_at[i]) return lcp_at[j];
+
+            ulint l = m - i;
+            range_t u = cursor(m), v = cursor(j + l);
+            for (uchar c; (c = char_at(u)) != TERMINATOR && c == char_at(v); ++l)
+            {
+                advance(u);
+                advance(v);
+            }
+            return l;
+        };
+
+        auto emit = [&](uchar c, ulint len, ulint sa_a, ulint sa_b, ulint plcp_a)
+        {
+            if (starts_run(c))
+            {
+                if (rows > 0) samples_last.push_back({sample(prev_sa), samples_last.size()});
+                samples_first.push_back({sample(sa_a), samples_first.size()});
+                bc.plcp_irreducible.push_back({sa_a, rows > 0 ? plcp_a : 0});
+            }
+            bwt_b.push(c,len);
+            cur_c = c;
+            rows += len;
+            prev_sa = sa_b;
+        };
+
+        // old rows [a,b), with SA values sa_a at a and sa_b at b-1
+        ulint run = 0;
+        ulint run_s = 0;
+        ulint run_len = idx.bwt.run_at(0);
+        auto emit_old = [&](ulint a, ulint b, ulint sa_a, ulint sa_b)
+        {
+            while (a < b)
+            {
+                while (run_s + run_len <= a)
+                {
+                    run_s += run_len;
+                    run_len = idx.bwt.run_at(++run);
+                }
+                ulint e = std::min(b, run_s + run_len);
+
+                ulint first = a == run_s ? sa_first(run) : sa_a;
+                ulint last = e == run_s + run_len ? sa_last(run) : sa_b;
+
+                // T is now preceded by the last character of the batch
+                uchar c = idx.bwt.run_head(run);
+                c = c == TERMINATOR ? bc.remap[(uchar)batch[m-1]] : recode[c];
+
+                ulint l = 0;
+                if (starts_run(c) && rows > 0)
+                    l = prev_new == m ? idx.plcp[first] : lcp_at[prev_new];
+
+                emit(c, e - a, first + m, last + m, l);
+                prev_new = m;
+                a = e;
+            }
+        };
+
+        ulint x = 0;       // next old row
+        ulint sa_x = 0;    // its SA value, if not at a run head
+        for (auto i: order)
+        {
+            if (x < g[i]) emit_old(x, g[i], sa_x, before[i]);
+            x = g[i];
+            sa_x = at[i];
+
+            uchar c = i > 0 ? bc.remap[(uchar)batch[i-1]] : TERMINATOR;
+            ulint l = 0;
+            if (starts_run(c)) l = prev_new == m ? lcp_before[i] : lcp_new(prev_new, i);
+
+            emit(c, 1, i, i, l);
+            prev_new = i;
+        }
+        if (x < N1) emit_old(x, N1, sa_x, sa_last(idx.bwt.number_of_runs() - 1));
+        samples_last.push_back({sample(prev_sa), samples_last.size()});
+
+        assert(rows == N);
+
+        if (idx.number_of_sequences() > 0) merge_ilcp(idx, batch, order, g, at, bc, cursor, char_at, advance);
+
+        bc.last_SA_val = prev_sa;
+        std::sort(bc.plcp_irreducible.begin(), bc.plcp_irreducible.end());
+        bc.bwt_and_samples = bwt_construction::bwt_and_samples_t(std::move(bwt_b), std::move(samples_first), std::move(samples_last));
+
+        rev.get();
+
+        bc.report.phase("(2/4) BWT & BWT^R merge");
+
+        std::cout << "done." << std::endl;
+
+        return bc;
+    }
+
+private:
+
+    /*
+     * ILCP runs of a FASTA index (see interleaved_lcp) for the merged text,
+     * given the order of the suffixes of the batch and their rows in the old
+     * BWT (see merge). the rows of T keep their values, since the closest
+     * row before them in the same document is still one of T: the old runs
+     * are split by the rows of the batch, whose values are the LCPs with the
+     * closest suffix of the batch before them in the same document, its
+     * documents being those of the batch only. no row of T is visited, and
+     * the walks past the end of the batch are bounded by its longest LCP
+     * with another suffix of the batch
+     */
+    template<class sparse_bitvector_t, class rle_string_t, class F, class G, class H>
+    static void merge_ilcp(br_index<sparse_bitvector_t,rle_string_t>& idx, std::string const& batch,
+                           std::vector<ulint> const& order, std::vector<ulint> const& g, std::vector<ulint> const& at,
+                           bwt_construction& bc, F cursor, G char_at, H advance)
+    {
+        ulint m = batch.size();
+        ulint N1 = idx.bwt.size();
+
+        // lcp[k]: LCP of the suffixes of the batch at order[k-1] and
+        // order[k], as in Kasai et al.
+        std::vector<ulint> rank(m);
+        std::vector<ulint> lcp(m,0);
+        for (ulint k = 0; k < m; ++k) rank[order[k]] = k;
+        for (ulint i = 0, l = 0; i < m; ++i)
+        {
+            if (rank[i] == 0)
+            {
+                l = 0;
+                continue;
+            }
+
+            ulint j = order[rank[i]-1];
+            range_t u = cursor(i + l), v = cursor(j + l);
+            for (uchar c; (c = char_at(u)) != TERMINATOR && c == char_at(v); ++l)
+            {
+                advance(u);
+                advance(v);
+            }
+            lcp[rank[i]] = l;
+            l = j + 1 < m && l > 0 ? l - 1 : 0;
+        }
+
+        // documents of the batch: those of its separators
+        std::vector<ulint> doc(m);
+        ulint docs = 0;
+        for (ulint i = 0; i < m; ++i)
+        {
+            doc[i] = docs;
+            if ((uchar)batch[i] == SEQUENCE_SEPARATOR) ++docs;
+        }
+
+        // ILCP of the rows of the batch in order, as in interleaved_lcp
+        std::vector<ulint> value(m,0);
+        {
+            std::vector<ulint> last(docs + 1, m);
+            std::vector<range_t> mins;
+            for (ulint k = 0; k < m; ++k)
+            {
+                ulint l = k > 0 ? lcp[k] : 0;
+                while (!mins.empty() && mins.back().second >= l) mins.pop_back();
+                mins.push_back({k, l});
+
+                ulint d = doc[order[k]];
+                if (last[d] < m)
+                    value[k] = std::lower_bound(mins.begin(), mins.end(), range_t(last[d] + 1, 0))->second;
+                last[d] = k;
+            }
+        }
+
+        // merged runs: a row starts one if its value differs from the one
+        // of the row before
+        auto push = [&](ulint row, ulint v, ulint sa)
+        {
+            if (!bc.ilcp_values.empty() && v == bc.ilcp_values.back()) return;
+            bc.ilcp_heads.push_back(row);
+            bc.ilcp_values.push_back(v);
+            bc.ilcp_samples.push_back(sa);
+        };
+
+        // old rows [a,b) at a + shift, with SA value sa_a at a
+        auto& ilcp = idx.ilcp;
+        ulint run = 0;
+        auto push_old = [&](ulint a, ulint b, ulint sa_a, ulint shift)
+        {
+            while (run + 1 < ilcp.runs() && ilcp.head(run + 1) <= a) ++run;
+            push(a + shift, ilcp.value(run), (ilcp.head(run) == a ? ilcp.sample(run) : sa_a) + m);
+            while (run + 1 < ilcp.runs() && ilcp.head(run + 1) < b)
+            {
+                ++run;
+                push(ilcp.head(run) + shift, ilcp.value(run), ilcp.sample(run) + m);
+            }
+        };
+
+        ulint x = 0;       // next old row
+        ulint sa_x = 0;    // its SA value, if not at a run head
+        for (ulint k = 0; k < m; ++k)
+        {
+            ulint i = order[k];
+            if (x < g[i]) push_old(x, g[i], sa_x, k);
+            x = g[i];
+            sa_x = at[i];
+            push(g[i] + k, value[k], i);
+        }
+        if (x < N1) push_old(x, N1, sa_x, m);
+    }
+
+    /*
+     * BWT^R and SA^R samples of the merged text, T^R P^R (see the top of the
+     * file). the arguments are those of merge and its remapping
+     */
+    template<class sparse_bitvector_t, class rle_string_t>
+    static bwt_construction::bwt_and_samples_t merge_reversed(br_index<sparse_bitvector_t,rle_string_t>& idx,
+        std::string const& batch, std::vector<uchar> const& remap, std::vector<uchar> const& recode,
+        std::vector<uchar> const& old_code, std::vector<ulint> const& count, std::vector<ulint> const& C,
+        ulint threads)
+    {
+        ulint m = batch.size();
+        ulint N1 = idx.bwtR.size();
+        ulint n = N1 - 1;
+        ulint N = N1 + m;
+        ulint rR = idx.bwtR.number_of_runs();
+
+        // K: the prefixes T[0..k], k < K, occurring after a character not
+        // larger than the last one of the batch (the count of the BWT range
+        // of T[0..k] over these characters). prefix: T[0..K], or T if K = n
+        std::string prefix;
+        ulint K = 0;
+        {
+            std::vector<uchar> low;
+            for (ulint c = 2; c < 256; ++c)
+                if (idx.remap[c] != 0 && c <= (uchar)batch[m-1]) low.push_back(idx.remap[c]);
+
+            br_sample sample = idx.get_initial_sample();
+            for (ulint row = idx.terminator_position; K < n; ++K)
+            {
+                prefix.push_back((char)idx.remap_inv[idx.F_at(row)]);
+                row = idx.FL(row);
+
+                sample = idx.right_extension((uchar)prefix.back(),sample);
+                ulint after = 0;
+                for (auto a: low) after += idx.bwt.rank(sample.range.second+1,a) - idx.bwt.rank(sample.range.first,a);
+                if (after == 0) break;
+            }
+        }
+
+        // new code of T[K], which precedes the inserted suffixes (0 if K = n)
+        uchar c_K = K < n ? remap[(uchar)prefix[K]] : 0;
+
+        // removed rows: e_row[0] of the terminator, e_row[j] of (T[0..j-1])^R.
+        // the SA^R value of e_row[j] is n-j, and T[j] precedes it
+        std::vector<ulint> e_row(K+1,0);
+        for (ulint j = 1; j <= K; ++j) e_row[j] = idx.LFR(e_row[j-1]);
+
+        // (row, j) of the removed rows in row order, and per old code the
+        // (rank, j) of those preceded by it, with the next and the previous
+        // rank of a kept row for each
+        std::vector<range_t> removed;
+        std::vector<std::vector<range_t> > removed_c(256);
+        for (ulint j = 0; j <= K; ++j)
+        {
+            uchar c = idx.bwtR[e_row[j]];
+            removed.push_back({e_row[j], j});
+            removed_c[c].push_back({idx.bwtR.rank(e_row[j],c), j});
+        }
+        std::sort(removed.begin(), removed.end());
+
+        std::vector<std::vector<ulint> > next_kept_c(256), prev_kept_c(256);
+        for (ulint c = 1; c < 256; ++c)
+        {
+            auto& v = removed_c[c];
+            std::sort(v.begin(), v.end());
+            next_kept_c[c].resize(v.size());
+            prev_kept_c[c].resize(v.size());
+            for (ulint t = v.size(); t-- > 0;)
+                next_kept_c[c][t] = t + 1 < v.size() && v[t+1].first == v[t].first + 1 ? next_kept_c[c][t+1] : v[t].first + 1;
+            for (ulint t = 0; t < v.size(); ++t)
+                prev_kept_c[c][t] = t > 0 && v[t-1].first + 1 == v[t].first ? prev_kept_c[c][t-1] : v[t].first;
+        }
+
+        // removed c of the old BWT^R of rank < k
+        auto removed_before = [&](uchar c, ulint k) -> ulint
+        {
+            auto& v = removed_c[c];
+            return std::lower_bound(v.begin(), v.end(), range_t(k,0)) - v.begin();
+        };
+
+        // first rank >= k of a kept c, and 1 + the last rank < k (0 if none)
+        auto next_kept = [&](uchar c, ulint k) -> ulint
+        {
+            ulint t = removed_before(c,k);
+            return t < removed_c[c].size() && removed_c[c][t].first == k ? next_kept_c[c][t] : k;
+        };
+        auto prev_kept = [&](uchar c, ulint k) -> ulint
+        {
+            if (k == 0) return 0;
+            ulint t = removed_before(c,k-1);
+            return t < removed_c[c].size() && removed_c[c][t].first == k-1 ? prev_kept_c[c][t] : k;
+        };
+
+        // j of the removed c of rank k
+        auto removed_j = [&](uchar c, ulint k) { return removed_c[c][removed_before(c,k)].second; };
+
+        // old row of the t-th kept row, N1 if t is their number
+        ulint kept = N1 - (K+1);
+        std::vector<ulint> shift(K+1);
+        for (ulint t = 0; t <= K; ++t) shift[t] = removed[t].first - t;
+        auto kept_row = [&](ulint t) -> ulint
+        {
+            return t < kept ? t + (std::upper_bound(shift.begin(), shift.end(), t) - shift.begin()) : N1;
+        };
+
+        // removed rows starting with a character smaller than c (new code)
+        std::vector<ulint> removed_below(257,0);
+        removed_below[TERMINATOR+1]++;
+        for (ulint j = 1; j <= K; ++j) removed_below[remap[(uchar)prefix[j-1]]+1]++;
+        for (ulint c = 1; c < 256; ++c) removed_below[c+1] += removed_below[c];
+
+        // Phi and Phi^{-1} of the old SA^R, from the SA^R values at the first
+        // (last) row of each run and at the row before (after) it
+        auto sa_firstR = [&](ulint run) -> ulint { return (idx.samples_firstR[run] + 1) % N1; };
+        auto sa_lastR = [&](ulint run) -> ulint { return (idx.samples_lastR[run] + 1) % N1; };
+        auto sa_lf = [&](ulint sa) { return (sa + N1 - 1) % N1; };
+
+        std::vector<range_t> heads, tails;
+        for (ulint k = 1; k < rR; ++k)
+        {
+            heads.push_back({sa_firstR(k), sa_lastR(k-1)});
+            tails.push_back({sa_lastR(k-1), sa_firstR(k)});
+        }
+        std::sort(heads.begin(), heads.end());
+        std::sort(tails.begin(), tails.end());
+
+        auto step = [&](std::vector<range_t> const& v, ulint i) -> ulint
+        {
+            auto it = std::upper_bound(v.begin(), v.end(), range_t(i,N1));
+            if (it == v.begin()) it = v.end();
+            --it;
+            return (it->second + i + N1 - it->first) % N1;
+        };
+        auto phi = [&](ulint i) { return step(heads,i); };
+        auto phi_inv = [&](ulint i) { return step(tails,i); };
+
+        // SA^R value of the kept c of rank k at row y: at a run head or
+        // after a removed c, at a run tail or before a removed c
+        auto sa_kept_first = [&](uchar c, ulint k, ulint y) -> ulint
+        {
+            if (y == 0 || idx.bwtR[y-1] != c) return sa_firstR(idx.bwtR.run_of_position(y));
+            return phi_inv(n - removed_j(c,k-1));
+        };
+        auto sa_kept_last = [&](uchar c, ulint k, ulint y) -> ulint
+        {
+            if (y == n || idx.bwtR[y+1] != c) return sa_lastR(idx.bwtR.run_of_position(y));
+            return phi(n - removed_j(c,k+1));
+        };
+
+        // T[K] precedes the removed row of (T[0..K-1])^R: the kept row of
+        // (T[0..K])^R follows it in LF
+        ulint row_K = c_K ? idx.F[old_code[c_K]] + idx.bwtR.rank(e_row[K],old_code[c_K]) : N1;
+        ulint sa_K = n - K - 1;
+
+        // first and last kept row starting with c, N1 if none, with their
+        // SA^R values
+        std::vector<ulint> first_row(257,N1), first_sa(257,0), last_row(257,N1), last_sa(257,0);
+        for (ulint c = 2; c < 256; ++c)
+        {
+            uchar co = old_code[c];
+            if (count[c] == 0) continue;
+
+            ulint k = next_kept(co,0);
+            if (k < count[c])
+            {
+                ulint y = idx.bwtR.select(k,co);
+                first_row[c] = C[c] + k;
+                first_sa[c] = sa_lf(sa_kept_first(co,k,y));
+            }
+            k = prev_kept(co,count[c]);
+            if (k > 0)
+            {
+                ulint y = idx.bwtR.select(k-1,co);
+                last_row[c] = C[c] + k - 1;
+                last_sa[c] = sa_lf(sa_kept_last(co,k-1,y));
+            }
+            if (c == c_K)
+            {
+                if (row_K < first_row[c]) { first_row[c] = row_K; first_sa[c] = sa_K; }
+                if (last_row[c] == N1 || row_K > last_row[c]) { last_row[c] = row_K; last_sa[c] = sa_K; }
+            }
+        }
+
+        // closest characters after and before c with a kept row
+        std::vector<uchar> next_kept_char(257,0), prev_kept_char(257,0);
+        for (ulint c = 255; c-- > 1;) next_kept_char[c] = first_row[c+1] < N1 ? c+1 : next_kept_char[c+1];
+        for (ulint c = 2; c < 256; ++c) prev_kept_char[c] = last_row[c-1] < N1 ? c-1 : prev_kept_char[c-1];
+
+        // the suffixes inserted, B = (T[0..K-1])^R P^R and the terminator.
+        // smaller[b]: the suffix of B at 0 is smaller than the one at b (Z
+        // algorithm: their LCP, then the next characters)
+        ulint nb = K + m + 1;
+        std::vector<uchar> B(nb);
+        for (ulint b = 0; b < K; ++b) B[b] = remap[(uchar)prefix[K-1-b]];
+        for (ulint b = 0; b < m; ++b) B[K+b] = remap[(uchar)batch[m-1-b]];
+        B[nb-1] = TERMINATOR;
+
+        std::vector<bool> smaller(nb,false);
+        {
+            std::vector<ulint> z(nb,0);
+            for (ulint b = 1, l = 0, r = 0; b < nb; ++b)
+            {
+                if (b < r) z[b] = std::min(r - b, z[b-l]);
+                while (b + z[b] < nb && B[z[b]] == B[b+z[b]]) ++z[b];
+                if (b + z[b] > r)
+                {
+                    l = b;
+                    r = b + z[b];
+                }
+                smaller[b] = B[z[b]] < B[b+z[b]];
+            }
+        }
+
+        // backward search of B from the terminator: the suffix at b has
+        // kept[b] kept rows before it, the last with SA^R value before[b] and
+        // the next one with at[b]. the kept rows starting with c before it
+        // are those followed by a kept row before the suffix at b+1, and the
+        // row of (T[0..K])^R if that at 0 is before the suffix at b+1
+        std::vector<ulint> rank(nb), at(nb), before(nb);
+        rank[nb-1] = 0;
+        at[nb-1] = first_sa[next_kept_char[TERMINATOR]];
+
+        for (ulint b = nb - 1; b-- > 0;)
+        {
+            uchar c = B[b];
+            uchar co = old_code[c];
+            ulint t = rank[b+1];
+            ulint s = kept_row(t);
+            ulint k = co ? idx.bwtR.rank(s,co) : 0;
+            bool tail_K = c == c_K;
+
+            rank[b] = C[c] - removed_below[c] + k - (co ? removed_before(co,k) : 0) + (tail_K && smaller[b+1]);
+
+            // first kept row starting with c after the suffix, else the
+            // first of the next character
+            ulint row = N1;
+            if (co)
+            {
+                ulint kk = next_kept(co,k);
+                if (kk < count[c])
+                {
+                    ulint y = idx.bwtR.select(kk,co);
+                    row = C[c] + kk;
+                    at[b] = sa_lf(y == s ? at[b+1] : sa_kept_first(co,kk,y));
+                }
+            }
+            if (tail_K && !smaller[b+1] && row_K < row)
+            {
+                row = row_K;
+                at[b] = sa_K;
+            }
+            if (row == N1)
+            {
+                row = first_row[next_kept_char[c]];
+                at[b] = first_sa[next_kept_char[c]];
+            }
+            assert(row == kept_row(rank[b]));
+
+            // last kept row starting with c before the suffix, else the
+            // last of the previous character
+            row = N1;
+            if (co)
+            {
+                ulint kk = prev_kept(co,k);
+                if (kk > 0)
+                {
+                    ulint y = idx.bwtR.select(kk-1,co);
+                    row = C[c] + kk - 1;
+                    before[b] = sa_lf(t > 0 && y == kept_row(t-1) ? before[b+1] : sa_kept_last(co,kk-1,y));
+                }
+            }
+            if (tail_K && smaller[b+1] && (row == N1 || row_K > row))
+            {
+                row = row_K;
+                before[b] = sa_K;
+            }
+            if (row == N1)
+            {
+                row = last_row[prev_kept_char[c]];
+                before[b] = last_sa[prev_kept_char[c]];
+            }
+            assert(rank[b] == 0 ? row == N1 : row == kept_row(rank[b] - 1));
+        }
+
+        // suffixes of B in lexicographic order, as in merge
+        std::vector<ulint> order;
+        {
+            std::vector<ulint> z(nb);
+            for (ulint b = 0; b < nb; ++b) z[b] = b;
+            auto key = [&](ulint b) { return range_t(rank[b], B[b]); };
+            order = sorted_suffixes(z, key, threads);
+        }
+
+        // merged BWT^R, emitted in row order
+        rle_string_builder bwt_b;
+        std::vector<range_t> samples_first;
+        std::vector<range_t> samples_last;
+
+        uchar cur_c = 0;
+        ulint rows = 0;
+        ulint prev_sa = 0;
+
+        auto sample = [&](ulint sa) { return sa > 0 ? sa - 1 : N - 1; };
+        auto emit = [&](uchar c, ulint len, ulint sa_a, ulint sa_b)
+        {
+            if (rows == 0 || c != cur_c)
+            {
+                if (rows > 0) samples_last.push_back({sample(prev_sa), samples_last.size()});
+                samples_first.push_back({sample(sa_a), samples_first.size()});
+            }
+            bwt_b.push(c,len);
+            cur_c = c;
+            rows += len;
+            prev_sa = sa_b;
+        };
+
+        // kept rows in [a,b), with SA^R values sa_a at a and sa_b at b-1.
+        // the removed rows from removed[e] on are not emitted yet
+        ulint e = 0;
+        ulint run = 0;
+        ulint run_s = 0;
+        ulint run_len = idx.bwtR.run_at(0);
+        auto emit_old = [&](ulint a, ulint b, ulint sa_a, ulint sa_b)
+        {
+            while (a < b)
+            {
+                while (e < removed.size() && removed[e].first < a) ++e;
+                if (e < removed.size() && removed[e].first == a)
+                {
+                    ++a;
+                    ++e;
+                    continue;
+                }
+                while (run_s + run_len <= a)
+                {
+                    run_s += run_len;
+                    run_len = idx.bwtR.run_at(++run);
+                }
+                ulint end = std::min(b, run_s + run_len);
+                if (e < removed.size()) end = std::min(end, removed[e].first);
+
+                ulint first = a == run_s ? sa_firstR(run) :
+                              e > 0 && removed[e-1].first + 1 == a ? phi_inv(n - removed[e-1].second) : sa_a;
+                ulint last = end == run_s + run_len ? sa_lastR(run) :
+                             e < removed.size() && removed[e].first == end ? phi(n - removed[e].second) : sa_b;
+
+                emit(recode[idx.bwtR.run_head(run)], end - a, first, last);
+                a = end;
+            }
+        };
+
+        ulint x = 0;       // next old row
+        ulint sa_x = 0;    // its SA^R value, if not at a run head
+        for (auto b: order)
+        {
+            ulint y = kept_row(rank[b]);
+            if (x < y) emit_old(x, y, sa_x, before[b]);
+            x = y;
+            sa_x = at[b];
+
+            uchar c = b > 0 ? B[b-1] : (c_K ? c_K : TERMINATOR);
+            emit(c, 1, n - K + b, n - K + b);
+        }
+        if (x < N1) emit_old(x, N1, sa_x, sa_lastR(rR - 1));
+        samples_last.push_back({sample(prev_sa), samples_last.size()});
+
+        assert(rows == N);
+
+        return bwt_construction::bwt_and_samples_t(std::move(bwt_b), std::move(samples_first), std::move(samples_last));
+    }
+
+    /*
+     * suffixes of a string of n keys in lexicographic order, z being the
+     * positions 0...n-1 and the last key the only one of its value: the
+     * keys are ranked, then the string of ranks is suffix sorted
+     */
+    template<class F>
+    static std::vector<ulint> sorted_suffixes(std::vector<ulint>& z, F key, ulint threads)
+    {
+        ulint n = z.size();
+        std::vector<ulint> idx_z(z);
+        std::sort(idx_z.begin(), idx_z.end(), [&](ulint a, ulint b) { return key(a) < key(b); });
+
+        ulint rank = 0;
+        for (ulint k = 0; k < n; ++k)
+        {
+            if (k > 0 && key(idx_z[k]) != key(idx_z[k-1])) rank++;
+            z[idx_z[k]] = rank;
+        }
+
+        ulint bits = 1;
+        while (bits < 64 && (ulint(1) << bits) <= rank) ++bits;
+
+        return parallel_suffix_sorter::sort(z,threads,bits);
+    }
+
+    static const uchar TERMINATOR = 1;
+
+};
+
+};
+
+#endif /* INCLUDED_BWT_MERGE_HPP */
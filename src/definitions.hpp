@@ -5,11 +5,13 @@
 #include <cmath>
 #include <deque>
 #include <fstream>
+#include <future>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <tuple>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 #include <sdsl/construct.hpp>
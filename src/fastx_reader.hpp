@@ -0,0 +1,341 @@
+/*
+ * fastx_reader: chunked FASTA/FASTQ parser with bounded memory
+ *
+ *  fastx_reader parses the read file sequentially into caller-owned chunks,
+ *  reusing the strings of the chunk (and their capacity) from one chunk to
+ *  the next. fastx_stream runs a fastx_reader in a background thread and
+ *  double-buffers two chunks against the consumer, so that parsing overlaps
+ *  the search. Memory is bounded by two chunks regardless of the input size.
+ *  Input may be gzip or BGZF compressed (see gz_input).
+ */
+
+#ifndef INCLUDED_FASTX_READER_HPP
+#define INCLUDED_FASTX_READER_HPP
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include "definitions.hpp"
+#include "gz_input.hpp"
+
+namespace bri {
+
+struct read_record {
+    std::string id;
+    std::string read;
+    std::string qual;
+};
+
+class fastx_reader {
+
+public:
+
+    /*
+     * constructor.
+     * \param file: FASTA (.fa, .fasta, .FASTA) or FASTQ (.fq, .fastq) file,
+     *              optionally compressed (.gz, .bgz)
+     * \param threads: number of threads decompressing BGZF input
+     * \param buffer_size: size of the input buffer in bytes
+     */
+    fastx_reader(std::string const& file, ulint threads = 1, ulint buffer_size = 1<<20)
+        : in(file, threads)
+    {
+        this->file = file;
+
+        std::string extension = get_file_ext(gz_input::strip_ext(file));
+
+        fasta = (extension == "FASTA") || (extension == "fasta") || (extension == "fa");
+        bool fastq = (extension == "fq") || (extension == "fastq");
+
+        if (!fasta && !fastq)
+        {
+            throw std::runtime_error("extension " + extension +
+                                     " is not a valid extension for the readsfile");
+        }
+
+        buf = std::vector<char>(buffer_size);
+    }
+
+    /*
+     * parse the next records into chunk[0...k-1], reusing their strings
+     * returns: k (at most chunk.size()), 0 at the end of the input
+     */
+    ulint read_chunk(std::vector<read_record>& chunk)
+    {
+        ulint k = 0;
+        if (fasta)
+        {
+            while (k < chunk.size() && next_fasta(chunk[k])) ++k;
+        }
+        else
+        {
+            while (k < chunk.size() && next_fastq(chunk[k])) ++k;
+        }
+        return k;
+    }
+
+    /*
+     * number of bytes of the (compressed) file consumed so far
+     */
+    ulint bytes_read() { return in.is_compressed() ? in.compressed_offset() : consumed; }
+
+    ulint file_size() { return in.file_size(); }
+
+private:
+
+    static std::string get_file_ext(std::string const& s)
+    {
+        size_t i = s.rfind('.', s.length());
+        if (i != std::string::npos)
+            return s.substr(i + 1, s.length() - i);
+
+        return "";
+    }
+
+    bool refill()
+    {
+        buf_len = in.read(buf.data(), buf.size());
+        buf_pos = 0;
+        return buf_len > 0;
+    }
+
+    /*
+     * read the next line (without '\n' and '\r') into line
+     * returns: false if the input is exhausted
+     */
+    bool next_line(std::string& line)
+    {
+        line.clear();
+        bool found = false;
+
+        while (true)
+        {
+            if (buf_pos == buf_len && !refill()) break;
+            found = true;
+
+            char* begin = buf.data() + buf_pos;
+            char* end = buf.data() + buf_len;
+            char* nl = std::find(begin, end, '\n');
+
+            line.append(begin, nl);
+            consumed += nl - begin;
+            buf_pos += nl - begin;
+
+            if (nl != end)
+            {
+                // skip '\n'
+                buf_pos++;
+                consumed++;
+                break;
+            }
+        }
+
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+
+        return found;
+    }
+
+    bool next_fasta(read_record& rec)
+    {
+        // id of the record is the header line read ahead by the previous call
+        if (!has_pending)
+        {
+            while (next_line(line))
+            {
+                if (!line.empty() && (line[0] == '>' || line[0] == '@'))
+                {
+                    has_pending = true;
+                    break;
+                }
+            }
+            if (!has_pending) return false;
+        }
+
+        rec.id.assign(line, 1, std::string::npos);
+        rec.read.clear();
+        rec.qual.clear(); // empty quality string for fasta
+        has_pending = false;
+
+        while (next_line(line))
+        {
+            if (line.empty()) continue; // Skip empty lines
+
+            if (line[0] == '>' || line[0] == '@')
+            {
+                has_pending = true;
+                break;
+            }
+            rec.read += line;
+        }
+
+        return true;
+    }
+
+    bool next_fastq(read_record& rec)
+    {
+        if (!(next_line(rec.id) && next_line(rec.read) &&
+              next_line(line) && // Skip the '+' line
+              next_line(rec.qual)))
+            return false;
+
+        if (rec.id.empty() || rec.id[0] != '@')
+        {
+            throw std::runtime_error("File " + file +
+                                     " doesn't appear to be in FastQ format");
+        }
+        rec.id.erase(0, 1);
+
+        return true;
+    }
+
+    std::string file;
+    gz_input in;
+    bool fasta = false;
+
+    std::vector<char> buf;
+    ulint buf_len = 0;
+    ulint buf_pos = 0;
+
+    ulint consumed = 0;
+
+    // FASTA header of the next record, if already read
+    std::string line;
+    bool has_pending = false;
+
+};
+
+class fastx_stream {
+
+public:
+
+    /*
+     * constructor. opens the file and starts parsing in the background.
+     * \param chunk_size: number of reads in each of the two buffers
+     * \param threads: number of threads decompressing BGZF input
+     */
+    fastx_stream(std::string const& file, ulint chunk_size = 1<<14, ulint threads = 1)
+        : reader(file, threads)
+    {
+        for (int k = 0; k < 2; ++k)
+        {
+            chunks[k] = std::vector<read_record>(chunk_size);
+            counts[k] = 0;
+            offsets[k] = 0;
+            filled[k] = false;
+        }
+
+        worker = std::thread(&fastx_stream::produce, this);
+    }
+
+    ~fastx_stream()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stop = true;
+        }
+        cv.notify_all();
+        worker.join();
+    }
+
+    /*
+     * hand the current chunk back to the reader and wait for the next one
+     * returns: number of reads in chunk, 0 at the end of the input
+     */
+    ulint next(std::vector<read_record> const*& chunk)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+
+        if (done) return 0;
+
+        if (current >= 0)
+        {
+            filled[current] = false;
+            cv.notify_all();
+            current = 1 - current;
+        }
+        else current = 0;
+
+        cv.wait(lock, [this]{ return filled[current] || error; });
+
+        if (error) std::rethrow_exception(error);
+
+        chunk = &chunks[current];
+        consumed = offsets[current];
+        done = counts[current] == 0;
+        return counts[current];
+    }
+
+    /*
+     * percentage of the file consumed up to the current chunk
+     */
+    ulint progress()
+    {
+        if (reader.file_size() == 0) return 100;
+        return 100 * consumed / reader.file_size();
+    }
+
+private:
+
+    void produce()
+    {
+        try
+        {
+            for (int k = 0; ; k = 1 - k)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    cv.wait(lock, [this,k]{ return !filled[k] || stop; });
+                    if (stop) return;
+                }
+
+                // the consumer does not touch chunks[k] until it is filled
+                ulint cnt = reader.read_chunk(chunks[k]);
+
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    counts[k] = cnt;
+                    offsets[k] = reader.bytes_read();
+                    filled[k] = true;
+                }
+                cv.notify_all();
+
+                if (cnt == 0) return;
+            }
+        }
+        catch (...)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                error = std::current_exception();
+            }
+            cv.notify_all();
+        }
+    }
+
+    fastx_reader reader;
+
+    std::vector<read_record> chunks[2];
+    ulint counts[2];
+    ulint offsets[2];
+    bool filled[2];
+
+    // chunk held by the consumer, -1 before the first call to next()
+    int current = -1;
+    ulint consumed = 0;
+    bool done = false;
+
+    bool stop = false;
+    std::exception_ptr error;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::thread worker;
+
+};
+
+};
+
+#endif /* INCLUDED_FASTX_READER_HPP */
@@ -0,0 +1,328 @@
+/*
+ * gz_input: buffered byte input from plain, gzip or BGZF compressed files
+ *
+ *  BGZF files (written by bgzip) are a series of independent deflate blocks
+ *  of at most 64KB each. They are decompressed in batches by several threads,
+ *  and the next batch is prefetched while the current one is consumed.
+ *  Other gzip files are decompressed sequentially by zlib. Files without the
+ *  gzip magic number are read as they are.
+ */
+
+#ifndef INCLUDED_GZ_INPUT_HPP
+#define INCLUDED_GZ_INPUT_HPP
+
+#include <cstring>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <zlib.h>
+
+#include "definitions.hpp"
+
+namespace bri {
+
+class gz_input {
+
+public:
+
+    /*
+     * constructor. detects the compression format from the magic number.
+     * \param threads: number of threads decompressing BGZF blocks
+     */
+    gz_input(std::string const& file, ulint threads = 1)
+    {
+        this->file = file;
+        this->threads = threads < 1 ? 1 : threads;
+
+        raw.open(file.c_str(), std::ios::binary);
+        if (!raw)
+            throw std::runtime_error("Cannot open file " + file);
+
+        raw.seekg(0, std::ios::end);
+        f_size = raw.tellg();
+        raw.seekg(0, std::ios::beg);
+
+        uchar header[18];
+        raw.read((char*)header, 18);
+        ulint header_len = raw.gcount();
+        raw.clear();
+        raw.seekg(0, std::ios::beg);
+
+        compressed = header_len >= 2 && header[0] == 0x1f && header[1] == 0x8b;
+
+        // BGZF: FEXTRA flag set and a 'BC' extra subfield first
+        bgzf = compressed && header_len >= 18 && (header[3] & 4) &&
+               header[12] == 'B' && header[13] == 'C';
+
+        if (compressed && !bgzf)
+        {
+            raw.close();
+            gz = gzopen(file.c_str(), "rb");
+            if (gz == NULL)
+                throw std::runtime_error("Cannot open file " + file);
+            gzbuffer(gz, 1<<17);
+        }
+        else if (bgzf && this->threads > 1)
+        {
+            next = std::async(std::launch::async, &gz_input::load_batch, this);
+        }
+    }
+
+    ~gz_input()
+    {
+        // wait for the prefetching batch before closing the file
+        if (next.valid()) next.wait();
+        if (gz != NULL) gzclose(gz);
+    }
+
+    /*
+     * read at most n decompressed bytes into buf
+     * returns: number of bytes read, 0 at the end of the file
+     */
+    ulint read(char* buf, ulint n)
+    {
+        if (bgzf)
+        {
+            ulint res = 0;
+            while (res < n)
+            {
+                if (batch_pos == batch.data.size())
+                {
+                    if (eof) break;
+                    next_batch();
+                    continue;
+                }
+                ulint len = std::min(n - res, (ulint)batch.data.size() - batch_pos);
+                std::memcpy(buf + res, batch.data.data() + batch_pos, len);
+                batch_pos += len;
+                res += len;
+            }
+            return res;
+        }
+        if (gz != NULL)
+        {
+            int len = gzread(gz, buf, (unsigned)std::min(n, (ulint)1<<30));
+            if (len < 0)
+            {
+                int errnum;
+                throw std::runtime_error("Error while decompressing " + file + ": " + gzerror(gz, &errnum));
+            }
+            return len;
+        }
+        raw.read(buf, n);
+        consumed += raw.gcount();
+        return raw.gcount();
+    }
+
+    /*
+     * number of bytes of the (compressed) file consumed so far
+     */
+    ulint compressed_offset()
+    {
+        if (bgzf) return batch.end_offset;
+        if (gz != NULL) return gzoffset(gz);
+        return consumed;
+    }
+
+    /*
+     * size of the (compressed) file
+     */
+    ulint file_size() { return f_size; }
+
+    bool is_compressed() { return compressed; }
+
+    bool is_bgzf() { return bgzf; }
+
+    /*
+     * read the whole decompressed file into a string
+     */
+    static std::string read_all(std::string const& file, ulint threads = 1)
+    {
+        gz_input in(file, threads);
+
+        std::string res;
+        if (!in.is_compressed()) res.reserve(in.file_size());
+
+        std::vector<char> buf(1<<20);
+        while (ulint len = in.read(buf.data(), buf.size()))
+            res.append(buf.data(), len);
+
+        return res;
+    }
+
+    /*
+     * file name without the compression extension (.gz, .bgz)
+     */
+    static std::string strip_ext(std::string const& file)
+    {
+        size_t i = file.rfind('.');
+        if (i != std::string::npos)
+        {
+            std::string ext = file.substr(i + 1);
+            if (ext == "gz" || ext == "bgz" || ext == "GZ") return file.substr(0, i);
+        }
+        return file;
+    }
+
+private:
+
+    struct bgzf_batch {
+        std::vector<char> data;
+        // file offset after the last block of the batch
+        ulint end_offset = 0;
+        // the batch reaches the end of the file
+        bool last = false;
+    };
+
+    void next_batch()
+    {
+        if (next.valid())
+        {
+            batch = next.get();
+            if (!batch.last)
+                next = std::async(std::launch::async, &gz_input::load_batch, this);
+        }
+        else
+        {
+            batch = load_batch();
+        }
+        batch_pos = 0;
+        eof = batch.last;
+    }
+
+    /*
+     * read the next blocks_per_thread*threads BGZF blocks and decompress
+     * them in parallel, each thread taking every threads-th block
+     */
+    bgzf_batch load_batch()
+    {
+        bgzf_batch res;
+
+        std::vector<std::vector<char> > blocks;
+        std::vector<ulint> offsets(1,0);
+
+        ulint max_blocks = blocks_per_thread * threads;
+        while (blocks.size() < max_blocks)
+        {
+            uchar header[12];
+            raw.read((char*)header, 12);
+            if (raw.gcount() == 0)
+            {
+                res.last = true;
+                break;
+            }
+            if (raw.gcount() < 12 || header[0] != 0x1f || header[1] != 0x8b || !(header[3] & 4))
+                throw std::runtime_error("File " + file + " is not a valid BGZF file");
+
+            ulint xlen = header[10] | (header[11] << 8);
+            std::vector<char> extra(xlen);
+            raw.read(extra.data(), xlen);
+
+            // find the BC subfield holding the total block size - 1
+            ulint bsize = 0;
+            for (ulint i = 0; i + 4 <= xlen; )
+            {
+                ulint slen = (uchar)extra[i+2] | ((uchar)extra[i+3] << 8);
+                if (extra[i] == 'B' && extra[i+1] == 'C' && slen == 2 && i + 6 <= xlen)
+                    bsize = ((uchar)extra[i+4] | ((uchar)extra[i+5] << 8)) + 1;
+                i += 4 + slen;
+            }
+            if (bsize < 12 + xlen + 8)
+                throw std::runtime_error("File " + file + " is not a valid BGZF file");
+
+            // compressed data followed by CRC32 and ISIZE
+            std::vector<char> block(bsize - 12 - xlen);
+            raw.read(block.data(), block.size());
+            if ((ulint)raw.gcount() != block.size())
+                throw std::runtime_error("File " + file + " is truncated");
+
+            const uchar* tail = (const uchar*)block.data() + block.size() - 4;
+            ulint isize = tail[0] | (tail[1] << 8) | (tail[2] << 16) | ((ulint)tail[3] << 24);
+
+            offsets.push_back(offsets.back() + isize);
+            blocks.push_back(std::move(block));
+            raw_offset += bsize;
+        }
+
+        res.end_offset = raw_offset;
+        res.data.resize(offsets.back());
+
+        std::vector<std::string> errors(threads);
+        auto inflate_blocks = [&](ulint t)
+        {
+            for (ulint b = t; b < blocks.size(); b += threads)
+            {
+                if (!inflate_block(blocks[b], res.data.data() + offsets[b], offsets[b+1] - offsets[b]))
+                {
+                    errors[t] = "Error while decompressing " + file;
+                    return;
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (ulint t = 1; t < threads && t < blocks.size(); ++t)
+            workers.push_back(std::thread(inflate_blocks, t));
+        inflate_blocks(0);
+        for (auto& w: workers) w.join();
+
+        for (auto& e: errors)
+            if (!e.empty()) throw std::runtime_error(e);
+
+        return res;
+    }
+
+    /*
+     * inflate one raw deflate block and check its CRC32
+     */
+    static bool inflate_block(std::vector<char>& block, char* out, ulint out_len)
+    {
+        z_stream zs;
+        std::memset(&zs, 0, sizeof(zs));
+        if (inflateInit2(&zs, -15) != Z_OK) return false;
+
+        zs.next_in = (Bytef*)block.data();
+        zs.avail_in = block.size() - 8;
+        zs.next_out = (Bytef*)out;
+        zs.avail_out = out_len;
+
+        int ret = inflate(&zs, Z_FINISH);
+        inflateEnd(&zs);
+
+        if (ret != Z_STREAM_END || zs.total_out != out_len) return false;
+
+        const uchar* tail = (const uchar*)block.data() + block.size() - 8;
+        ulint crc = tail[0] | (tail[1] << 8) | (tail[2] << 16) | ((ulint)tail[3] << 24);
+
+        return crc == crc32(crc32(0L, Z_NULL, 0), (const Bytef*)out, out_len);
+    }
+
+    static const ulint blocks_per_thread = 64;
+
+    std::string file;
+    ulint threads = 1;
+
+    bool compressed = false;
+    bool bgzf = false;
+
+    // plain and BGZF input
+    std::ifstream raw;
+    ulint f_size = 0;
+    ulint consumed = 0;
+
+    // gzip input
+    gzFile gz = NULL;
+
+    // BGZF input
+    bgzf_batch batch;
+    ulint batch_pos = 0;
+    bool eof = false;
+    // only touched by load_batch, which never runs concurrently with itself
+    ulint raw_offset = 0;
+    std::future<bgzf_batch> next;
+
+};
+
+};
+
+#endif /* INCLUDED_GZ_INPUT_HPP */
@@ -6,6 +6,7 @@
 #define INCLUDED_HUFFMAN_STRING_HPP
 
 #include "definitions.hpp"
+#include "space_tree.hpp"
 
 namespace bri {
 
@@ -60,6 +61,47 @@ public:
         return wt.select(i+1,c);
     }
 
+    /*
+     * the distinct characters of S[i...j-1] with their ranks at i and at j,
+     * by a single traversal of the wavelet tree (in no particular order).
+     * returns their number
+     */
+    ulint interval_symbols(ulint i, ulint j, std::vector<uchar>& cs, std::vector<ulint>& rank_i, std::vector<ulint>& rank_j)
+    {
+        assert(i <= j && j <= wt.size());
+
+        // sdsl writes up to sigma entries
+        cs.resize(256);
+        rank_i.resize(256);
+        rank_j.resize(256);
+
+        ulint k = 0;
+        if (i < j) wt.interval_symbols(i, j, k, cs, rank_i, rank_j);
+        return k;
+    }
+
+    /*
+     * the bitvector of the wavelet tree, then its rank/select supports and
+     * its shape, which sdsl does not expose
+     */
+    space_node space_tree(std::string const& name = "huffman_string") const
+    {
+        space_node res(name);
+
+        space_node bv = space_node::of("bitvector", wt.bv);
+        ulint rest = sdsl::size_in_bytes(wt) - bv.bytes;
+
+        res.add(bv);
+        res.add(space_node("supports", rest, rest));
+
+        return res;
+    }
+
+    ulint size_in_bytes() const
+    {
+        return space_tree().bytes;
+    }
+
     /*
      * serialize the index to the ostream
      */
@@ -0,0 +1,318 @@
+/*
+ * index_bench: time per operation of the primitives of br_index (bri-bench)
+ *
+ *  each primitive is timed on the same number of queries, drawn uniformly
+ *  at random or at consecutive positions, with warm caches (the queries
+ *  are run once untimed before the timed pass) and with cold caches. a
+ *  cold query is timed on its own, after a buffer larger than the last
+ *  level cache is written, so that it cannot find the lines of the queries
+ *  before it (consecutive ones in particular) in the caches; the overhead
+ *  of reading the clock is subtracted. since a flush costs far more than a
+ *  query, a cold pass only runs the first cold_ops queries. queries are
+ *  generated before timing, and the results of the operations are
+ *  accumulated so that they are not optimized away. with perf_counters,
+ *  the hardware events of each timed pass are reported per operation as
+ *  well.
+ */
+
+#ifndef INCLUDED_INDEX_BENCH_HPP
+#define INCLUDED_INDEX_BENCH_HPP
+
+#include <chrono>
+#include <random>
+
+#include "definitions.hpp"
+#include "perf_counters.hpp"
+
+namespace bri {
+
+class index_bench {
+
+public:
+
+    struct result {
+        std::string structure;
+        std::string op;
+        std::string access; // random or sequential
+        std::string cache;  // warm or cold
+        double ns_per_op;
+
+        // hardware events per operation (name, value), if counted
+        std::vector<std::pair<std::string, double> > perf;
+    };
+
+    /*
+     * \param ops: queries per primitive, access pattern and warm pass
+     * \param flush_bytes: size of the buffer evicting the caches
+     * \param perf: hardware counters read around each timed query or pass,
+     *              or null
+     * \param cold_ops: queries per cold pass (at most ops), each after a
+     *                  flush
+     */
+    index_bench(ulint ops, ulint seed = 1, ulint flush_bytes = 64 << 20, perf_counters* perf = nullptr,
+                ulint cold_ops = 1000)
+        : ops(std::max<ulint>(ops,1)), cold_ops(std::max<ulint>(std::min(cold_ops,ops),1)), seed(seed),
+          flush_buffer(flush_bytes,0), perf(perf) {}
+
+    /*
+     * times the primitives of idx (a br_index)
+     */
+    template<class index_t>
+    std::vector<result> run(index_t& idx)
+    {
+        results.clear();
+
+        ulint N = idx.bwt.size();
+        ulint r = idx.bwt.number_of_runs();
+
+        // characters of the BWT, with their number of occurrences
+        std::vector<uchar> chars;
+        for (ulint c = 1; c < 256; ++c)
+            if ((c < 255 ? idx.F[c+1] : N) > idx.F[c]) chars.push_back((uchar)c);
+
+        auto no_query = [](ulint q) { return q; };
+
+        measure("rle_string", "rank", N * chars.size(),
+                [&](ulint q) { return range_t(q / chars.size(), chars[q % chars.size()]); },
+                [&](range_t const& q) { return idx.bwt.rank(q.first,(uchar)q.second); });
+
+        // the q-th character of column F, as an occurrence in BWT
+        measure("rle_string", "select", N,
+                [&](ulint q) { uchar c = idx.F_at(q); return range_t(q - idx.F[c], c); },
+                [&](range_t const& q) { return idx.bwt.select(q.first,(uchar)q.second); });
+
+        measure("rle_string", "run_of_position", N, no_query,
+                [&](ulint i) { return idx.bwt.run_of_position(i); });
+
+        measure("sparse_sd_vector", "rank", N + 1, no_query,
+                [&](ulint i) { return idx.first.rank(i); });
+
+        measure("sparse_sd_vector", "select", r, no_query,
+                [&](ulint i) { return idx.first.select(i); });
+
+        measure("sparse_sd_vector", "predecessor_rank_circular", N, no_query,
+                [&](ulint i) { return idx.first.predecessor_rank_circular(i); });
+
+        measure("br_index", "LF", N, no_query,
+                [&](ulint i) { return idx.LF(i); });
+
+        measure("br_index", "LFR", N, no_query,
+                [&](ulint i) { return idx.LFR(i); });
+
+        // Phi is undefined at SA[0] = N-1, PhiI at SA[N-1]
+        measure("br_index", "Phi", N - 1, no_query,
+                [&](ulint i) { return idx.Phi(i); });
+
+        measure("br_index", "PhiI", N - 1,
+                [&](ulint q) { return q < idx.last_SA_val ? q : q + 1; },
+                [&](ulint i) { return idx.PhiI(i); });
+
+        measure("permuted_lcp", "operator[]", N, no_query,
+                [&](ulint i) { return idx.plcp[i]; });
+
+        // extension of the samples of the substrings of length len of the
+        // text by the character before (left) or after (right) them. the
+        // len+1 characters of a query are those before the suffix of a row
+        // (a uniform row is a uniform text position), extracted by LF
+        // without decoding the text; rows of the first positions of the
+        // text take the last ones instead
+        ulint len = std::min<ulint>(8, idx.text_size() > 2 ? idx.text_size() - 2 : 0);
+        if (len > 0)
+        {
+            typedef std::pair<uchar, decltype(idx.get_initial_sample())> extension_t;
+
+            auto substring = [&](ulint row)
+            {
+                std::string w = idx.extract(row, len + 1);
+                return w.size() == len + 1 ? w : idx.extract(0, len + 1);
+            };
+
+            measure("br_index", "left_extension", N,
+                    [&](ulint q) {
+                        std::string w = substring(q);
+                        auto s = idx.backward_search(w, 1, len, idx.get_initial_sample());
+                        return extension_t(w[0], s);
+                    },
+                    [&](extension_t const& q) { return idx.left_extension(q.first,q.second).range.first; });
+
+            measure("br_index", "right_extension", N,
+                    [&](ulint q) {
+                        std::string w = substring(q);
+                        auto s = idx.forward_search(w, 0, len - 1, idx.get_initial_sample(true));
+                        return extension_t(w[len], s);
+                    },
+                    [&](extension_t const& q) { return idx.right_extension(q.first,q.second).rangeR.first; });
+        }
+
+        return results;
+    }
+
+    /*
+     * results as a JSON object, with the description of the index.
+     * if perf was requested: the hardware events of its "load" phase, or
+     * why they could not be counted
+     */
+    template<class index_t>
+    static void write_json(std::ostream& out, std::string const& index_file, index_t& idx,
+                           ulint ops, std::vector<result> const& results, perf_counters const* perf = nullptr,
+                           ulint cold_ops = 1000)
+    {
+        out << "{" << std::endl;
+        out << "  \"index\": \"" << json_escape(index_file) << "\"," << std::endl;
+        out << "  \"n\": " << idx.bwt.size() << "," << std::endl;
+        out << "  \"r\": " << idx.bwt.number_of_runs() << "," << std::endl;
+        out << "  \"rR\": " << idx.bwtR.number_of_runs() << "," << std::endl;
+        out << "  \"ops\": " << ops << "," << std::endl;
+        out << "  \"cold_ops\": " << std::min(cold_ops, ops) << "," << std::endl;
+        if (perf != nullptr && perf->available())
+        {
+            std::vector<std::pair<std::string, double> > load;
+            for (ulint e = 0; e < perf_counters::EVENTS; ++e)
+                if (perf->available(e)) load.push_back({perf_counters::name(e), perf->total("load",e)});
+            out << "  \"load_perf\": " << json_object(load) << "," << std::endl;
+        }
+        else if (perf != nullptr)
+        {
+            out << "  \"perf_error\": \"" << json_escape(perf->error()) << "\"," << std::endl;
+        }
+        out << "  \"results\": [" << std::endl;
+        for (ulint i = 0; i < results.size(); ++i)
+        {
+            auto& res = results[i];
+            out << "    {\"structure\": \"" << res.structure << "\", \"op\": \"" << res.op
+                << "\", \"access\": \"" << res.access << "\", \"cache\": \"" << res.cache
+                << "\", \"ns_per_op\": " << res.ns_per_op;
+            if (!res.perf.empty()) out << ", \"perf_per_op\": " << json_object(res.perf);
+            out << "}" << (i + 1 < results.size() ? "," : "") << std::endl;
+        }
+        out << "  ]" << std::endl;
+        out << "}" << std::endl;
+    }
+
+    // accumulated results of the operations
+    ulint sink = 0;
+
+private:
+
+    /*
+     * times f on the queries decode(q), q in [0, universe), for each access
+     * pattern and cache state
+     */
+    template<class D, class F>
+    void measure(std::string const& structure, std::string const& op, ulint universe, D decode, F f)
+    {
+        if (universe == 0) return;
+
+        std::mt19937_64 gen(seed);
+        std::uniform_int_distribution<ulint> dist(0, universe - 1);
+
+        for (bool random: {true, false})
+        {
+            ulint start = dist(gen);
+
+            std::vector<decltype(decode(0))> queries;
+            queries.reserve(ops);
+            for (ulint k = 0; k < ops; ++k)
+                queries.push_back(decode(random ? dist(gen) : (start + k) % universe));
+
+            for (bool warm: {true, false})
+            {
+                result res = {structure, op, random ? "random" : "sequential", warm ? "warm" : "cold", 0, {}};
+                std::string phase = structure + "::" + op + " (" + res.access + ", " + res.cache + ")";
+                ulint n_ops = warm ? ops : cold_ops;
+
+                // the warm pass is timed as a whole, a cold one query by query
+                ulint group = warm ? ops : 1;
+                if (warm) for (auto& q: queries) sink += f(q);
+
+                double ns = 0;
+                for (ulint k = 0; k < n_ops; k += group)
+                {
+                    if (!warm) flush();
+
+                    auto p1 = perf != nullptr ? perf->now() : perf_counters::snapshot();
+                    auto t1 = std::chrono::steady_clock::now();
+                    for (ulint j = k; j < k + group; ++j) sink += f(queries[j]);
+                    auto t2 = std::chrono::steady_clock::now();
+                    auto p2 = perf != nullptr ? perf->now() : perf_counters::snapshot();
+
+                    ns += std::chrono::duration_cast<std::chrono::duration<double, std::nano> >(t2 - t1).count();
+                    if (perf != nullptr) perf->add(phase, p1, p2);
+                }
+                res.ns_per_op = std::max(0.0, ns / n_ops - (warm ? 0 : clock_overhead()));
+
+                if (perf != nullptr && perf->available())
+                {
+                    for (ulint e = 0; e < perf_counters::EVENTS; ++e)
+                        if (perf->available(e)) res.perf.push_back({perf_counters::name(e), perf->total(phase,e) / n_ops});
+                }
+                results.push_back(res);
+            }
+        }
+    }
+
+    // ns added to a timed query by reading the clock around it, measured
+    // once
+    double clock_overhead()
+    {
+        if (overhead >= 0) return overhead;
+
+        const ulint reads = 1000;
+        auto t1 = std::chrono::steady_clock::now();
+        for (ulint k = 0; k < reads; ++k)
+        {
+            auto a = std::chrono::steady_clock::now();
+            auto b = std::chrono::steady_clock::now();
+            sink += (b - a).count() == 0;
+        }
+        auto t2 = std::chrono::steady_clock::now();
+
+        overhead = std::chrono::duration_cast<std::chrono::duration<double, std::nano> >(t2 - t1).count() / reads / 2;
+        return overhead;
+    }
+
+    // evicts the index from the caches
+    void flush()
+    {
+        if (flush_buffer.empty()) return;
+        for (ulint i = 0; i < flush_buffer.size(); i += 64) flush_buffer[i]++;
+        sink += flush_buffer[seed % flush_buffer.size()];
+    }
+
+    static std::string json_object(std::vector<std::pair<std::string, double> > const& values)
+    {
+        std::stringstream ss;
+        ss << "{";
+        for (ulint i = 0; i < values.size(); ++i)
+            ss << (i > 0 ? ", " : "") << "\"" << values[i].first << "\": " << values[i].second;
+        ss << "}";
+        return ss.str();
+    }
+
+    static std::string json_escape(std::string const& s)
+    {
+        std::string res;
+        for (char c: s)
+        {
+            if (c == '"' || c == '\\') res.push_back('\\');
+            res.push_back(c);
+        }
+        return res;
+    }
+
+    ulint ops;
+    ulint cold_ops;
+    ulint seed;
+    std::vector<char> flush_buffer;
+    perf_counters* perf;
+
+    // see clock_overhead, negative until measured
+    double overhead = -1;
+
+    std::vector<result> results;
+
+};
+
+};
+
+#endif /* INCLUDED_INDEX_BENCH_HPP */
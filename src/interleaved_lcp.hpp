@@ -0,0 +1,232 @@
+/*
+ * interleaved_lcp: run-length encoded ILCP array of a document collection,
+ * to list the documents containing a pattern in time proportional to their
+ * number instead of the number of occurrences.
+ *
+ *  ILCP[i] is the LCP of the suffix of row i of the SA with the closest
+ *  one before it in SA order starting in the same document (0 if there is
+ *  none). in the SA range [sp,ep] of a pattern of length m, the rows with
+ *  ILCP < m are exactly the first occurrence in the range of each document
+ *  containing the pattern.
+ *
+ *  on a repetitive collection ILCP has few runs: only the first row of
+ *  each run is stored (sparse bitvector), with its SA value, and a tree of
+ *  the minima of the run values finds the runs below m in a range of runs.
+ */
+
+#ifndef INCLUDED_INTERLEAVED_LCP_HPP
+#define INCLUDED_INTERLEAVED_LCP_HPP
+
+#include "definitions.hpp"
+#include "sparse_sd_vector.hpp"
+
+namespace bri {
+
+template<class sparse_bitvector_t = sparse_sd_vector>
+class interleaved_lcp
+{
+public:
+    interleaved_lcp() {}
+
+    /*
+     * constructor from the n rows of the SA in order: next(sa, lcp, doc)
+     * gives the SA value of the next row, the LCP of its suffix with the
+     * one of the row before, and its document (< docs)
+     */
+    template<class F>
+    interleaved_lcp(ulint n, ulint docs, F next)
+    {
+        // last row of each document so far
+        std::vector<ulint> last(docs, n);
+
+        // (row, LCP) of increasing LCP values: the minimum of LCP[k...i]
+        // is the value of the first one at row k or after
+        std::vector<range_t> mins;
+
+        std::vector<ulint> heads;
+        std::vector<ulint> values;
+        std::vector<ulint> head_samples;
+
+        for (ulint i = 0; i < n; ++i)
+        {
+            ulint sa, lcp, doc;
+            next(sa, lcp, doc);
+            if (i == 0) lcp = 0;
+
+            while (!mins.empty() && mins.back().second >= lcp) mins.pop_back();
+            mins.push_back({i, lcp});
+
+            ulint v = 0;
+            if (last[doc] < n)
+                v = std::lower_bound(mins.begin(), mins.end(), range_t(last[doc] + 1, 0))->second;
+            last[doc] = i;
+
+            if (i == 0 || v != values.back())
+            {
+                heads.push_back(i);
+                values.push_back(v);
+                head_samples.push_back(sa);
+            }
+        }
+
+        build(n, heads, values, head_samples);
+    }
+
+    /*
+     * constructor from the runs of the n rows: their first rows, values and
+     * SA values of the first rows (see bwt_merge)
+     */
+    interleaved_lcp(ulint n, std::vector<ulint> const& heads, std::vector<ulint> const& values,
+                    std::vector<ulint> const& head_samples)
+    {
+        build(n, heads, values, head_samples);
+    }
+
+    /*
+     * number of runs
+     */
+    ulint runs() const { return samples.size(); }
+
+    /*
+     * run of row i
+     */
+    ulint run_of(ulint i) { return heads.rank(i+1) - 1; }
+
+    /*
+     * first row of run k
+     */
+    ulint head(ulint k) { return heads.select(k); }
+
+    /*
+     * SA value of the first row of run k
+     */
+    ulint sample(ulint k) const { return samples[k]; }
+
+    /*
+     * ILCP value of the rows of run k
+     */
+    ulint value(ulint k) const { return minima[leaves + k]; }
+
+    /*
+     * calls f(k) for each run k in [a,b] of value smaller than m, in
+     * increasing order
+     */
+    template<class F>
+    void runs_below(ulint a, ulint b, ulint m, F f) const
+    {
+        if (a > b || runs() == 0) return;
+        below(1, 0, leaves - 1, a, b, m, f);
+    }
+
+    /*
+     * serialize ILCP to the ostream
+     */
+    ulint serialize(std::ostream& out)
+    {
+        ulint w_bytes = 0;
+
+        out.write((char*)&leaves, sizeof(leaves));
+        w_bytes += sizeof(leaves);
+
+        w_bytes += heads.serialize(out);
+        w_bytes += samples.serialize(out);
+        w_bytes += minima.serialize(out);
+
+        return w_bytes;
+    }
+
+    /*
+     * load ILCP from the istream
+     */
+    void load(std::istream& in)
+    {
+        in.read((char*)&leaves, sizeof(leaves));
+
+        heads.load(in);
+        samples.load(in);
+        minima.load(in);
+    }
+
+    /*
+     * the number of leaves, then the run heads, their SA values and the
+     * tree of minima
+     */
+    space_node space_tree(std::string const& name = "interleaved_lcp") const
+    {
+        space_node res(name, sizeof(leaves));
+
+        res.add(heads.space_tree("heads"));
+        res.add(space_node::of("samples", samples));
+        res.add(space_node::of("minima", minima));
+
+        return res;
+    }
+
+    ulint size_in_bytes() const
+    {
+        return space_tree().bytes;
+    }
+
+private:
+
+    /*
+     * run heads, samples and the tree of minima of the run values
+     */
+    void build(ulint n, std::vector<ulint> const& heads, std::vector<ulint> const& values,
+               std::vector<ulint> const& head_samples)
+    {
+        this->heads = sparse_bitvector_t(heads, n);
+
+        samples = sdsl::int_vector<>(head_samples.size(), 0, width(n));
+        for (ulint k = 0; k < head_samples.size(); ++k) samples[k] = head_samples[k];
+
+        // the leaves are the run values, padded with the largest one
+        leaves = 1;
+        while (leaves < values.size()) leaves *= 2;
+        ulint max_value = *std::max_element(values.begin(), values.end());
+        minima = sdsl::int_vector<>(2 * leaves, max_value, width(max_value));
+        for (ulint k = 0; k < values.size(); ++k) minima[leaves + k] = values[k];
+        for (ulint k = leaves; k-- > 1; ) minima[k] = std::min<ulint>(minima[2*k], minima[2*k+1]);
+    }
+
+    static uint8_t width(ulint x)
+    {
+        uint8_t w = 1;
+        while (w < 64 && (x >> w) > 0) ++w;
+        return w;
+    }
+
+    /*
+     * runs below m in [a,b] under node, which covers the runs [lo,hi]
+     */
+    template<class F>
+    void below(ulint node, ulint lo, ulint hi, ulint a, ulint b, ulint m, F& f) const
+    {
+        if (hi < a || lo > b || minima[node] >= m) return;
+
+        if (lo == hi)
+        {
+            f(lo);
+            return;
+        }
+
+        ulint mid = lo + (hi - lo) / 2;
+        below(2*node, lo, mid, a, b, m, f);
+        below(2*node+1, mid+1, hi, a, b, m, f);
+    }
+
+    sparse_bitvector_t heads;
+
+    // SA value of the first row of each run
+    sdsl::int_vector<> samples;
+
+    // tree of the minima of the run values, the root at 1 and the
+    // children of node k at 2k and 2k+1
+    sdsl::int_vector<> minima;
+    ulint leaves = 0;
+
+};
+
+};
+
+#endif /* INCLUDED_INTERLEAVED_LCP_HPP */
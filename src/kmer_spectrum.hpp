@@ -0,0 +1,425 @@
+/*
+ * kmer_spectrum: the distinct k-mers of an indexed text with their number
+ * of occurrences (bri-kmers), enumerated from the index without the text
+ *
+ *  the k-mers are visited by a depth-first search of right extensions over
+ *  BWT^R: the BWT^R range of P gives those of Pc for all the characters c
+ *  following P at once (right_ranges, a single interval_symbols on BWT^R),
+ *  and its size is the count of P, so that a branch is pruned as soon as
+ *  its count falls below the minimum. since the extensions come in
+ *  increasing order of c the k-mers come out sorted.
+ *
+ *  the prefixes of a few characters are the tasks of the threads, handed
+ *  out as they finish. the k-mers of a task are kept until the tasks before
+ *  it are done, then written and freed, so that only the tasks finished
+ *  ahead of the oldest running one are held in memory, not the spectrum.
+ *
+ *  a k-mer file starts with the magic "BRIKMERS" and a version byte,
+ *  followed by k, the number of k-mers and the size of the alphabet as
+ *  64-bit integers, then the alphabet. each k-mer is the rank of its
+ *  characters in the alphabet, packed on the bits per character
+ *  (ceil(log2(sigma)), at least 1) of 64-bit words, first character in
+ *  the most significant bits, followed by its count as a 64-bit integer.
+ *  the order of the packed words is the order of the k-mers.
+ */
+
+#ifndef INCLUDED_KMER_SPECTRUM_HPP
+#define INCLUDED_KMER_SPECTRUM_HPP
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include "definitions.hpp"
+
+namespace bri {
+
+/*
+ * packing of the k-mers over an alphabet into 64-bit words
+ */
+class kmer_codec {
+
+public:
+
+    kmer_codec() {}
+
+    kmer_codec(std::string const& alphabet, ulint k) : alphabet(alphabet), k(k), rank(256, -1)
+    {
+        if (alphabet.empty() || alphabet.size() > 255) throw std::invalid_argument("invalid k-mer alphabet");
+        if (k == 0) throw std::invalid_argument("k must be positive");
+
+        for (ulint i = 0; i < alphabet.size(); ++i)
+        {
+            if (i > 0 && (uchar)alphabet[i-1] >= (uchar)alphabet[i])
+                throw std::invalid_argument("k-mer alphabet not sorted");
+            rank[(uchar)alphabet[i]] = i;
+        }
+
+        while ((1ULL << bits) < alphabet.size()) bits++;
+        words = (k * bits + 63) / 64;
+    }
+
+    /*
+     * writes the words of kmer (over the alphabet, of length k) to out
+     */
+    void pack(std::string const& kmer, ulint* out) const
+    {
+        std::fill(out, out + words, 0);
+        for (ulint i = 0; i < k; ++i)
+        {
+            ulint v = rank[(uchar)kmer[i]];
+            ulint bit = i * bits;
+            ulint shift = 64 - bits - bit % 64;
+
+            // a character may straddle two words
+            if (bit % 64 + bits <= 64) out[bit / 64] |= v << shift;
+            else
+            {
+                ulint low = bit % 64 + bits - 64;
+                out[bit / 64] |= v >> low;
+                out[bit / 64 + 1] |= v << (64 - low);
+            }
+        }
+    }
+
+    std::string unpack(ulint const* in) const
+    {
+        std::string res(k, 0);
+        ulint mask = (1ULL << bits) - 1;
+        for (ulint i = 0; i < k; ++i)
+        {
+            ulint bit = i * bits;
+            ulint v;
+            if (bit % 64 + bits <= 64) v = in[bit / 64] >> (64 - bits - bit % 64);
+            else
+            {
+                ulint low = bit % 64 + bits - 64;
+                v = (in[bit / 64] << low) | (in[bit / 64 + 1] >> (64 - low));
+            }
+            res[i] = alphabet[v & mask];
+        }
+        return res;
+    }
+
+    std::string alphabet;
+    ulint k = 0;
+
+    // of the alphabet, -1 for the other characters
+    std::vector<long> rank;
+
+    ulint bits = 1;
+
+    // per k-mer
+    ulint words = 0;
+
+};
+
+class kmer_file_writer {
+
+public:
+
+    kmer_file_writer(std::string const& file, kmer_codec const& codec) : out(file, std::ios::binary), codec(codec)
+    {
+        if (!out) throw std::runtime_error("cannot write k-mer file " + file);
+        out.write(MAGIC, 8);
+        out.put((char)VERSION);
+        put(codec.k);
+
+        // patched by close
+        put(0);
+
+        put(codec.alphabet.size());
+        out.write(codec.alphabet.data(), codec.alphabet.size());
+    }
+
+    /*
+     * packed words of a k-mer (codec.words), and its count
+     */
+    void write(ulint const* kmer, ulint count)
+    {
+        out.write((char*)kmer, codec.words * sizeof(ulint));
+        put(count);
+        n++;
+    }
+
+    void close()
+    {
+        out.seekp(9 + sizeof(ulint));
+        put(n);
+        out.close();
+        if (!out) throw std::runtime_error("cannot write k-mer file");
+    }
+
+    ulint size() const { return n; }
+
+    static constexpr char const* MAGIC = "BRIKMERS";
+    static const uchar VERSION = 1;
+
+private:
+
+    void put(ulint v)
+    {
+        out.write((char*)&v, sizeof(ulint));
+    }
+
+    std::ofstream out;
+    kmer_codec codec;
+    ulint n = 0;
+
+};
+
+class kmer_file_reader {
+
+public:
+
+    kmer_file_reader(std::string const& file) : in(file, std::ios::binary), file(file)
+    {
+        if (!in) throw std::runtime_error("cannot open k-mer file " + file);
+
+        char header[9];
+        in.read(header, 9);
+        if (in.gcount() != 9 || std::string(header, 8) != kmer_file_writer::MAGIC)
+            throw std::runtime_error(file + " is not a k-mer file");
+        if ((uchar)header[8] != kmer_file_writer::VERSION)
+            throw std::runtime_error("unsupported version of k-mer file " + file);
+
+        ulint k = get();
+        n = get();
+
+        std::string alphabet(get(), 0);
+        in.read(&alphabet[0], alphabet.size());
+        if ((ulint)in.gcount() != alphabet.size()) throw malformed();
+
+        codec = kmer_codec(alphabet, k);
+        buf.resize(codec.words);
+    }
+
+    /*
+     * reads the next k-mer and its count. false after the last one
+     */
+    bool next(std::string& kmer, ulint& count)
+    {
+        if (read == n) return false;
+
+        in.read((char*)buf.data(), codec.words * sizeof(ulint));
+        if ((ulint)in.gcount() != codec.words * sizeof(ulint)) throw malformed();
+        kmer = codec.unpack(buf.data());
+        count = get();
+        read++;
+
+        return true;
+    }
+
+    // number of k-mers
+    ulint size() const { return n; }
+
+    kmer_codec const& get_codec() const { return codec; }
+
+private:
+
+    ulint get()
+    {
+        ulint v;
+        in.read((char*)&v, sizeof(ulint));
+        if (in.gcount() != sizeof(ulint)) throw malformed();
+        return v;
+    }
+
+    std::runtime_error malformed() const
+    {
+        return std::runtime_error("truncated or malformed k-mer file " + file);
+    }
+
+    std::ifstream in;
+    std::string file;
+    kmer_codec codec;
+    std::vector<ulint> buf;
+    ulint n = 0;
+    ulint read = 0;
+
+};
+
+/*
+ * index_t: br_index or br_index_nplcp
+ */
+template<class index_t>
+class kmer_spectrum {
+
+public:
+
+    /*
+     * alphabet: the characters the k-mers are made of, in increasing
+     * order; k-mers with other characters (e.g. N, or the separator of
+     * the sequences) are skipped
+     */
+    kmer_spectrum(index_t& idx, ulint k, std::string const& alphabet, ulint min_count = 1, ulint max_count = -1) :
+        idx(idx), codec(alphabet, k), min_count(std::max<ulint>(min_count, 1)), max_count(max_count) {}
+
+    /*
+     * enumerates the k-mers on threads threads, and calls
+     * f(packed words, count) for each in increasing order
+     */
+    template<class F>
+    void enumerate(ulint threads, F f)
+    {
+        std::vector<task> tasks;
+        split(threads, tasks);
+
+        distinct = total = 0;
+
+        // tasks are written in order as soon as all those before them are
+        // done, by the thread finishing the last of them
+        std::mutex mutex;
+        std::vector<bool> done(tasks.size(), false);
+        ulint written = 0;
+
+        std::atomic<ulint> next(0);
+        auto work = [&]()
+        {
+            search s(codec.k);
+            for (ulint t = next++; t < tasks.size(); t = next++)
+            {
+                s.kmer = tasks[t].prefix;
+                dfs(tasks[t].rangeR, s, tasks[t].kmers);
+
+                std::lock_guard<std::mutex> lock(mutex);
+                done[t] = true;
+                for (; written < tasks.size() && done[written]; ++written)
+                {
+                    auto& kmers = tasks[written].kmers;
+                    for (ulint i = 0; i < kmers.size(); i += codec.words + 1)
+                    {
+                        ulint count = kmers[i + codec.words];
+                        f(&kmers[i], count);
+                        distinct++;
+                        total += count;
+                    }
+                    std::vector<ulint>().swap(kmers);
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (ulint t = 1; t < threads; ++t) workers.emplace_back(work);
+        work();
+        for (auto& w: workers) w.join();
+    }
+
+    /*
+     * enumerates the k-mers to a k-mer file, returns their number
+     */
+    ulint write(std::string const& file, ulint threads)
+    {
+        kmer_file_writer out(file, codec);
+        enumerate(threads, [&](ulint const* kmer, ulint count) { out.write(kmer, count); });
+        out.close();
+        return out.size();
+    }
+
+    kmer_codec const& get_codec() const { return codec; }
+
+    // of the last enumeration: distinct k-mers and the sum of their counts
+    ulint distinct = 0;
+    ulint total = 0;
+
+    // tasks per thread: the smaller the tasks, the fewer k-mers are kept
+    // while a slow task holds back the writing of the next ones
+    static const ulint TASKS_PER_THREAD = 64;
+
+private:
+
+    typedef std::vector<std::pair<uchar,range_t> > extensions;
+
+    /*
+     * k-mers starting with prefix, packed words then count
+     */
+    struct task {
+        std::string prefix;
+        range_t rangeR;
+        std::vector<ulint> kmers;
+    };
+
+    /*
+     * state of the search of a thread: the current k-mer, and the right
+     * extensions of each of its prefixes
+     */
+    struct search {
+        search(ulint k) : ext(k + 1) {}
+        std::string kmer;
+        std::vector<extensions> ext;
+    };
+
+    /*
+     * the prefixes of the shortest length giving TASKS_PER_THREAD tasks
+     * per thread (at most k), which occur at least min_count times, in
+     * increasing order
+     */
+    void split(ulint threads, std::vector<task>& tasks)
+    {
+        tasks.assign(1, task());
+        tasks[0].rangeR = idx.full_range();
+
+        extensions ext;
+        for (ulint len = 0; len < codec.k && tasks.size() < TASKS_PER_THREAD * threads; ++len)
+        {
+            std::vector<task> longer;
+            for (auto& t: tasks)
+            {
+                idx.right_ranges(t.rangeR, ext);
+                for (auto& e: ext)
+                {
+                    if (codec.rank[e.first] < 0 || size(e.second) < min_count) continue;
+
+                    longer.push_back(task());
+                    longer.back().prefix = t.prefix + (char)e.first;
+                    longer.back().rangeR = e.second;
+                }
+            }
+            tasks.swap(longer);
+        }
+    }
+
+    void dfs(range_t rangeR, search& s, std::vector<ulint>& out)
+    {
+        ulint depth = s.kmer.size();
+        if (depth == codec.k)
+        {
+            ulint count = size(rangeR);
+            if (count > max_count) return;
+
+            out.resize(out.size() + codec.words + 1);
+            codec.pack(s.kmer, &out[out.size() - codec.words - 1]);
+            out.back() = count;
+            return;
+        }
+
+        // deeper calls use the extensions of the next depths
+        extensions& ext = s.ext[depth];
+        idx.right_ranges(rangeR, ext);
+
+        for (auto& e: ext)
+        {
+            if (codec.rank[e.first] < 0 || size(e.second) < min_count) continue;
+
+            s.kmer.push_back(e.first);
+            dfs(e.second, s, out);
+            s.kmer.pop_back();
+        }
+    }
+
+    static ulint size(range_t r)
+    {
+        return r.first > r.second ? 0 : r.second + 1 - r.first;
+    }
+
+    index_t& idx;
+    kmer_codec codec;
+    ulint min_count;
+    ulint max_count;
+
+};
+
+};
+
+#endif /* INCLUDED_KMER_SPECTRUM_HPP */
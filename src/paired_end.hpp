@@ -0,0 +1,125 @@
+/*
+ * paired_end: join of the occurrences of the two mates of a read pair
+ *
+ *  a concordant pair has one mate on the forward strand at position f and
+ *  the other one reverse complemented at position b >= f, with the insert
+ *  size b + |other mate| - f inside [min_insert, max_insert]. both
+ *  occurrence lists are sorted, so all the pairs are found by a single
+ *  merge with a sliding window.
+ *
+ *  a repetitive mate is not located: the pairs are then found from the
+ *  occurrences of the other mate, by extracting from the index the text of
+ *  the insert window of each and scanning it for the repetitive mate, so
+ *  that the cost is bounded by the rarer mate.
+ */
+
+#ifndef INCLUDED_PAIRED_END_HPP
+#define INCLUDED_PAIRED_END_HPP
+
+#include "definitions.hpp"
+
+namespace bri {
+
+struct mate_pair {
+    // position of the forward mate
+    ulint fwd;
+    // position of the reverse complemented mate
+    ulint rev;
+    ulint insert;
+};
+
+/*
+ * append to res the concordant pairs of fwd and rev (both sorted)
+ * \param rev_len: length of the reverse complemented mate
+ */
+inline void join_mates(std::vector<ulint> const& fwd, std::vector<ulint> const& rev, ulint rev_len,
+                       ulint min_insert, ulint max_insert, std::vector<mate_pair>& res)
+{
+    // rev[lo...] are the candidates not yet too far to the left of fwd[i]
+    ulint lo = 0;
+
+    for (ulint i = 0; i < fwd.size(); ++i)
+    {
+        ulint f = fwd[i];
+
+        while (lo < rev.size() && (rev[lo] < f || rev[lo] + rev_len < f + min_insert)) ++lo;
+
+        for (ulint k = lo; k < rev.size() && rev[k] + rev_len <= f + max_insert; ++k)
+        {
+            res.push_back({f, rev[k], rev[k] + rev_len - f});
+        }
+    }
+}
+
+/*
+ * append to res the offsets in text where pattern occurs with at most
+ * allowed mismatches, in increasing order
+ */
+inline void scan_mate(std::string const& text, std::string const& pattern, ulint allowed, std::vector<ulint>& res)
+{
+    for (ulint o = 0; o + pattern.size() <= text.size(); ++o)
+    {
+        ulint mis = 0;
+        for (ulint i = 0; i < pattern.size() && mis <= allowed; ++i)
+            if (text[o+i] != pattern[i]) mis++;
+        if (mis <= allowed) res.push_back(o);
+    }
+}
+
+/*
+ * append to res the concordant pairs of the occurrences of a mate, given
+ * by its samples, and of the other one, not located: the pairs are found
+ * in the insert window of each occurrence of the located mate.
+ * \param fwd: true if the located mate is the forward one
+ * \param located_len: length of the located mate
+ * \param other: the other mate as it occurs in the text (reverse
+ *        complemented if the located mate is the forward one)
+ */
+template<class index_t, class samples_t>
+void join_window(index_t& idx, samples_t const& samples, bool fwd, ulint located_len, std::string const& other,
+                 ulint allowed, ulint min_insert, ulint max_insert, std::vector<mate_pair>& res)
+{
+    ulint first = res.size();
+    std::vector<ulint> offsets;
+
+    for (auto it = samples.begin(); it != samples.end(); ++it)
+    {
+        for (auto occ: idx.locate_rows(it->second))
+        {
+            offsets.clear();
+            if (fwd)
+            {
+                // the other mate ends at most max_insert characters after f
+                ulint f = occ.first;
+                scan_mate(idx.extract(occ.second, max_insert, true), other, allowed, offsets);
+                for (auto o: offsets)
+                    if (o + other.size() >= min_insert) res.push_back({f, f + o, o + other.size()});
+            }
+            else
+            {
+                // the other mate starts at most max_insert - |b| characters
+                // before b, and may overlap it
+                ulint b = occ.first;
+                if (located_len > max_insert) continue;
+                std::string before = idx.extract(occ.second, max_insert - located_len);
+                ulint start = b - before.size();
+                scan_mate(before + idx.extract(occ.second, other.size(), true), other, allowed, offsets);
+                for (auto o: offsets)
+                {
+                    ulint f = start + o;
+                    ulint insert = b + located_len - f;
+                    if (f <= b && insert >= min_insert && insert <= max_insert) res.push_back({f, b, insert});
+                }
+            }
+        }
+    }
+
+    std::sort(res.begin() + first, res.end(), [](mate_pair const& x, mate_pair const& y)
+    {
+        return x.fwd < y.fwd || (x.fwd == y.fwd && x.rev < y.rev);
+    });
+}
+
+};
+
+#endif /* INCLUDED_PAIRED_END_HPP */
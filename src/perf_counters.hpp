@@ -0,0 +1,249 @@
+/*
+ * perf_counters: hardware performance counters of the calling thread
+ * (Linux perf_event_open), accumulated per phase of a tool (-perf option
+ * of bri-bench and of the query tools)
+ *
+ *  the events are opened as one group, read with a single system call and
+ *  scaled by the time they were actually counted if the PMU multiplexed
+ *  them. only user space is counted, which perf_event_paranoid <= 2
+ *  allows. events the CPU or the kernel does not support are reported as
+ *  n/a; if none can be opened (no PMU in a VM, perf_event_paranoid = 3,
+ *  other platforms) the counters are unavailable and every call is a no-op.
+ */
+
+#ifndef INCLUDED_PERF_COUNTERS_HPP
+#define INCLUDED_PERF_COUNTERS_HPP
+
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "definitions.hpp"
+
+namespace bri {
+
+class perf_counters {
+
+public:
+
+    enum event { CYCLES, INSTRUCTIONS, LLC_MISSES, DTLB_MISSES, BRANCH_MISSES, EVENTS };
+
+    static char const* name(ulint e)
+    {
+        static char const* names[EVENTS] = {"cycles", "instructions", "LLC-misses", "dTLB-misses", "branch-misses"};
+        return names[e];
+    }
+
+    // raw counts at some point, see now()
+    struct snapshot {
+        ulint values[EVENTS] = {};
+        ulint enabled = 0;
+        ulint running = 0;
+    };
+
+    /*
+     * \param enable: open the counters. if false, nothing is counted
+     */
+    perf_counters(bool enable = true)
+    {
+        for (ulint e = 0; e < EVENTS; ++e) fds[e] = -1;
+        if (enable) open();
+    }
+
+    ~perf_counters()
+    {
+#ifdef __linux__
+        for (ulint e = 0; e < EVENTS; ++e)
+            if (fds[e] >= 0) close(fds[e]);
+#endif
+    }
+
+    perf_counters(perf_counters const&) = delete;
+    perf_counters& operator=(perf_counters const&) = delete;
+
+    // at least one event is counted
+    bool available() const { return leader >= 0; }
+
+    bool available(ulint e) const { return fds[e] >= 0; }
+
+    // why the counters are not available
+    std::string const& error() const { return reason; }
+
+    snapshot now() const
+    {
+        snapshot res;
+#ifdef __linux__
+        if (!available()) return res;
+
+        // nr, time enabled, time running, then a value per opened event
+        ulint buf[3 + EVENTS];
+        if (read(leader, buf, sizeof(buf)) < (ssize_t)(3 * sizeof(ulint))) return res;
+
+        res.enabled = buf[1];
+        res.running = buf[2];
+        for (ulint k = 0; k < buf[0] && k < order.size(); ++k) res.values[order[k]] = buf[3 + k];
+#endif
+        return res;
+    }
+
+    /*
+     * adds the events between from and to to phase, as one call of it
+     */
+    void add(std::string const& phase, snapshot const& from, snapshot const& to)
+    {
+        if (!available()) return;
+
+        auto& p = find(phase);
+        p.calls++;
+
+        ulint running = to.running - from.running;
+        ulint enabled = to.enabled - from.enabled;
+        if (running == 0) return;
+
+        for (ulint e = 0; e < EVENTS; ++e)
+            p.counts[e] += (double)(to.values[e] - from.values[e]) * enabled / running;
+    }
+
+    /*
+     * events of phase, 0 if it was never added
+     */
+    double total(std::string const& phase, ulint e) const
+    {
+        for (auto& p: phases)
+            if (p.name == phase) return p.counts[e];
+        return 0;
+    }
+
+    ulint calls(std::string const& phase) const
+    {
+        for (auto& p: phases)
+            if (p.name == phase) return p.calls;
+        return 0;
+    }
+
+    /*
+     * a line per phase, with the total of each event and its average per
+     * call of the phase; nothing if the counters were not opened
+     */
+    void print(std::ostream& out) const
+    {
+        if (!requested) return;
+
+        out << std::endl;
+        if (!available())
+        {
+            out << "Hardware counters not available: " << reason << std::endl;
+            return;
+        }
+
+        out << "Hardware counters (user space, total and per call of the phase):" << std::endl;
+        for (auto& p: phases)
+        {
+            out << p.name << " (" << p.calls << " calls)" << std::endl;
+            for (ulint e = 0; e < EVENTS; ++e)
+            {
+                out << "    " << std::left << std::setw(14) << name(e) << std::right;
+                if (!available(e))
+                {
+                    out << "n/a" << std::endl;
+                    continue;
+                }
+                out << std::fixed << std::setprecision(0) << std::setw(16) << p.counts[e]
+                    << std::setprecision(1) << std::setw(14) << p.counts[e] / std::max<ulint>(p.calls, 1)
+                    << std::defaultfloat << std::setprecision(6) << std::endl;
+            }
+            if (available(CYCLES) && available(INSTRUCTIONS) && p.counts[CYCLES] > 0)
+                out << "    " << std::left << std::setw(14) << "IPC" << std::right << std::setw(16)
+                    << p.counts[INSTRUCTIONS] / p.counts[CYCLES] << std::endl;
+        }
+    }
+
+private:
+
+    struct phase_counts {
+        std::string name;
+        ulint calls = 0;
+        double counts[EVENTS] = {};
+    };
+
+    phase_counts& find(std::string const& phase)
+    {
+        for (auto& p: phases)
+            if (p.name == phase) return p;
+        phases.push_back(phase_counts());
+        phases.back().name = phase;
+        return phases.back();
+    }
+
+    void open()
+    {
+        requested = true;
+
+#ifdef __linux__
+        const ulint configs[EVENTS][2] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+            {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}
+        };
+
+        for (ulint e = 0; e < EVENTS; ++e)
+        {
+            struct perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = configs[e][0];
+            attr.config = configs[e][1];
+            attr.disabled = leader < 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            // this thread, on any CPU
+            int fd = syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+            if (fd < 0)
+            {
+                if (reason.empty()) reason = std::string("perf_event_open: ") + std::strerror(errno);
+                continue;
+            }
+
+            fds[e] = fd;
+            if (leader < 0) leader = fd;
+            order.push_back(e);
+        }
+
+        if (available())
+        {
+            ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+#else
+        reason = "perf_event_open is only supported on Linux";
+#endif
+    }
+
+    bool requested = false;
+    std::string reason;
+
+    int fds[EVENTS];
+    int leader = -1;
+
+    // events in the order of the values read from the group
+    std::vector<ulint> order;
+
+    std::vector<phase_counts> phases;
+
+};
+
+};
+
+#endif /* INCLUDED_PERF_COUNTERS_HPP */
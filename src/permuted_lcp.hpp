@@ -3,6 +3,7 @@
 
 #include "definitions.hpp"
 #include "sparse_sd_vector.hpp"
+#include "query_stats.hpp"
 
 
 namespace bri {
@@ -15,87 +16,51 @@ public:
 
     /*
      * constructor with cache_config.
-     * assume text and SA and ISA are cached by the config.
+     * assume text and SA are cached by the config. SA is scanned once for
+     * the run samples of BWT, then PLCP is built from them as below.
      */
     permuted_lcp(sdsl::cache_config& cc)
     {
-        // construct ISA
-        //sdsl::int_vector_buffer<> isa(sdsl::cache_file_name(sdsl::conf::KEY_ISA, cc));
-        sdsl::int_vector<> isa;
-        sdsl::load_from_file(isa, sdsl::cache_file_name(sdsl::conf::KEY_ISA, cc));
-
-        // construct LCP
-        sdsl::construct_lcp_kasai<8>(cc);
-        //sdsl::int_vector_buffer<> lcp(sdsl::cache_file_name(sdsl::conf::KEY_LCP, cc));
-        
-        sdsl::int_vector<> lcp;
-        sdsl::load_from_file(lcp, sdsl::cache_file_name(sdsl::conf::KEY_LCP, cc));
-       
-        n = isa.size();
-
-        std::vector<bool> S(2*n+1,false);
-        S[0] = true;
-
-        ulint isa_val = isa[0];
-        ulint lcp_prev = lcp[isa_val];
-        ulint lcp_now;
-        ulint pos = lcp_prev + 1;
-
-        for (ulint i = 1; i < n; ++i)
-        {
-            S[pos] = true;
-            isa_val = isa[i];
-            lcp_now = lcp[isa_val];
-            pos += lcp_now + 2;
-            pos -= lcp_prev;
-            lcp_prev = lcp_now;
-        }
-        S[pos] = true;
+        sdsl::int_vector<8> text;
+        sdsl::load_from_file(text, sdsl::cache_file_name(sdsl::conf::KEY_TEXT, cc));
+        sdsl::int_vector_buffer<> sa(sdsl::cache_file_name(sdsl::conf::KEY_SA, cc));
 
-        u = pos + 1;
-        std::vector<bool> ones_bv(u,false);
-        std::vector<bool> zeros_bv(u,false);
+        // BWT character of row i, the terminator (sa[i] == 0) being unique
+        auto bwt_at = [&](ulint i) -> ulint { return sa[i] > 0 ? text[sa[i]-1] : 256; };
+        auto sample = [&](ulint i) -> ulint { return sa[i] > 0 ? sa[i] - 1 : sa.size() - 1; };
 
-        // generate run length encoding ones&zeros from S
-        // S: unary encoding of j + PLCP[j]
+        std::vector<range_t> samples_first;
+        std::vector<range_t> samples_last;
+        for (ulint i = 0; i < sa.size(); ++i)
         {
-            bool bit_1 = true; // tell if we are counting 1 bits
-            ulint cont_1 = 0, cont_0 = 0; // continuous number of 1 bits & 0 bits
-
-            for (ulint i = 0; i < u; ++i)
-            {
-                if (S[i])
-                {
-                    if (bit_1)
-                    {
-                        cont_1++;
-                    } else {
-                        bit_1 = true;
-                        cont_1++;
-                        zeros_bv[cont_0-1] = true;
-                    }
-                } 
-                else 
-                {
-                    if (bit_1)
-                    {
-                        bit_1 = false;
-                        cont_0++;
-                        ones_bv[cont_1-1] = true;
-                    } else {
-                        cont_0++;
-                    }
-                }
-            }
-            if (bit_1) ones_bv[cont_1-1] = true;
-            else zeros_bv[cont_0-1] = true;
+            if (i == 0 || bwt_at(i) != bwt_at(i-1))
+                samples_first.push_back({sample(i), samples_first.size()});
+            if (i == sa.size() - 1 || bwt_at(i) != bwt_at(i+1))
+                samples_last.push_back({sample(i), samples_last.size()});
         }
 
-        ones = sparse_bitvector_t(ones_bv);
-        zeros = sparse_bitvector_t(zeros_bv);
+        build(text, sa.size(), samples_first, samples_last);
+    }
 
-        sdsl::remove(sdsl::cache_file_name(sdsl::conf::KEY_LCP, cc));
+    /*
+     * constructor from the text and the SA samples at the boundaries of the
+     * runs of its BWT, in run order (as returned by sufsort).
+     */
+    permuted_lcp(std::string const& text, std::vector<range_t> const& samples_first,
+                 std::vector<range_t> const& samples_last)
+    {
+        build(text, text.size() + 1, samples_first, samples_last);
+    }
 
+    /*
+     * constructor from the irreducible values (text position, PLCP value),
+     * sorted by text position, which must include every text position at
+     * the first position of a BWT run (bwt_merge).
+     * \param n: text length including the terminator
+     */
+    permuted_lcp(ulint n, std::vector<range_t> const& irreducible)
+    {
+        encode(n, irreducible);
     }
 
     /*
@@ -103,6 +68,7 @@ public:
      */
     ulint operator[](size_t i)
     {
+        BRI_COUNT(plcp_lookups);
         assert(i < n);
         ulint rank_0 = ones.rank(i+1);
         if (rank_0 > 0)
@@ -152,34 +118,36 @@ public:
         zeros.load(in);
     }
 
-    ulint print_space()
+    /*
+     * n and u, then the bitvectors of the ones and zeros of the unary
+     * encoding of PLCP
+     */
+    space_node space_tree(std::string const& name = "permuted_lcp") const
     {
-        ulint tot_bytes = 0;
+        space_node res(name, sizeof(n) + sizeof(u));
+        if (n == 0) return res;
 
-        std::ofstream out("/dev/null");
-        std::cout << "space for permuted_lcp:" << std::endl;
+        res.add(ones.space_tree("ones"));
+        res.add(zeros.space_tree("zeros"));
 
-        auto bytes = ones.serialize(out);
-        tot_bytes += bytes;
-        std::cout << "- bitvector ones: " << bytes << " bytes" << std::endl;
+        return res;
+    }
 
-        bytes = zeros.serialize(out);
-        tot_bytes += bytes;
-        std::cout << "- bitvector zeros: " << bytes << " bytes" << std::endl;
+    ulint size_in_bytes() const
+    {
+        return space_tree().bytes;
+    }
 
-        return tot_bytes;
+    ulint print_space()
+    {
+        auto space = space_tree();
+        space.print(std::cout);
+        return space.bytes;
     }
 
     ulint get_space()
     {
-        ulint tot_bytes = 0;
-
-        std::ofstream out("/dev/null");
-
-        tot_bytes += ones.serialize(out);
-        tot_bytes += zeros.serialize(out);
-
-        return tot_bytes;
+        return size_in_bytes();
     }
 
     ulint size()
@@ -189,6 +157,87 @@ public:
 
 private:
 
+    /*
+     * only the irreducible values, at the first position of each run, are
+     * computed by comparing the text (O(n log n) characters in total, see
+     * Kärkkäinen et al., "Permuted longest-common-prefix array"); any other
+     * value is PLCP[i] = PLCP[i-1] - 1.
+     * \param n: text length including the terminator
+     */
+    template<class text_t>
+    void build(text_t const& text, ulint n, std::vector<range_t> const& samples_first,
+               std::vector<range_t> const& samples_last)
+    {
+        // (text position, PLCP value) at the first position of each run
+        std::vector<range_t> irreducible;
+        irreducible.reserve(samples_first.size());
+        for (ulint i = 0; i < samples_first.size(); ++i)
+        {
+            ulint j = (samples_first[i].first + 1) % n;
+
+            // the first suffix has no predecessor
+            if (i == 0)
+            {
+                irreducible.push_back({j,0});
+                continue;
+            }
+
+            ulint k = (samples_last[i-1].first + 1) % n;
+            ulint l = 0;
+            while (j + l < n - 1 && k + l < n - 1 && text[j+l] == text[k+l]) ++l;
+            irreducible.push_back({j,l});
+        }
+        std::sort(irreducible.begin(), irreducible.end());
+
+        encode(n, irreducible);
+    }
+
+    /*
+     * S has a 1 at 0 and at j + (j + PLCP[j]) + 1 for each j. between two
+     * irreducible values consecutive 1s are adjacent, so the runs of S are
+     * encoded into ones&zeros from the irreducible values only.
+     */
+    void encode(ulint n, std::vector<range_t> const& irreducible)
+    {
+        this->n = n;
+
+        // the terminator precedes text position 0, so it starts a run
+        assert(irreducible[0].first == 0);
+
+        ulint plcp_last = irreducible.back().second - (n - 1 - irreducible.back().first);
+        u = plcp_last + 2*(n-1) + 2;
+
+        // positions of the 1-bits of ones&zeros, in increasing order
+        std::vector<ulint> ones_pos;
+        std::vector<ulint> zeros_pos;
+        {
+            // position in S of the last 1 before the current irreducible value
+            ulint pos = 0;
+
+            for (ulint k = 0; k < irreducible.size(); ++k)
+            {
+                ulint j = irreducible[k].first;
+                if (k > 0)
+                {
+                    // PLCP[j-1], reduced from the previous irreducible value
+                    ulint prev_j = irreducible[k-1].first;
+                    pos = irreducible[k-1].second + 2*prev_j + 1 + (j - 1 - prev_j);
+                }
+
+                ulint pos_now = irreducible[k].second + 2*j + 1;
+                if (pos_now > pos + 1)
+                {
+                    ones_pos.push_back(j);
+                    zeros_pos.push_back(pos_now - j - 2);
+                }
+            }
+            ones_pos.push_back(n);
+        }
+
+        ones = sparse_bitvector_t(ones_pos,u);
+        zeros = sparse_bitvector_t(zeros_pos,u);
+    }
+
     // length of LCP
     ulint n = 0;
 
@@ -0,0 +1,411 @@
+/*
+ * prefix_free_parse: BWT and SA samples at run boundaries computed from the
+ * prefix-free parse of the text (Boucher et al., "Prefix-free parsing for
+ * building big BWTs", AMB 2019)
+ *
+ *  the remapped text T is padded as Y = $^w T $^w and cut at every window of
+ *  w characters whose Karp-Rabin fingerprint is 0 modulo p, and at the two
+ *  paddings. a phrase runs from a trigger window to the end of the next one,
+ *  so consecutive phrases overlap by w characters and the set of distinct
+ *  phrases (the dictionary) is prefix-free. a suffix of T is then ordered
+ *  first by the suffix alpha of its phrase (longer than w), and for equal
+ *  alphas by the suffix of the parse that follows the phrase. only the
+ *  dictionary, the parse and the suffix array of the parse are built, whose
+ *  size is proportional to the parse rather than to the text.
+ */
+
+#ifndef INCLUDED_PREFIX_FREE_PARSE_HPP
+#define INCLUDED_PREFIX_FREE_PARSE_HPP
+
+#include "definitions.hpp"
+#include "rle_string.hpp"
+
+namespace bri {
+
+class prefix_free_parse {
+
+public:
+
+    // padding of the text, sorted before any remapped character.
+    // it precedes T[0], so it is also the terminator of the BWT
+    static const uchar PADDING = 1;
+
+    /*
+     * parse the remapped input, or the remapped reversed input.
+     * \param w: length of the trigger windows
+     * \param p: modulus of the fingerprints of the trigger windows
+     */
+    prefix_free_parse(std::string const& input, std::vector<uchar> const& remap,
+                      bool reversed = false, ulint w = 10, ulint p = 100)
+                      :
+                      input(input),
+                      remap(remap),
+                      reversed(reversed),
+                      n(input.size()),
+                      w(w)
+    {
+        assert(w > 0 && p > 0);
+
+        parse_text(p);
+        sort_dictionary();
+        sort_parse();
+        build_occurrences();
+    }
+
+    /*
+     * builds the run-length encoded BWT and SA samples at the beginnings and
+     * ends of its runs, in the same form as the suffix array based construction
+     */
+    std::tuple<rle_string_builder, std::vector<range_t>, std::vector<range_t> > bwt_and_samples()
+    {
+        std::vector<ulint> rows;
+        return bwt_and_samples(std::vector<ulint>(), rows);
+    }
+
+    /*
+     * same as above, also storing in rows the ranks in SA (i.e. ISA values)
+     * of the text positions in queries
+     */
+    std::tuple<rle_string_builder, std::vector<range_t>, std::vector<range_t> >
+    bwt_and_samples(std::vector<ulint> const& queries, std::vector<ulint>& rows)
+    {
+        run_builder runs(n + 1);
+
+        // alphas containing a queried position are enumerated one by one
+        rows = std::vector<ulint>(queries.size(), 0);
+        std::unordered_map<ulint, std::vector<ulint> > query_ids;
+        std::unordered_set<range_t, range_hash> queried;
+        for (ulint i = 0; i < queries.size(); ++i)
+        {
+            assert(queries[i] < n);
+            query_ids[queries[i]].push_back(i);
+
+            ulint q = queries[i] + w;
+            ulint k = std::upper_bound(starts.begin(), starts.end(), q) - starts.begin() - 1;
+            queried.insert({parse[k], q - starts[k]});
+        }
+
+        // the terminator is the smallest suffix, preceded by T[n-1]
+        runs.push(at(n + w - 1), 1, n, n);
+
+        // suffixes (phrase, offset) of the phrases longer than w, except
+        // those starting in the leading padding
+        std::vector<range_t> alphas;
+        for (ulint d = 0; d < dict.size(); ++d)
+            for (ulint o = 0; o + w < dict[d].size(); ++o)
+                if (dict[d][o] != PADDING) alphas.push_back({d,o});
+
+        std::sort(alphas.begin(), alphas.end(), [&](range_t const& a, range_t const& b)
+        {
+            return compare_alpha(a,b) < 0;
+        });
+
+        for (ulint i = 0; i < alphas.size();)
+        {
+            ulint j = i + 1;
+            while (j < alphas.size() && compare_alpha(alphas[i],alphas[j]) == 0) ++j;
+
+            // if all the occurrences of alpha are preceded by the same
+            // character, only the extreme ones are sampled
+            bool same_char = true;
+            for (ulint g = i; g < j && same_char; ++g)
+            {
+                ulint d = alphas[g].first, o = alphas[g].second;
+                same_char = o > 0 && dict[d][o-1] == dict[alphas[i].first][alphas[i].second-1]
+                            && queried.count(alphas[g]) == 0;
+            }
+
+            if (same_char)
+            {
+                ulint cnt = 0;
+                range_t first = alphas[i], last = alphas[i];
+                for (ulint g = i; g < j; ++g)
+                {
+                    ulint d = alphas[g].first;
+                    cnt += occ_begin[d+1] - occ_begin[d];
+                    if (key(min_occ[d]) < key(min_occ[first.first])) first = alphas[g];
+                    if (key(max_occ[d]) > key(max_occ[last.first])) last = alphas[g];
+                }
+
+                runs.push(dict[alphas[i].first][alphas[i].second-1], cnt,
+                          starts[min_occ[first.first]] + first.second - w,
+                          starts[max_occ[last.first]] + last.second - w);
+            }
+            else
+            {
+                // (rank of the following parse suffix, preceding character, text position)
+                std::vector<std::tuple<ulint, uchar, ulint> > occs;
+                for (ulint g = i; g < j; ++g)
+                {
+                    ulint d = alphas[g].first, o = alphas[g].second;
+                    for (ulint x = occ_begin[d]; x < occ_begin[d+1]; ++x)
+                    {
+                        ulint k = occ[x];
+                        uchar c = o > 0 ? dict[d][o-1] : at(starts[k]-1);
+                        occs.push_back(std::make_tuple(key(k), c, starts[k] + o - w));
+                    }
+                }
+                std::sort(occs.begin(), occs.end());
+
+                for (auto& t: occs)
+                {
+                    auto it = query_ids.find(std::get<2>(t));
+                    if (it != query_ids.end())
+                        for (auto id: it->second) rows[id] = runs.size();
+
+                    runs.push(std::get<1>(t), 1, std::get<2>(t), std::get<2>(t));
+                }
+            }
+
+            i = j;
+        }
+
+        assert(runs.size() == n + 1);
+
+        return runs.finish();
+    }
+
+    /*
+     * number of phrases in the parse
+     */
+    ulint parse_size() { return parse.size(); }
+
+    /*
+     * total length of the distinct phrases
+     */
+    ulint dictionary_size()
+    {
+        ulint res = 0;
+        for (auto& d: dict) res += d.size();
+        return res;
+    }
+
+private:
+
+    /*
+     * appends BWT characters with the SA values of their first and last
+     * positions, sampling SA as sufsort does. BWT is run-length encoded
+     * on the fly
+     */
+    class run_builder {
+
+    public:
+
+        run_builder(ulint N) : N(N) {}
+
+        void push(uchar c, ulint cnt, ulint sa_first, ulint sa_last)
+        {
+            if (bwt_b.size() == 0 || c != last_c)
+            {
+                if (bwt_b.size() > 0) samples_last.push_back({prev(last_sa), samples_last.size()});
+                samples_first.push_back({prev(sa_first), samples_first.size()});
+                last_c = c;
+            }
+            last_sa = sa_last;
+            bwt_b.push(c, cnt);
+        }
+
+        ulint size() { return bwt_b.size(); }
+
+        std::tuple<rle_string_builder, std::vector<range_t>, std::vector<range_t> > finish()
+        {
+            samples_last.push_back({prev(last_sa), samples_last.size()});
+            return std::tuple<rle_string_builder, std::vector<range_t>, std::vector<range_t> >
+                (std::move(bwt_b), std::move(samples_first), std::move(samples_last));
+        }
+
+    private:
+
+        // samples are stored as SA[i] - 1
+        ulint prev(ulint sa) { return sa > 0 ? sa - 1 : N - 1; }
+
+        ulint N;
+        uchar last_c = 0;
+        ulint last_sa = 0;
+        rle_string_builder bwt_b;
+        std::vector<range_t> samples_first;
+        std::vector<range_t> samples_last;
+
+    };
+
+    /*
+     * character at position q of the padded text Y
+     */
+    uchar at(ulint q)
+    {
+        if (q < w || q >= n + w) return PADDING;
+        ulint i = q - w;
+        return remap[(uchar)input[reversed ? n - 1 - i : i]];
+    }
+
+    /*
+     * cut Y at the trigger windows
+     */
+    void parse_text(ulint p)
+    {
+        const ulint prime = 1999999973;
+        const ulint base = 256;
+
+        // base^(w-1), to drop the leftmost character of the window
+        ulint msb = 1;
+        for (ulint i = 1; i < w; ++i) msb = msb * base % prime;
+
+        std::unordered_map<std::string, ulint> ids;
+        starts.push_back(0);
+
+        ulint h = 0;
+        for (ulint q = 0; q < n + 2*w; ++q)
+        {
+            if (q >= w) h = (h + prime - at(q-w) * msb % prime) % prime;
+            h = (h * base + at(q)) % prime;
+
+            if (q + 1 < w) continue;
+
+            // window Y[s...q]
+            ulint s = q + 1 - w;
+            if (s == n + w || (s > 0 && s < n + w && h % p == 0))
+            {
+                std::string phrase;
+                for (ulint x = starts.back(); x <= q; ++x) phrase.push_back((char)at(x));
+
+                auto it = ids.find(phrase);
+                if (it == ids.end())
+                {
+                    it = ids.insert({phrase, dict.size()}).first;
+                    dict.push_back(phrase);
+                }
+                parse.push_back(it->second);
+
+                if (s < n + w) starts.push_back(s);
+            }
+        }
+
+        assert(starts.size() == parse.size());
+    }
+
+    /*
+     * renumber phrases by their lexicographic rank
+     */
+    void sort_dictionary()
+    {
+        std::vector<ulint> order(dict.size());
+        for (ulint i = 0; i < order.size(); ++i) order[i] = i;
+        std::sort(order.begin(), order.end(), [&](ulint a, ulint b) { return dict[a] < dict[b]; });
+
+        std::vector<ulint> rank(dict.size());
+        std::vector<std::string> sorted(dict.size());
+        for (ulint i = 0; i < order.size(); ++i)
+        {
+            rank[order[i]] = i;
+            sorted[i].swap(dict[order[i]]);
+        }
+        dict.swap(sorted);
+
+        for (auto& d: parse) d = rank[d];
+    }
+
+    /*
+     * inverse suffix array of the parse by prefix doubling. since the
+     * dictionary is prefix-free, suffixes of the parse compare as the
+     * corresponding suffixes of the text.
+     */
+    void sort_parse()
+    {
+        ulint m = parse.size();
+        std::vector<ulint> sa(m);
+        for (ulint i = 0; i < m; ++i) sa[i] = i;
+
+        isa_parse = parse;
+        std::vector<ulint> tmp(m);
+
+        for (ulint h = 1; ; h <<= 1)
+        {
+            auto pair_of = [&](ulint i)
+            {
+                return range_t(isa_parse[i], i + h < m ? isa_parse[i+h] + 1 : 0);
+            };
+
+            std::sort(sa.begin(), sa.end(), [&](ulint a, ulint b) { return pair_of(a) < pair_of(b); });
+
+            tmp[sa[0]] = 0;
+            for (ulint i = 1; i < m; ++i)
+                tmp[sa[i]] = tmp[sa[i-1]] + (pair_of(sa[i-1]) < pair_of(sa[i]) ? 1 : 0);
+
+            isa_parse.swap(tmp);
+
+            if (isa_parse[sa[m-1]] == m - 1) break;
+        }
+    }
+
+    /*
+     * positions of each phrase in the parse, and the ones whose following
+     * parse suffix is the smallest/largest
+     */
+    void build_occurrences()
+    {
+        occ_begin = std::vector<ulint>(dict.size() + 1, 0);
+        for (auto d: parse) occ_begin[d+1]++;
+        for (ulint d = 0; d < dict.size(); ++d) occ_begin[d+1] += occ_begin[d];
+
+        occ = std::vector<ulint>(parse.size());
+        std::vector<ulint> pos(occ_begin.begin(), occ_begin.end() - 1);
+        for (ulint k = 0; k < parse.size(); ++k) occ[pos[parse[k]]++] = k;
+
+        min_occ = std::vector<ulint>(dict.size());
+        max_occ = std::vector<ulint>(dict.size());
+        for (ulint d = 0; d < dict.size(); ++d)
+        {
+            min_occ[d] = max_occ[d] = occ[occ_begin[d]];
+            for (ulint x = occ_begin[d]; x < occ_begin[d+1]; ++x)
+            {
+                if (key(occ[x]) < key(min_occ[d])) min_occ[d] = occ[x];
+                if (key(occ[x]) > key(max_occ[d])) max_occ[d] = occ[x];
+            }
+        }
+    }
+
+    /*
+     * order of the suffixes following phrase k. nothing follows the last
+     * phrase but the trailing padding, which is the smallest suffix
+     */
+    ulint key(ulint k)
+    {
+        return k + 1 < parse.size() ? isa_parse[k+1] + 1 : 0;
+    }
+
+    int compare_alpha(range_t const& a, range_t const& b)
+    {
+        return dict[a.first].compare(a.second, std::string::npos, dict[b.first], b.second, std::string::npos);
+    }
+
+    std::string const& input;
+    std::vector<uchar> const& remap;
+    bool reversed;
+
+    // text length
+    ulint n;
+
+    // length of the trigger windows
+    ulint w;
+
+    // distinct phrases in lexicographic order
+    std::vector<std::string> dict;
+
+    // parse (phrase ranks) and starting positions of the phrases in Y
+    std::vector<ulint> parse;
+    std::vector<ulint> starts;
+
+    // inverse suffix array of the parse
+    std::vector<ulint> isa_parse;
+
+    // occurrences of phrase d are occ[occ_begin[d]...occ_begin[d+1]-1]
+    std::vector<ulint> occ_begin;
+    std::vector<ulint> occ;
+    std::vector<ulint> min_occ;
+    std::vector<ulint> max_occ;
+
+};
+
+};
+
+#endif /* INCLUDED_PREFIX_FREE_PARSE_HPP */
@@ -0,0 +1,287 @@
+/*
+ * query_stats: per-query statistics of the query tools (bri-locate,
+ * bri-count, bri-seedex)
+ *
+ *  the operations of the index (rank/select on the BWTs, LF, Phi, PLCP
+ *  lookups, DFS nodes, result inserts) are counted per thread when
+ *  compiled with BRI_OP_COUNTERS (cmake -DBRI_OP_COUNTERS=ON); otherwise
+ *  BRI_COUNT expands to nothing and the counters stay 0.
+ *
+ *  latency_histogram records latencies in buckets of bounded relative error
+ *  (HDR-style: 64 linear sub-buckets per power of two, values up to 127
+ *  exact), so that tail percentiles of millions of queries are kept in a
+ *  few KB. slowest_queries keeps the slowest queries with the work done by
+ *  their search, to find the reads that blow up the mismatch DFS.
+ */
+
+#ifndef INCLUDED_QUERY_STATS_HPP
+#define INCLUDED_QUERY_STATS_HPP
+
+#include <queue>
+
+#include "definitions.hpp"
+
+#ifdef BRI_OP_COUNTERS
+#define BRI_COUNT(op) (::bri::query_stats::local().op++)
+#else
+#define BRI_COUNT(op) ((void)0)
+#endif
+
+namespace bri {
+
+/*
+ * operations done by the queries of this thread since the last reset
+ */
+struct query_stats {
+
+    // rle_string::rank and rle_string::select, on BWT or BWT^R
+    ulint rank_calls = 0;
+    ulint select_calls = 0;
+
+    // LF and LFR steps, on a range or a position
+    ulint lf_calls = 0;
+
+    // Phi and PhiI steps
+    ulint phi_calls = 0;
+
+    // permuted_lcp::operator[]
+    ulint plcp_lookups = 0;
+
+    // calls of backward_dfs and forward_dfs, and branches of the mismatch
+    // search ending on an empty range
+    ulint dfs_nodes = 0;
+    ulint dfs_pruned = 0;
+
+    // samples inserted in the result of search_with_mismatch
+    ulint hash_inserts = 0;
+
+#ifdef BRI_OP_COUNTERS
+    static const bool enabled = true;
+#else
+    static const bool enabled = false;
+#endif
+
+    void reset() { *this = query_stats(); }
+
+    query_stats& operator+=(query_stats const& o)
+    {
+        rank_calls += o.rank_calls;
+        select_calls += o.select_calls;
+        lf_calls += o.lf_calls;
+        phi_calls += o.phi_calls;
+        plcp_lookups += o.plcp_lookups;
+        dfs_nodes += o.dfs_nodes;
+        dfs_pruned += o.dfs_pruned;
+        hash_inserts += o.hash_inserts;
+        return *this;
+    }
+
+    /*
+     * the counters of the calling thread
+     */
+    static query_stats& local()
+    {
+        static thread_local query_stats stats;
+        return stats;
+    }
+
+    /*
+     * operations done by the calling thread in f()
+     */
+    template<class F>
+    static query_stats counted(F f)
+    {
+        query_stats before = local();
+        f();
+        query_stats res = local();
+        res.subtract(before);
+        return res;
+    }
+
+private:
+
+    void subtract(query_stats const& o)
+    {
+        rank_calls -= o.rank_calls;
+        select_calls -= o.select_calls;
+        lf_calls -= o.lf_calls;
+        phi_calls -= o.phi_calls;
+        plcp_lookups -= o.plcp_lookups;
+        dfs_nodes -= o.dfs_nodes;
+        dfs_pruned -= o.dfs_pruned;
+        hash_inserts -= o.hash_inserts;
+    }
+
+};
+
+class latency_histogram {
+
+public:
+
+    void record(ulint value)
+    {
+        ulint b = bucket_of(value);
+        if (b >= buckets.size()) buckets.resize(b + 1, 0);
+        buckets[b]++;
+        n++;
+        max_value = std::max(max_value, value);
+    }
+
+    void merge(latency_histogram const& other)
+    {
+        if (other.buckets.size() > buckets.size()) buckets.resize(other.buckets.size(), 0);
+        for (ulint b = 0; b < other.buckets.size(); ++b) buckets[b] += other.buckets[b];
+        n += other.n;
+        max_value = std::max(max_value, other.max_value);
+    }
+
+    ulint count() const { return n; }
+
+    ulint max() const { return max_value; }
+
+    /*
+     * smallest recorded value v, up to the resolution of its bucket, such
+     * that p% of the values are at most v. 0 if nothing was recorded
+     */
+    ulint percentile(double p) const
+    {
+        if (n == 0) return 0;
+
+        ulint rank = (ulint)std::ceil(std::min(std::max(p, 0.0), 100.0) / 100 * n);
+        rank = std::max<ulint>(rank, 1);
+
+        ulint seen = 0;
+        for (ulint b = 0; b < buckets.size(); ++b)
+        {
+            seen += buckets[b];
+            if (seen >= rank) return std::min(highest_value(b), max_value);
+        }
+        return max_value;
+    }
+
+    /*
+     * one line: p50, p90, p99, p99.9 and max, the values being nanoseconds
+     * printed as microseconds. what: the unit of the count of values
+     */
+    void print(std::ostream& out, std::string const& name, std::string const& what = "patterns") const
+    {
+        auto us = [](ulint ns) { return ns / 1000.0; };
+
+        out << name << ": p50 " << us(percentile(50)) << "  p90 " << us(percentile(90))
+            << "  p99 " << us(percentile(99)) << "  p99.9 " << us(percentile(99.9))
+            << "  max " << us(max()) << " microseconds (" << n << " " << what << ")" << std::endl;
+    }
+
+    // values up to 2^SUB_BITS-1 have a bucket each
+    static const ulint SUB_BITS = 7;
+
+    static ulint bucket_of(ulint value)
+    {
+        if (value < (1ULL << SUB_BITS)) return value;
+
+        ulint shift = (63 - __builtin_clzll(value)) - (SUB_BITS - 1);
+        ulint half = 1ULL << (SUB_BITS - 1);
+        return (1ULL << SUB_BITS) + (shift - 1) * half + ((value >> shift) - half);
+    }
+
+    // largest value of bucket b
+    static ulint highest_value(ulint b)
+    {
+        if (b < (1ULL << SUB_BITS)) return b;
+
+        ulint half = 1ULL << (SUB_BITS - 1);
+        b -= 1ULL << SUB_BITS;
+        ulint shift = b / half + 1;
+        ulint mantissa = b % half + half;
+        return ((mantissa + 1) << shift) - 1;
+    }
+
+private:
+
+    std::vector<ulint> buckets;
+    ulint n = 0;
+    ulint max_value = 0;
+
+};
+
+/*
+ * the k slowest queries seen, by search plus locate time
+ */
+class slowest_queries {
+
+public:
+
+    struct query {
+        std::string id;
+        char strand;
+        ulint search_ns;
+        ulint locate_ns;
+        ulint occs;
+        query_stats stats;
+
+        ulint total() const { return search_ns + locate_ns; }
+    };
+
+    slowest_queries(ulint k = 0) : k(k) {}
+
+    void push(std::string const& id, char strand, ulint search_ns, ulint locate_ns, ulint occs, query_stats const& stats)
+    {
+        if (k == 0) return;
+        if (heap.size() == k && search_ns + locate_ns <= heap.top().total()) return;
+
+        // the id up to the first whitespace
+        heap.push({id.substr(0, id.find_first_of(" \t")), strand, search_ns, locate_ns, occs, stats});
+        if (heap.size() > k) heap.pop();
+    }
+
+    /*
+     * the queries kept, slowest first
+     */
+    std::vector<query> sorted() const
+    {
+        auto h = heap;
+        std::vector<query> res;
+        for (; !h.empty(); h.pop()) res.push_back(h.top());
+        std::reverse(res.begin(), res.end());
+        return res;
+    }
+
+    void print(std::ostream& out) const
+    {
+        if (k == 0) return;
+
+        out << std::endl << "Slowest " << heap.size() << " patterns:" << std::endl;
+        if (!query_stats::enabled)
+            out << "(operations not counted: build with -DBRI_OP_COUNTERS=ON)" << std::endl;
+
+        out << "read\tstrand\tsearch_us\tlocate_us\tocc";
+        if (query_stats::enabled) out << "\tdfs_nodes\tdfs_pruned\tLF\tPhi\tplcp\trank\tselect\tinserts";
+        out << std::endl;
+
+        for (auto& q: sorted())
+        {
+            out << q.id << '\t' << q.strand << '\t' << q.search_ns / 1000.0 << '\t' << q.locate_ns / 1000.0 << '\t' << q.occs;
+            if (query_stats::enabled)
+                out << '\t' << q.stats.dfs_nodes << '\t' << q.stats.dfs_pruned << '\t' << q.stats.lf_calls << '\t'
+                    << q.stats.phi_calls << '\t' << q.stats.plcp_lookups << '\t' << q.stats.rank_calls << '\t'
+                    << q.stats.select_calls << '\t' << q.stats.hash_inserts;
+            out << std::endl;
+        }
+    }
+
+private:
+
+    struct faster {
+        bool operator()(query const& a, query const& b) const { return a.total() > b.total(); }
+    };
+
+    ulint k;
+
+    // the fastest kept query on top
+    std::priority_queue<query, std::vector<query>, faster> heap;
+
+};
+
+};
+
+#endif /* INCLUDED_QUERY_STATS_HPP */
@@ -0,0 +1,175 @@
+/*
+ * query_trace: compact binary trace of the queries run by bri-locate,
+ * bri-count and bri-seedex (-trace), re-executed by bri-replay
+ *
+ *  the file starts with the magic "BRITRACE" and a version byte, followed
+ *  by a record per query:
+ *      op (1 byte), then as LEB128 varints: mismatches, seed bounds m1 and
+ *      m2, size of the result, start and latency in nanoseconds, length of
+ *      the pattern; then the pattern.
+ *  start is the time since the first query of the trace, so that the
+ *  traffic can be replayed at its original pace.
+ */
+
+#ifndef INCLUDED_QUERY_TRACE_HPP
+#define INCLUDED_QUERY_TRACE_HPP
+
+#include <stdexcept>
+
+#include "definitions.hpp"
+
+namespace bri {
+
+struct trace_record {
+
+    enum op_t : uchar {
+        COUNT = 'c',        // count occurrences (bri-count)
+        LOCATE = 'l',       // locate occurrences (bri-locate)
+        DOCUMENTS = 'd',    // list documents (bri-locate -d)
+        SEED_EXTEND = 's'   // exact core [m1,m2), then extension (bri-seedex)
+    };
+
+    op_t op = LOCATE;
+    ulint mismatches = 0;
+    ulint m1 = 0;
+    ulint m2 = 0;
+
+    // observed number of occurrences (of documents for DOCUMENTS)
+    ulint occ = 0;
+
+    ulint start_ns = 0;
+    ulint latency_ns = 0;
+
+    std::string pattern;
+
+    static bool valid_op(uchar op)
+    {
+        return op == COUNT || op == LOCATE || op == DOCUMENTS || op == SEED_EXTEND;
+    }
+
+};
+
+class query_trace_writer {
+
+public:
+
+    query_trace_writer(std::string const& file) : out(file, std::ios::binary)
+    {
+        if (!out) throw std::runtime_error("cannot write query trace " + file);
+        out.write(MAGIC, 8);
+        out.put((char)VERSION);
+    }
+
+    void write(trace_record const& r)
+    {
+        out.put((char)r.op);
+        put(r.mismatches);
+        put(r.m1);
+        put(r.m2);
+        put(r.occ);
+        put(r.start_ns);
+        put(r.latency_ns);
+        put(r.pattern.size());
+        out.write(r.pattern.data(), r.pattern.size());
+    }
+
+    static constexpr char const* MAGIC = "BRITRACE";
+    static const uchar VERSION = 1;
+
+private:
+
+    void put(ulint v)
+    {
+        while (v >= 0x80)
+        {
+            out.put((char)(v | 0x80));
+            v >>= 7;
+        }
+        out.put((char)v);
+    }
+
+    std::ofstream out;
+
+};
+
+class query_trace_reader {
+
+public:
+
+    query_trace_reader(std::string const& file) : in(file, std::ios::binary), file(file)
+    {
+        if (!in) throw std::runtime_error("cannot open query trace " + file);
+
+        char header[9];
+        in.read(header, 9);
+        if (in.gcount() != 9 || std::string(header, 8) != query_trace_writer::MAGIC)
+            throw std::runtime_error(file + " is not a query trace");
+        if ((uchar)header[8] != query_trace_writer::VERSION)
+            throw std::runtime_error("unsupported version of query trace " + file);
+    }
+
+    /*
+     * reads the next record into r. false at the end of the trace
+     */
+    bool next(trace_record& r)
+    {
+        int op = in.get();
+        if (op == EOF) return false;
+        if (!trace_record::valid_op(op)) throw malformed();
+
+        r.op = (trace_record::op_t)op;
+        r.mismatches = get();
+        r.m1 = get();
+        r.m2 = get();
+        r.occ = get();
+        r.start_ns = get();
+        r.latency_ns = get();
+
+        ulint len = get();
+        r.pattern.resize(len);
+        in.read(&r.pattern[0], len);
+        if ((ulint)in.gcount() != len) throw malformed();
+
+        return true;
+    }
+
+    /*
+     * all the records of the trace
+     */
+    static std::vector<trace_record> read_all(std::string const& file)
+    {
+        query_trace_reader reader(file);
+        std::vector<trace_record> res;
+        trace_record r;
+        while (reader.next(r)) res.push_back(r);
+        return res;
+    }
+
+private:
+
+    ulint get()
+    {
+        ulint v = 0;
+        for (ulint shift = 0; shift < 64; shift += 7)
+        {
+            int b = in.get();
+            if (b == EOF) throw malformed();
+            v |= (ulint)(b & 0x7f) << shift;
+            if ((b & 0x80) == 0) return v;
+        }
+        throw malformed();
+    }
+
+    std::runtime_error malformed() const
+    {
+        return std::runtime_error("truncated or malformed query trace " + file);
+    }
+
+    std::ifstream in;
+    std::string file;
+
+};
+
+};
+
+#endif /* INCLUDED_QUERY_TRACE_HPP */
@@ -0,0 +1,210 @@
+/*
+ * read_cache: results of the reads already searched by bri-locate (-cache),
+ * so that duplicated reads are searched and located once
+ *
+ *  a read over ACGT and its reverse complement share an entry, keyed by the
+ *  smaller of the two; the results of both strands of the key are kept, and
+ *  swapped for a read that is the reverse complement of its key. entries
+ *  are spread by hash over shards, each with its own mutex and least
+ *  recently used list, and the least recently used entries of a shard are
+ *  evicted when its entries exceed its share of the budget. results larger
+ *  than a quarter of a shard are never kept.
+ */
+
+#ifndef INCLUDED_READ_CACHE_HPP
+#define INCLUDED_READ_CACHE_HPP
+
+#include <list>
+#include <mutex>
+
+#include "definitions.hpp"
+
+namespace bri {
+
+/*
+ * results of a read, forward strand first
+ */
+struct cached_read {
+
+    // occurrences, or documents with bri-locate -d
+    std::vector<ulint> values[2];
+
+    // number of occurrences
+    ulint occ[2] = {0, 0};
+
+};
+
+class read_cache {
+
+public:
+
+    /*
+     * \param budget: bytes of all the entries, keys included
+     */
+    read_cache(ulint budget, ulint n_shards = 16) : shards(n_shards), shard_budget(budget / n_shards) {}
+
+    /*
+     * the results of read, if cached. rc: its reverse complement
+     */
+    bool find(std::string const& read, std::string const& rc, cached_read& res)
+    {
+        bool reversed;
+        std::string const& key = key_of(read, rc, reversed);
+
+        auto& s = shard_of(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        auto it = s.index.find(key);
+        if (it == s.index.end())
+        {
+            s.misses++;
+            return false;
+        }
+
+        // most recently used first
+        s.lru.splice(s.lru.begin(), s.lru, it->second);
+        s.hits++;
+
+        res = it->second->value;
+        if (reversed) swap_strands(res);
+        return true;
+    }
+
+    /*
+     * keeps the results of read, evicting the least recently used entries
+     * of its shard if needed
+     */
+    void insert(std::string const& read, std::string const& rc, cached_read const& value)
+    {
+        bool reversed;
+        std::string const& key = key_of(read, rc, reversed);
+
+        ulint bytes = entry_bytes(key, value);
+        auto& s = shard_of(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        if (bytes > shard_budget / 4)
+        {
+            s.too_large++;
+            return;
+        }
+        if (s.index.count(key) > 0) return;
+
+        s.lru.push_front({key, value});
+        if (reversed) swap_strands(s.lru.front().value);
+        s.index[key] = s.lru.begin();
+        s.bytes += bytes;
+
+        while (s.bytes > shard_budget)
+        {
+            auto& last = s.lru.back();
+            s.bytes -= entry_bytes(last.key, last.value);
+            s.index.erase(last.key);
+            s.lru.pop_back();
+            s.evictions++;
+        }
+    }
+
+    ulint hits() const { return sum(&shard::hits); }
+
+    ulint misses() const { return sum(&shard::misses); }
+
+    ulint evictions() const { return sum(&shard::evictions); }
+
+    // results not kept for their size
+    ulint too_large() const { return sum(&shard::too_large); }
+
+    ulint bytes() const { return sum(&shard::bytes); }
+
+    ulint entries() const
+    {
+        ulint res = 0;
+        for (auto& s: shards)
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            res += s.lru.size();
+        }
+        return res;
+    }
+
+    void print(std::ostream& out) const
+    {
+        ulint h = hits();
+        ulint lookups = h + misses();
+
+        out << "Read cache: " << h << " of " << lookups << " reads found (" << (lookups ? 100.0 * h / lookups : 0)
+            << "% hit rate), " << entries() << " entries in " << bytes() << " bytes, " << evictions()
+            << " evicted, " << too_large() << " too large to keep" << std::endl;
+    }
+
+    /*
+     * the key of read: the read, or rc if it is smaller and the read is
+     * over ACGT (reversed is then true)
+     */
+    static std::string const& key_of(std::string const& read, std::string const& rc, bool& reversed)
+    {
+        reversed = rc < read && read.find_first_not_of("ACGT") == std::string::npos;
+        return reversed ? rc : read;
+    }
+
+private:
+
+    struct node {
+        std::string key;
+        cached_read value;
+    };
+
+    struct shard {
+        mutable std::mutex mutex;
+        std::list<node> lru;
+        std::unordered_map<std::string, std::list<node>::iterator> index;
+        ulint bytes = 0;
+        ulint hits = 0;
+        ulint misses = 0;
+        ulint evictions = 0;
+        ulint too_large = 0;
+    };
+
+    /*
+     * approximate heap bytes of an entry: the key twice (list and index),
+     * the results, and the nodes of the list and of the index
+     */
+    static ulint entry_bytes(std::string const& key, cached_read const& value)
+    {
+        return 2 * key.size() + (value.values[0].size() + value.values[1].size()) * sizeof(ulint)
+               + sizeof(node) + 4 * sizeof(void*) + sizeof(std::string);
+    }
+
+    static void swap_strands(cached_read& v)
+    {
+        std::swap(v.values[0], v.values[1]);
+        std::swap(v.occ[0], v.occ[1]);
+    }
+
+    shard& shard_of(std::string const& key)
+    {
+        // the high bits of the product: the buckets of the index of the
+        // shard are chosen by the low bits of the hash
+        ulint h = std::hash<std::string>()(key) * 0x9E3779B97F4A7C15ULL;
+        return shards[(h >> 32) % shards.size()];
+    }
+
+    ulint sum(ulint shard::* field) const
+    {
+        ulint res = 0;
+        for (auto& s: shards)
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            res += s.*field;
+        }
+        return res;
+    }
+
+    std::vector<shard> shards;
+    ulint shard_budget;
+
+};
+
+};
+
+#endif /* INCLUDED_READ_CACHE_HPP */
@@ -24,83 +24,121 @@
 #include "definitions.hpp"
 #include "huffman_string.hpp"
 #include "sparse_sd_vector.hpp"
+#include "query_stats.hpp"
 
 namespace bri {
 
-template<
-    class sparse_bitvector_t = sparse_sd_vector,
-    class string_t = huffman_string
->
-class rle_string {
+template<class sparse_bitvector_t, class string_t> class rle_string;
+
+/*
+ * rle_string_builder: run-length encodes a string given run by run (or
+ * character by character), keeping only O(r) data. rle_string is then
+ * built from it without the string ever being materialized.
+ */
+class rle_string_builder {
 
 public:
-    rle_string() {}
 
     /*
-     * constructor
-     * \param input the input string
-     * \param B block size
+     * \param B block size of the rle_string to build
      */
-    rle_string(std::string& input, ulint B = 2)
+    rle_string_builder(ulint B = 2) : B(B), letter_count(256,0), runs_per_letter_ones(256) {}
+
+    /*
+     * append len copies of c
+     */
+    void push(uchar c, ulint len = 1)
     {
-        assert(!contains0(input));
+        assert(c != 0);
+        assert(!finished);
 
-        this->B = B;
-        n = input.size();
-        r = 0;
+        if (len == 0) return;
 
-        auto runs_per_letter_bv = std::vector<std::vector<bool> >(256);
+        if (n == 0 || c != last_c)
+        {
+            if (n > 0) close_run(false);
+            last_c = c;
+            run_start = n;
+        }
+        n += len;
+    }
 
-        std::vector<bool> runs_bv;
-        std::string run_heads_s;
+    ulint size() { return n; }
 
-        uchar last_c = input[0];
+private:
 
-        for (ulint i = 1; i < input.size(); ++i)
-        {
-            if (uchar(input[i]) != last_c)
-            {
-                run_heads_s.push_back(last_c);
-                runs_per_letter_bv[last_c].push_back(true);
+    template<class, class> friend class rle_string;
 
-                last_c = input[i];
+    /*
+     * the run of last_c ending at n-1 is complete
+     */
+    void close_run(bool last)
+    {
+        // bit set only at the end of a block
+        if (!last && run_heads_s.size()%B == B-1) runs_ones.push_back(n-1);
 
-                // push back a bit set only at the end of a block
-                runs_bv.push_back(r%B == B-1);
+        run_heads_s.push_back(last_c);
 
-                r++;
+        letter_count[last_c] += n - run_start;
+        runs_per_letter_ones[last_c].push_back(letter_count[last_c] - 1);
+    }
 
-            } else {
+    void finish()
+    {
+        if (n > 0 && !finished) close_run(true);
+        finished = true;
+    }
 
-                runs_bv.push_back(false);
-                runs_per_letter_bv[last_c].push_back(false);
+    ulint B;
+    ulint n = 0;
 
-            }
-        }
+    // current run
+    uchar last_c = 0;
+    ulint run_start = 0;
+    bool finished = false;
 
-        run_heads_s.push_back(last_c);
-        runs_per_letter_bv[last_c].push_back(true);
-        runs_bv.push_back(false);
-        r++;
+    std::string run_heads_s;
 
-        assert(run_heads_s.size()==r);
-        assert(r==count_runs(input));
-        assert(runs_bv.size()==input.size());
+    // positions of the 1-bits of runs and of runs_per_letter, which
+    // has one bit per occurrence of its letter
+    std::vector<ulint> runs_ones;
+    std::vector<ulint> letter_count;
+    std::vector<std::vector<ulint> > runs_per_letter_ones;
 
-        ulint t = 0;
-        for (ulint i = 0; i < 256; ++i) t += runs_per_letter_bv[i].size();
-        assert(t == input.size());
+};
 
-        runs = sparse_bitvector_t(runs_bv);
+template<
+    class sparse_bitvector_t = sparse_sd_vector,
+    class string_t = huffman_string
+>
+class rle_string {
 
-        runs_per_letter = std::vector<sparse_bitvector_t>(256);
-        for (ulint i = 0; i < 256; ++i)
-            runs_per_letter[i] = sparse_bitvector_t(runs_per_letter_bv[i]);
+public:
+    rle_string() {}
 
-        run_heads = string_t(run_heads_s);
+    /*
+     * constructor
+     * \param input the input string
+     * \param B block size
+     */
+    rle_string(std::string& input, ulint B = 2)
+    {
+        assert(!contains0(input));
 
-        assert(run_heads.size() == r);
+        rle_string_builder builder(B);
+        for (auto c: input) builder.push((uchar)c);
 
+        build(builder);
+
+        assert(r==count_runs(input));
+    }
+
+    /*
+     * constructor from the runs pushed to a builder
+     */
+    rle_string(rle_string_builder& builder)
+    {
+        build(builder);
     }
 
     uchar operator[](size_t i)
@@ -114,6 +152,7 @@ public:
      */
     size_t select(ulint i, uchar c)
     {
+        BRI_COUNT(select_calls);
         assert(i<runs_per_letter[c].size());
 
         // i-th c is inside j-th c-run
@@ -144,6 +183,7 @@ public:
     ulint rank(size_t i, uchar c)
     {
 
+        BRI_COUNT(rank_calls);
         assert(i <= n);
 
         // c does not exist
@@ -188,6 +228,49 @@ public:
 
     }
 
+    /*
+     * the distinct characters of S[i...j-1] with their ranks at i and at j,
+     * returns their number (all-symbol rank, e.g. for LF on a range and
+     * every character at once). the runs of i and j are located once, and
+     * the characters come from the run heads of the runs overlapping
+     * [i,j), by a single traversal of their wavelet tree, instead of a
+     * rank pair per letter of the alphabet. in no particular order.
+     */
+    ulint interval_symbols(ulint i, ulint j, std::vector<uchar>& cs, std::vector<ulint>& rank_i, std::vector<ulint>& rank_j)
+    {
+        BRI_COUNT(rank_calls);
+        assert(i <= j && j <= n);
+        if (i == j) return 0;
+
+        ulint dist_i, dist_j = 0;
+        ulint run_i = locate_run(i, dist_i);
+
+        // first run after the interval
+        ulint run_j = r;
+        if (j < n)
+        {
+            run_j = locate_run(j, dist_j);
+            if (dist_j > 0) run_j++;
+        }
+
+        ulint k = run_heads.interval_symbols(run_i, run_j, cs, rank_i, rank_j);
+
+        uchar head_i = run_heads[run_i];
+        uchar head_j = dist_j > 0 ? run_heads[run_j-1] : 0;
+
+        // ranks of c among the run heads, turned into ranks in the string
+        // as in rank()
+        for (ulint t = 0; t < k; ++t)
+        {
+            uchar c = cs[t];
+            ulint in_j = dist_j > 0 && head_j == c;
+
+            rank_j[t] = runs_before(c, rank_j[t] - in_j) + in_j * dist_j;
+            rank_i[t] = runs_before(c, rank_i[t]) + (head_i == c) * dist_i;
+        }
+        return k;
+    }
+
     /*
      * run number of text position i
      */
@@ -306,6 +389,15 @@ public:
 
     ulint number_of_runs() { return r; }
 
+    /*
+     * character of j-th run
+     */
+    uchar run_head(ulint j)
+    {
+        assert(j < r);
+        return run_heads[j];
+    }
+
     ulint serialize(std::ostream& out)
     {
 
@@ -362,48 +454,41 @@ public:
 
     }
 
-    ulint print_space()
+    /*
+     * n, r and B, the bitvector of the runs, the bitvectors of the runs of
+     * each letter (summed over the letters), and the run heads
+     */
+    space_node space_tree(std::string const& name = "rle_string") const
     {
+        space_node res(name, sizeof(n) + sizeof(r) + sizeof(B));
+        if (n == 0) return res;
 
-        ulint tot_bytes = 0;
+        res.add(runs.space_tree("runs"));
 
-        std::cout << "space for run-length encoded string:" << std::endl;
+        space_node per_letter("runs_per_letter");
+        for (auto& bv: runs_per_letter) per_letter.merge(bv.space_tree());
+        res.add(per_letter);
 
-        std::ofstream out("/dev/null");
-        auto bytesize = runs.serialize(out);
-        tot_bytes += bytesize;
-        std::cout << "- bitvector runs: " << bytesize << " bytes" << std::endl;
+        res.add(run_heads.space_tree("run_heads"));
 
-        bytesize = 0;
-        for (auto r: runs_per_letter) bytesize += r.serialize(out);
-        tot_bytes += bytesize;
-        std::cout << "- bitvectors runs-per-letter: " << bytesize << " bytes" << std::endl;
-
-        bytesize = run_heads.serialize(out);
-        tot_bytes += bytesize;
-        std::cout << "- run heads: " << bytesize << " bytes" << std::endl;
+        return res;
+    }
 
-        return tot_bytes;
+    ulint size_in_bytes() const
+    {
+        return space_tree().bytes;
+    }
 
+    ulint print_space()
+    {
+        auto space = space_tree("run-length encoded string");
+        space.print(std::cout);
+        return space.bytes;
     }
 
     ulint get_space()
     {
-        ulint tot_bytes = 0;
-
-        std::ofstream out("/dev/null");
-        auto bytesize = runs.serialize(out);
-        tot_bytes += bytesize;
-
-        bytesize = 0;
-        for (auto r: runs_per_letter) bytesize += r.serialize(out);
-        tot_bytes += bytesize;
-
-        bytesize = run_heads.serialize(out);
-        tot_bytes += bytesize;
-
-        return tot_bytes;
-
+        return size_in_bytes();
     }
 
     // <j(run number of position i), p(last position of j-th run)>
@@ -441,6 +526,49 @@ public:
 
 private:
 
+    /*
+     * run containing position i < n, and the offset dist of i in it
+     */
+    ulint locate_run(ulint i, ulint& dist)
+    {
+        auto run = run_of(i);
+        dist = i - (run.second + 1 - run_at(run.first));
+        return run.first;
+    }
+
+    /*
+     * number of c in the first k c-runs
+     */
+    ulint runs_before(uchar c, ulint k)
+    {
+        return k == 0 ? 0 : runs_per_letter[c].select(k-1) + 1;
+    }
+
+    void build(rle_string_builder& builder)
+    {
+        builder.finish();
+
+        B = builder.B;
+        n = builder.n;
+        r = builder.run_heads_s.size();
+
+        ulint t = 0;
+        for (ulint i = 0; i < 256; ++i) t += builder.letter_count[i];
+        assert(t == n);
+
+        runs = sparse_bitvector_t(builder.runs_ones,n);
+
+        runs_per_letter = std::vector<sparse_bitvector_t>(256);
+        for (ulint i = 0; i < 256; ++i)
+            runs_per_letter[i] = sparse_bitvector_t(builder.runs_per_letter_ones[i],builder.letter_count[i]);
+
+        // string_t may modify its input, and builder can be built again
+        std::string heads = builder.run_heads_s;
+        run_heads = string_t(heads);
+
+        assert(run_heads.size() == r);
+    }
+
     // static member func to count the number of runs in s
     static ulint count_runs(std::string& s)
     {
@@ -0,0 +1,249 @@
+/*
+ * sequence_boundaries: start positions and names of the sequences
+ * concatenated in the text (FASTA mode of bri-build)
+ *
+ *  starts are stored as an Elias-Fano bitvector over the text positions,
+ *  so that the sequence of a text position is a predecessor query.
+ */
+
+#ifndef INCLUDED_SEQUENCE_BOUNDARIES_HPP
+#define INCLUDED_SEQUENCE_BOUNDARIES_HPP
+
+#include <stdexcept>
+
+#include "definitions.hpp"
+#include "sparse_sd_vector.hpp"
+
+namespace bri {
+
+// separator inserted between consecutive sequences of the text
+static const uchar SEQUENCE_SEPARATOR = '#';
+
+template<class sparse_bitvector_t = sparse_sd_vector>
+class sequence_boundaries {
+
+public:
+
+    sequence_boundaries() {}
+
+    /*
+     * constructor.
+     * \param starts: increasing start positions of the sequences in the text
+     * \param names: names of the sequences
+     * \param n: text length
+     */
+    sequence_boundaries(std::vector<ulint> const& starts, std::vector<std::string> const& names, ulint n)
+    {
+        assert(starts.size() == names.size());
+
+        assert(std::is_sorted(starts.begin(), starts.end()));
+        assert(starts.empty() || starts.back() < n);
+        this->starts = sparse_bitvector_t(starts,n);
+
+        this->names = names;
+    }
+
+    /*
+     * turn the FASTA content of s into the text to be indexed, in place:
+     * header lines and line breaks are removed and sequences are separated
+     * by SEQUENCE_SEPARATOR. start positions and names (up to the first
+     * whitespace of the header) are appended to starts and names. empty
+     * sequences are rejected, since their start would be the separator of
+     * the next sequence, or the end of the text.
+     */
+    static void parse_fasta(std::string& s, std::vector<ulint>& starts, std::vector<std::string>& names)
+    {
+        // a header line is longer than the separator replacing it,
+        // so the write position never overtakes the read position
+        ulint w = 0;
+        ulint i = 0;
+
+        while (i < s.size())
+        {
+            if (s[i] == '>')
+            {
+                ulint eol = s.find('\n', i);
+                if (eol == std::string::npos) eol = s.size();
+
+                ulint end_name = s.find_first_of(" \t\r\n", i + 1);
+                if (end_name == std::string::npos || end_name > eol) end_name = eol;
+
+                if (!starts.empty())
+                {
+                    check_not_empty(starts, names, w);
+                    s[w++] = SEQUENCE_SEPARATOR;
+                }
+
+                starts.push_back(w);
+                names.push_back(s.substr(i + 1, end_name - i - 1));
+
+                i = eol + 1;
+            }
+            else if (s[i] == '\n' || s[i] == '\r')
+            {
+                i++;
+            }
+            else
+            {
+                if (starts.empty())
+                    throw std::runtime_error("input doesn't appear to be in FASTA format");
+
+                if ((uchar)s[i] == SEQUENCE_SEPARATOR)
+                    throw std::runtime_error("FASTA sequence " + names.back() + " contains the separator symbol");
+
+                s[w++] = s[i++];
+            }
+        }
+
+        if (starts.empty())
+            throw std::runtime_error("input doesn't appear to be in FASTA format");
+        check_not_empty(starts, names, w);
+
+        s.resize(w);
+    }
+
+    /*
+     * number of sequences (0 if the text was not built from FASTA)
+     */
+    ulint size() const { return names.size(); }
+
+    /*
+     * id of the sequence containing text position i
+     */
+    ulint sequence_of(ulint i)
+    {
+        assert(size() > 0);
+        return starts.rank(i+1) - 1;
+    }
+
+    /*
+     * (sequence id, offset in the sequence) of text position i
+     */
+    std::pair<ulint,ulint> to_sequence_position(ulint i)
+    {
+        if (size() == 0) return {0,i};
+
+        ulint id = sequence_of(i);
+        return {id, i - starts.select(id)};
+    }
+
+    /*
+     * starting text position of sequence id
+     */
+    ulint start(ulint id)
+    {
+        assert(id < size());
+        return starts.select(id);
+    }
+
+    std::string const& name(ulint id)
+    {
+        assert(id < size());
+        return names[id];
+    }
+
+    ulint serialize(std::ostream& out)
+    {
+        ulint w_bytes = 0;
+
+        ulint k = names.size();
+        out.write((char*)&k,sizeof(k));
+        w_bytes += sizeof(k);
+
+        if (k == 0) return w_bytes;
+
+        w_bytes += starts.serialize(out);
+
+        for (auto& name: names)
+        {
+            ulint len = name.size();
+            out.write((char*)&len,sizeof(len));
+            out.write(name.data(),len);
+            w_bytes += sizeof(len) + len;
+        }
+
+        return w_bytes;
+    }
+
+    /*
+     * indexes built before FASTA mode end before this structure,
+     * in which case no sequence is loaded
+     */
+    void load(std::istream& in)
+    {
+        ulint k = 0;
+        in.read((char*)&k,sizeof(k));
+        if (!in || k == 0)
+        {
+            in.clear();
+            return;
+        }
+
+        starts.load(in);
+
+        names = std::vector<std::string>(k);
+        for (ulint i = 0; i < k; ++i)
+        {
+            ulint len = 0;
+            in.read((char*)&len,sizeof(len));
+            names[i].resize(len);
+            in.read(&names[i][0],len);
+        }
+    }
+
+    /*
+     * number of sequences, bitvector of the starts, names with their
+     * lengths
+     */
+    space_node space_tree(std::string const& name = "sequences") const
+    {
+        space_node res(name, sizeof(ulint));
+        if (names.size() == 0) return res;
+
+        res.add(starts.space_tree("starts"));
+
+        ulint bytes = 0;
+        for (auto& s: names) bytes += sizeof(ulint) + s.size();
+        res.add(space_node("names", bytes));
+
+        return res;
+    }
+
+    ulint size_in_bytes() const
+    {
+        return space_tree().bytes;
+    }
+
+    ulint print_space()
+    {
+        auto space = space_tree();
+        space.print(std::cout);
+        return space.bytes;
+    }
+
+    ulint get_space()
+    {
+        return size_in_bytes();
+    }
+
+private:
+
+    /*
+     * throws if the last sequence of starts ends at w without a character
+     */
+    static void check_not_empty(std::vector<ulint> const& starts, std::vector<std::string> const& names, ulint w)
+    {
+        if (w == starts.back())
+            throw std::runtime_error("FASTA sequence " + names.back() + " is empty");
+    }
+
+    // bit set at the first text position of each sequence
+    sparse_bitvector_t starts;
+
+    std::vector<std::string> names;
+
+};
+
+};
+
+#endif /* INCLUDED_SEQUENCE_BOUNDARIES_HPP */
@@ -0,0 +1,161 @@
+/*
+ * shard_manifest: layout of a text split into shards, each indexed by its
+ * own .bri file (bri-build -shards)
+ *
+ *  shard k owns the text positions [start, start + owned) and indexes them
+ *  followed by the next overlap characters of the text, so that every
+ *  occurrence of a pattern of length up to overlap + 1 starting at an owned
+ *  position lies within the shard. an occurrence starting in the overlap
+ *  belongs to the next shard.
+ *
+ *  the manifest is a text file (.brs):
+ *      br-index shards
+ *      text_length <n>
+ *      overlap <overlap>
+ *      shards <k>
+ *  followed by a line per shard: <start> <owned> <length> <file>, the file
+ *  being relative to the directory of the manifest.
+ */
+
+#ifndef INCLUDED_SHARD_MANIFEST_HPP
+#define INCLUDED_SHARD_MANIFEST_HPP
+
+#include <stdexcept>
+
+#include "definitions.hpp"
+
+namespace bri {
+
+struct shard_range {
+
+    // index file of the shard
+    std::string file;
+
+    // owned text positions [start, start + owned)
+    ulint start = 0;
+    ulint owned = 0;
+
+    // length of the text of the shard, owned positions and overlap
+    ulint length = 0;
+
+};
+
+class shard_manifest {
+
+public:
+
+    shard_manifest() {}
+
+    /*
+     * splits a text of length n into k shards of about n/k owned positions.
+     * \param basename: the file of shard i is basename.i.bri
+     */
+    shard_manifest(ulint n, ulint k, ulint overlap, std::string const& basename)
+        : text_length(n), overlap(overlap)
+    {
+        if (k == 0 || k > n) throw std::invalid_argument("the number of shards must be between 1 and the text length");
+
+        for (ulint i = 0; i < k; ++i)
+        {
+            shard_range s;
+            s.file = basename + "." + std::to_string(i) + ".bri";
+            s.start = n * i / k;
+            s.owned = n * (i + 1) / k - s.start;
+            s.length = std::min(s.owned + overlap, n - s.start);
+            shards.push_back(s);
+        }
+    }
+
+    /*
+     * shard owning text position i
+     */
+    ulint shard_of(ulint i) const
+    {
+        assert(i < text_length);
+        ulint k = std::upper_bound(shards.begin(), shards.end(), i,
+                                   [](ulint i, shard_range const& s) { return i < s.start; }) - shards.begin();
+        return k - 1;
+    }
+
+    /*
+     * longest pattern whose occurrences are all found within a shard
+     */
+    ulint max_pattern_length() const
+    {
+        return shards.size() > 1 ? overlap + 1 : text_length;
+    }
+
+    void save(std::string const& path) const
+    {
+        std::ofstream out(path);
+        if (!out) throw std::runtime_error("cannot write shard manifest " + path);
+
+        out << "br-index shards" << std::endl;
+        out << "text_length " << text_length << std::endl;
+        out << "overlap " << overlap << std::endl;
+        out << "shards " << shards.size() << std::endl;
+        for (auto& s: shards)
+            out << s.start << " " << s.owned << " " << s.length << " " << file_name(s.file) << std::endl;
+    }
+
+    /*
+     * loads the manifest, the files of the shards being resolved against
+     * its directory
+     */
+    void load(std::string const& path)
+    {
+        std::ifstream in(path);
+        if (!in) throw std::runtime_error("cannot open shard manifest " + path);
+
+        auto error = [&]() { return std::runtime_error("malformed shard manifest " + path); };
+
+        std::string line, key;
+        ulint k = 0;
+        if (!std::getline(in, line) || line != "br-index shards") throw error();
+        if (!(in >> key >> text_length) || key != "text_length") throw error();
+        if (!(in >> key >> overlap) || key != "overlap") throw error();
+        if (!(in >> key >> k) || key != "shards") throw error();
+
+        std::string dir = path.substr(0, path.size() - file_name(path).size());
+
+        shards.clear();
+        for (ulint i = 0; i < k; ++i)
+        {
+            shard_range s;
+            if (!(in >> s.start >> s.owned >> s.length)) throw error();
+            std::getline(in, s.file);
+            if (s.file.size() < 2 || s.file[0] != ' ') throw error();
+            s.file = dir + s.file.substr(1);
+
+            // shards cover the text in order
+            ulint expected = i > 0 ? shards.back().start + shards.back().owned : 0;
+            if (s.start != expected || s.length < s.owned || s.start + s.length > text_length) throw error();
+            shards.push_back(s);
+        }
+        if (shards.empty() || shards.back().start + shards.back().owned != text_length) throw error();
+    }
+
+    ulint size() const { return shards.size(); }
+
+    shard_range const& operator[](ulint i) const { return shards[i]; }
+
+    ulint text_length = 0;
+
+    // characters of the next shard indexed after the owned ones
+    ulint overlap = 0;
+
+    std::vector<shard_range> shards;
+
+private:
+
+    static std::string file_name(std::string const& path)
+    {
+        auto slash = path.find_last_of('/');
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+};
+
+};
+
+#endif /* INCLUDED_SHARD_MANIFEST_HPP */
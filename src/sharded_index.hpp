@@ -0,0 +1,455 @@
+/*
+ * sharded_index: scatter-gather queries over the shards of a text (see
+ * shard_manifest), for collections whose br-index does not fit in the RAM
+ * of one machine
+ *
+ *  a query is sent to every shard at once and each shard answers with its
+ *  own index: the count of the occurrences starting at its owned positions,
+ *  or all its occurrences. occurrences are mapped to text positions and
+ *  those in the overlap, owned by the next shard, are dropped.
+ *  shards are served by threads of this process (shard_thread) or by child
+ *  processes (shard_process) exchanging queries and results over pipes,
+ *  which stand in for shards on other machines.
+ */
+
+#ifndef INCLUDED_SHARDED_INDEX_HPP
+#define INCLUDED_SHARDED_INDEX_HPP
+
+#include <condition_variable>
+#include <csignal>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "definitions.hpp"
+#include "br_index.hpp"
+#include "shard_manifest.hpp"
+
+namespace bri {
+
+// occurrences of pattern with up to mismatches mismatched characters
+struct shard_query {
+
+    enum op_t : uchar { COUNT = 'c', LOCATE = 'l' };
+
+    op_t op = COUNT;
+    ulint mismatches = 0;
+    std::string pattern;
+
+};
+
+/*
+ * the index of a shard, answering queries
+ */
+template<class index_t>
+class shard_server {
+
+public:
+
+    /*
+     * \param owned: the positions after the owned ones are the overlap
+     */
+    shard_server(std::string const& file, ulint owned)
+    {
+        std::ifstream in(file);
+        if (!in) throw std::runtime_error("cannot open shard " + file);
+        idx.load(in);
+
+        assert(owned <= idx.text_size());
+
+        // the suffix of the terminator is the first one of the SA, and LF
+        // steps go back through the text from its end
+        ulint row = 0;
+        for (ulint i = owned; i < idx.text_size(); ++i)
+        {
+            row = idx.LF(row);
+            overlap_rows.push_back(row);
+        }
+        std::sort(overlap_rows.begin(), overlap_rows.end());
+    }
+
+    /*
+     * COUNT: one value, the occurrences starting at owned positions.
+     * LOCATE: all the occurrences, at positions of the shard
+     */
+    std::vector<ulint> answer(shard_query const& q)
+    {
+        auto samples = idx.search_with_mismatch(q.pattern, q.mismatches);
+
+        if (q.op == shard_query::LOCATE) return idx.locate_samples(samples);
+
+        // the occurrences starting in the overlap are the suffixes of the
+        // overlap within the SA ranges of the samples
+        ulint in_overlap = 0;
+        for (auto& s: samples)
+        {
+            range_t r = s.second.range;
+            in_overlap += std::upper_bound(overlap_rows.begin(), overlap_rows.end(), r.second)
+                        - std::lower_bound(overlap_rows.begin(), overlap_rows.end(), r.first);
+        }
+        return {idx.count_samples(samples) - in_overlap};
+    }
+
+    /*
+     * answers the queries read from file descriptor in on out, until in is
+     * closed
+     */
+    void serve(int in, int out)
+    {
+        shard_query q;
+        while (read_query(in, q)) write_result(out, answer(q));
+    }
+
+    static void write_query(int fd, shard_query const& q)
+    {
+        ulint header[3] = {(ulint)q.op, q.mismatches, q.pattern.size()};
+        write_all(fd, header, sizeof(header));
+        write_all(fd, q.pattern.data(), q.pattern.size());
+    }
+
+    static bool read_query(int fd, shard_query& q)
+    {
+        ulint header[3];
+        if (!read_all(fd, header, sizeof(header))) return false;
+        q.op = (shard_query::op_t)header[0];
+        q.mismatches = header[1];
+        q.pattern.resize(header[2]);
+        return read_all(fd, &q.pattern[0], header[2]);
+    }
+
+    static void write_result(int fd, std::vector<ulint> const& res)
+    {
+        ulint k = res.size();
+        write_all(fd, &k, sizeof(k));
+        write_all(fd, res.data(), k * sizeof(ulint));
+    }
+
+    static std::vector<ulint> read_result(int fd)
+    {
+        ulint k;
+        std::vector<ulint> res;
+        if (read_all(fd, &k, sizeof(k)))
+        {
+            res.resize(k);
+            if (read_all(fd, res.data(), k * sizeof(ulint))) return res;
+        }
+        throw std::runtime_error("shard process exited");
+    }
+
+private:
+
+    static void write_all(int fd, void const* buf, ulint len)
+    {
+        char const* p = (char const*)buf;
+        while (len > 0)
+        {
+            ssize_t w = write(fd, p, len);
+            if (w <= 0) throw std::runtime_error("cannot write to shard pipe");
+            p += w;
+            len -= w;
+        }
+    }
+
+    // false if fd is closed before len bytes
+    static bool read_all(int fd, void* buf, ulint len)
+    {
+        char* p = (char*)buf;
+        while (len > 0)
+        {
+            ssize_t r = read(fd, p, len);
+            if (r <= 0) return false;
+            p += r;
+            len -= r;
+        }
+        return true;
+    }
+
+    index_t idx;
+
+    // SA positions of the suffixes starting after the owned positions,
+    // sorted
+    std::vector<ulint> overlap_rows;
+
+};
+
+class shard {
+
+public:
+
+    virtual ~shard() {}
+
+    // starts answering q, at most one query being pending
+    virtual std::future<std::vector<ulint> > submit(shard_query const& q) = 0;
+
+};
+
+/*
+ * shard loaded in this process, answering on a worker thread of its own
+ * that takes the queries from a queue, as shard_process does from its pipe
+ */
+template<class index_t>
+class shard_thread : public shard {
+
+public:
+
+    shard_thread(std::string const& file, ulint owned) : server(file, owned)
+    {
+        worker = std::thread(&shard_thread::serve, this);
+    }
+
+    ~shard_thread()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopped = true;
+        }
+        cv.notify_one();
+        worker.join();
+    }
+
+    std::future<std::vector<ulint> > submit(shard_query const& q)
+    {
+        std::promise<std::vector<ulint> > p;
+        auto res = p.get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.emplace_back(q, std::move(p));
+        }
+        cv.notify_one();
+        return res;
+    }
+
+private:
+
+    void serve()
+    {
+        while (true)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this]() { return stopped || !queue.empty(); });
+            if (queue.empty()) return;
+
+            auto job = std::move(queue.front());
+            queue.pop_front();
+            lock.unlock();
+
+            try {
+                job.second.set_value(server.answer(job.first));
+            } catch (...) {
+                job.second.set_exception(std::current_exception());
+            }
+        }
+    }
+
+    shard_server<index_t> server;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::pair<shard_query, std::promise<std::vector<ulint> > > > queue;
+    bool stopped = false;
+
+    std::thread worker;
+
+};
+
+/*
+ * shard loaded in a child process, queries and results going through pipes
+ */
+template<class index_t>
+class shard_process : public shard {
+
+public:
+
+    shard_process(std::string const& file, ulint owned)
+    {
+        // a write to the pipe of a child that exited fails with EPIPE, and
+        // throws, instead of killing this process
+        signal(SIGPIPE, SIG_IGN);
+
+        int request[2], result[2];
+        if (pipe(request) != 0 || pipe(result) != 0) throw std::runtime_error("cannot create shard pipes");
+
+        pid = fork();
+        if (pid < 0) throw std::runtime_error("cannot fork shard process");
+
+        if (pid == 0)
+        {
+            signal(SIGPIPE, SIG_DFL);
+
+            // the pipes of the other shards stay open in their own processes only
+            for (int fd: open_fds()) close(fd);
+            close(request[1]);
+            close(result[0]);
+
+            try {
+                shard_server<index_t> server(file, owned);
+
+                // the shard is loaded: a byte tells the parent
+                char ready = 1;
+                if (write(result[1], &ready, 1) != 1) _exit(1);
+
+                server.serve(request[0], result[1]);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                _exit(1);
+            }
+            _exit(0);
+        }
+
+        close(request[0]);
+        close(result[1]);
+        to = request[1];
+        from = result[0];
+
+        // a shard that cannot be loaded fails here, not on the first query
+        char ready = 0;
+        if (read(from, &ready, 1) != 1)
+        {
+            close(to);
+            close(from);
+            waitpid(pid, nullptr, 0);
+            throw std::runtime_error("cannot load shard " + file);
+        }
+
+        open_fds().push_back(to);
+        open_fds().push_back(from);
+    }
+
+    ~shard_process()
+    {
+        auto& fds = open_fds();
+        fds.erase(std::remove_if(fds.begin(), fds.end(), [&](int fd) { return fd == to || fd == from; }), fds.end());
+
+        // the child serves until its requests are closed
+        close(to);
+        close(from);
+        waitpid(pid, nullptr, 0);
+    }
+
+    std::future<std::vector<ulint> > submit(shard_query const& q)
+    {
+        shard_server<index_t>::write_query(to, q);
+        return std::async(std::launch::deferred, [this]() { return shard_server<index_t>::read_result(from); });
+    }
+
+private:
+
+    // pipe ends of all the shard processes of this process
+    static std::vector<int>& open_fds()
+    {
+        static std::vector<int> fds;
+        return fds;
+    }
+
+    pid_t pid;
+    int to;
+    int from;
+
+};
+
+template<class index_t = br_index<> >
+class sharded_index {
+
+public:
+
+    /*
+     * \param manifest_file: .brs file written by bri-build -shards
+     * \param processes: serve each shard by a child process instead of a
+     *                   thread of this process
+     */
+    sharded_index(std::string const& manifest_file, bool processes = false)
+    {
+        manifest.load(manifest_file);
+
+        for (auto& s: manifest.shards)
+        {
+            if (processes) shards.emplace_back(new shard_process<index_t>(s.file, s.owned));
+            else shards.emplace_back(new shard_thread<index_t>(s.file, s.owned));
+        }
+    }
+
+    /*
+     * builds the index of each shard of input, and the manifest
+     * basename.brs
+     */
+    static shard_manifest build(std::string const& input, ulint k, ulint overlap,
+                                std::string const& basename, build_config const& config)
+    {
+        shard_manifest manifest(input.size(), k, overlap, basename);
+
+        for (ulint i = 0; i < k; ++i)
+        {
+            auto& s = manifest[i];
+            std::cout << "Building shard " << i + 1 << "/" << k << " (" << s.file << ")" << std::endl;
+
+            std::ofstream out(s.file);
+            index_t(input.substr(s.start, s.length), config).serialize(out);
+        }
+        manifest.save(basename + ".brs");
+
+        return manifest;
+    }
+
+    /*
+     * number of occurrences of pattern with up to mismatches mismatches
+     */
+    ulint count(std::string const& pattern, ulint mismatches = 0)
+    {
+        ulint res = 0;
+        for (auto& r: scatter(shard_query::COUNT, pattern, mismatches)) res += r[0];
+        return res;
+    }
+
+    /*
+     * sorted text positions of the occurrences of pattern with up to
+     * mismatches mismatches
+     */
+    std::vector<ulint> locate(std::string const& pattern, ulint mismatches = 0)
+    {
+        auto results = scatter(shard_query::LOCATE, pattern, mismatches);
+
+        std::vector<ulint> res;
+        for (ulint k = 0; k < results.size(); ++k)
+            for (auto i: results[k])
+                if (i < manifest[k].owned) res.push_back(manifest[k].start + i);
+
+        std::sort(res.begin(), res.end());
+        return res;
+    }
+
+    ulint number_of_shards() { return manifest.size(); }
+
+    ulint text_size() { return manifest.text_length; }
+
+private:
+
+    std::vector<std::vector<ulint> > scatter(shard_query::op_t op, std::string const& pattern, ulint mismatches)
+    {
+        if (pattern.size() > manifest.max_pattern_length())
+            throw std::invalid_argument("pattern longer than the overlap of the shards plus one");
+
+        shard_query q;
+        q.op = op;
+        q.mismatches = mismatches;
+        q.pattern = pattern;
+
+        std::vector<std::future<std::vector<ulint> > > pending;
+        for (auto& s: shards) pending.push_back(s->submit(q));
+
+        std::vector<std::vector<ulint> > res;
+        for (auto& p: pending) res.push_back(p.get());
+        return res;
+    }
+
+    shard_manifest manifest;
+
+    std::vector<std::unique_ptr<shard> > shards;
+
+};
+
+};
+
+#endif /* INCLUDED_SHARDED_INDEX_HPP */
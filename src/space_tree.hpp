@@ -0,0 +1,138 @@
+/*
+ * space_node: footprint of a structure of the index as a tree of its
+ * components, returned by space_tree() of each structure (bri-space)
+ *
+ *  bytes is what the component takes once serialized, which is also what
+ *  its data takes in RAM once loaded; support_bytes is the part of it
+ *  taken by rank/select supports (select on the high bits of the
+ *  Elias-Fano vectors, rank/select of the wavelet trees). the sizes are
+ *  computed from the structures in memory; the sdsl supports and wavelet
+ *  trees, whose layout is private, are measured with sdsl::size_in_bytes,
+ *  which writes to a null stream without copying the data.
+ */
+
+#ifndef INCLUDED_SPACE_TREE_HPP
+#define INCLUDED_SPACE_TREE_HPP
+
+#include <iomanip>
+
+#include "definitions.hpp"
+
+namespace bri {
+
+struct space_node {
+
+    std::string name;
+
+    // including the children, and fields of the node itself
+    ulint bytes = 0;
+    ulint support_bytes = 0;
+
+    std::vector<space_node> children;
+
+    space_node(std::string const& name = "", ulint bytes = 0, ulint support_bytes = 0) :
+        name(name), bytes(bytes), support_bytes(support_bytes) {}
+
+    /*
+     * serialized size of an int_vector (or bit_vector): length, width if
+     * not fixed, then the words
+     */
+    template<uint8_t w>
+    static space_node of(std::string const& name, sdsl::int_vector<w> const& v)
+    {
+        return space_node(name, sizeof(ulint) + (w == 0 ? sizeof(uint8_t) : 0) + ((v.bit_size() + 63) / 64) * sizeof(ulint));
+    }
+
+    /*
+     * adds child, and its bytes to this node
+     */
+    space_node& add(space_node const& child)
+    {
+        bytes += child.bytes;
+        support_bytes += child.support_bytes;
+        children.push_back(child);
+        return *this;
+    }
+
+    /*
+     * adds the bytes of other to this node, and its children to the
+     * children with the same name (e.g. the bitvectors of all letters)
+     */
+    space_node& merge(space_node const& other)
+    {
+        bytes += other.bytes;
+        support_bytes += other.support_bytes;
+
+        for (auto& c: other.children)
+        {
+            auto it = std::find_if(children.begin(), children.end(),
+                                   [&](space_node const& d) { return d.name == c.name; });
+            if (it == children.end()) children.push_back(c);
+            else it->merge(c);
+        }
+        return *this;
+    }
+
+    /*
+     * descendant at path "child/grandchild/...", nullptr if there is none
+     */
+    space_node const* find(std::string const& path) const
+    {
+        auto slash = path.find('/');
+        std::string head = path.substr(0, slash);
+
+        for (auto& c: children)
+            if (c.name == head)
+                return slash == std::string::npos ? &c : c.find(path.substr(slash + 1));
+        return nullptr;
+    }
+
+    /*
+     * a line per node, indented by depth, with the fraction of total
+     */
+    void print(std::ostream& out, ulint total = 0, ulint depth = 0) const
+    {
+        if (total == 0) total = bytes;
+
+        out << std::string(2 * depth, ' ') << name << ": " << bytes << " bytes ("
+            << std::fixed << std::setprecision(2) << fraction(total) * 100 << "%)";
+        if (support_bytes > 0) out << ", rank/select " << support_bytes << " bytes";
+        out << std::defaultfloat << std::setprecision(6) << std::endl;
+
+        for (auto& c: children) c.print(out, total, depth + 1);
+    }
+
+    void write_json(std::ostream& out, ulint total = 0, ulint depth = 0) const
+    {
+        if (total == 0) total = bytes;
+        std::string indent(2 * depth, ' ');
+
+        out << indent << "{\"name\": \"" << name << "\", \"bytes\": " << bytes << ", \"fraction\": " << fraction(total)
+            << ", \"support_bytes\": " << support_bytes;
+        if (children.empty())
+        {
+            out << "}";
+            return;
+        }
+
+        out << ", \"children\": [" << std::endl;
+        for (ulint i = 0; i < children.size(); ++i)
+        {
+            children[i].write_json(out, total, depth + 1);
+            out << (i + 1 < children.size() ? "," : "") << std::endl;
+        }
+        out << indent << "]}";
+    }
+
+private:
+
+    double fraction(ulint total) const
+    {
+        return total == 0 ? 0 : (double)bytes / total;
+    }
+
+};
+
+};
+
+#endif /* INCLUDED_SPACE_TREE_HPP */
@@ -6,6 +6,7 @@
 #define INCLUDED_SPARSE_SD_VECTOR_HPP
 
 #include "definitions.hpp"
+#include "space_tree.hpp"
 
 #ifndef ulint
 typedef uint64_t ulint;
@@ -48,6 +49,27 @@ public:
 
     }
 
+    /*
+     * constructor. build from the increasing positions of the 1-bits of a
+     * bitvector of length u, which is never materialized
+     */
+    sparse_sd_vector(std::vector<ulint> const& ones, ulint u, bool enable_rank=true, bool enable_select=true)
+    {
+        if (u == 0) return;
+
+        rank_enabled = enable_rank;
+        select_enabled = enable_select;
+
+        this->u = u;
+
+        sdsl::sd_vector_builder builder(u, ones.size());
+        for (auto i: ones) builder.set(i);
+
+        sdv = sdsl::sd_vector<>(builder);
+        if (rank_enabled) rank1 = sdsl::sd_vector<>::rank_1_type(&sdv);
+        if (select_enabled) select1 = sdsl::sd_vector<>::select_1_type(&sdv);
+    }
+
     /*
      * constructor. build using bit_vector
      */
@@ -171,6 +193,33 @@ public:
 
     }
 
+    /*
+     * serialized size: the length, then the Elias-Fano low bits, high bits
+     * and the select supports on the high bits. the rank and select
+     * supports of this class only point to sdv
+     */
+    space_node space_tree(std::string const& name = "sparse_sd_vector") const
+    {
+        space_node res(name, sizeof(u));
+        if (u == 0) return res;
+
+        // length and width of the low bits
+        res.bytes += sizeof(ulint) + sizeof(uint8_t);
+
+        res.add(space_node::of("low", sdv.low));
+        res.add(space_node::of("high", sdv.high));
+
+        ulint select_bytes = sdsl::size_in_bytes(sdv.high_1_select) + sdsl::size_in_bytes(sdv.high_0_select);
+        res.add(space_node("select", select_bytes, select_bytes));
+
+        return res;
+    }
+
+    ulint size_in_bytes() const
+    {
+        return space_tree().bytes;
+    }
+
     /*
      * argument: ostream
      * returns: number of bytes written to ostream
@@ -0,0 +1,280 @@
+/*
+ * suffix_sort: suffix array construction backends of the br-index
+ *
+ *  a backend sorts the suffixes of the text cached in a sdsl cache_config
+ *  and caches the suffix array, from which the BWT and its run samples are
+ *  then streamed. sdsl_suffix_sorter uses the algorithms of sdsl (SE-SAIS,
+ *  divsufsort), parallel_suffix_sorter is a multi-threaded prefix doubling.
+ */
+
+#ifndef INCLUDED_SUFFIX_SORT_HPP
+#define INCLUDED_SUFFIX_SORT_HPP
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "definitions.hpp"
+
+namespace bri {
+
+class suffix_sorter {
+
+public:
+
+    virtual ~suffix_sorter() {}
+
+    // name printed in the construction log
+    virtual std::string name() const = 0;
+
+    // approximate RAM in bytes per text character, for the RAM budget
+    virtual double bytes_per_char() const = 0;
+
+    // true if the sorter keeps the suffix array on disk (SE-SAIS), the
+    // fallback of the RAM budget
+    virtual bool semi_external() const { return false; }
+
+    // global settings, applied once before the sorts of text and textR
+    virtual void configure() const {}
+
+    /*
+     * builds the suffix array of the text cached in cc as KEY_TEXT (with
+     * its terminating 0) and caches it as KEY_SA, using up to threads
+     * threads. may be called concurrently on different configs.
+     */
+    virtual void sort(sdsl::cache_config& cc, ulint threads) const = 0;
+
+};
+
+class sdsl_suffix_sorter : public suffix_sorter {
+
+public:
+
+    /*
+     * \param algo: sdsl::SE_SAIS or sdsl::LIBDIVSUFSORT
+     */
+    sdsl_suffix_sorter(sdsl::byte_sa_algo_type algo) : algo(algo) {}
+
+    std::string name() const
+    {
+        return algo == sdsl::SE_SAIS ? "SA-SAIS" : "DIVSUFSORT";
+    }
+
+    double bytes_per_char() const
+    {
+        return algo == sdsl::SE_SAIS ? 4 : 7.5;
+    }
+
+    bool semi_external() const
+    {
+        return algo == sdsl::SE_SAIS;
+    }
+
+    void configure() const
+    {
+        sdsl::construct_config::byte_algo_sa = algo;
+    }
+
+    void sort(sdsl::cache_config& cc, ulint) const
+    {
+        sdsl::construct_sa<8>(cc);
+    }
+
+private:
+
+    sdsl::byte_sa_algo_type algo;
+
+};
+
+/*
+ * prefix doubling (Manber & Myers) over groups of suffixes sharing a prefix.
+ * suffixes are first sorted by their first 8 characters packed in a word;
+ * then, while some group holds more than one suffix, each such group is
+ * sorted by the rank of the suffix h positions later and split, h doubling
+ * every round. the groups of a round are independent, so they are sorted
+ * by all the threads at once (large groups by a parallel merge sort).
+ * ranks are the last SA position of the group, so they are read in a
+ * separate pass before any of them is updated.
+ *
+ * about 3 words per character (SA, ranks, keys).
+ */
+class parallel_suffix_sorter : public suffix_sorter {
+
+public:
+
+    std::string name() const
+    {
+        return "PARALLEL";
+    }
+
+    double bytes_per_char() const
+    {
+        return 25;
+    }
+
+    void sort(sdsl::cache_config& cc, ulint threads) const
+    {
+        sdsl::int_vector<8> text;
+        sdsl::load_from_cache(text, sdsl::conf::KEY_TEXT, cc);
+
+        std::vector<ulint> sa = sort(text, std::max<ulint>(threads,1));
+
+        ulint n = sa.size();
+        uint8_t width = 1;
+        while (width < 64 && (ulint(1) << width) <= n) ++width;
+
+        sdsl::int_vector<> sa_iv(n, 0, width);
+        for (ulint i = 0; i < n; ++i) sa_iv[i] = sa[i];
+
+        sdsl::store_to_cache(sa_iv, sdsl::conf::KEY_SA, cc);
+    }
+
+    /*
+     * suffix array of text, whose characters fit in bits bits and whose
+     * last character is unique (the 0 terminator of sdsl)
+     */
+    template<class text_t>
+    static std::vector<ulint> sort(text_t const& text, ulint threads, ulint bits = 8)
+    {
+        ulint n = text.size();
+        assert(n > 0 && bits > 0 && bits <= 64);
+
+        std::vector<ulint> sa(n);
+        std::vector<ulint> rank(n);
+        std::vector<ulint> key(n);
+
+        // initial keys: the first 64/bits characters, past the end padded
+        // with 0. the last character is unique, so suffixes sharing their
+        // first h characters never reach it within h characters
+        ulint h = 64 / bits;
+        parallel_for(threads, n, [&](ulint i)
+        {
+            ulint k = 0;
+            for (ulint j = 0; j < h; ++j)
+                k = (bits < 64 ? k << bits : 0) | (i + j < n ? (ulint)text[i+j] : 0);
+            key[i] = k;
+            sa[i] = i;
+        });
+        parallel_sort(sa.begin(), sa.end(), [&](ulint a, ulint b) { return key[a] < key[b]; }, threads);
+
+        // inclusive SA ranges of the groups with more than one suffix
+        std::vector<range_t> groups;
+        for (ulint i = 0, j; i < n; i = j + 1)
+        {
+            j = i;
+            while (j + 1 < n && key[sa[j+1]] == key[sa[i]]) ++j;
+            for (ulint k = i; k <= j; ++k) rank[sa[k]] = j;
+            if (j > i) groups.push_back({i,j});
+        }
+
+        while (!groups.empty())
+        {
+            // the groups sorted by a single thread
+            ulint large = std::max<ulint>(n / (4 * threads), 1024);
+
+            parallel_for(threads, groups.size(), [&](ulint g)
+            {
+                for (ulint k = groups[g].first; k <= groups[g].second; ++k)
+                    key[sa[k]] = rank[sa[k]+h];
+            });
+
+            auto by_key = [&](ulint a, ulint b) { return key[a] < key[b]; };
+            parallel_for(threads, groups.size(), [&](ulint g)
+            {
+                if (groups[g].second - groups[g].first < large)
+                    std::sort(sa.begin() + groups[g].first, sa.begin() + groups[g].second + 1, by_key);
+            });
+            for (auto& g: groups)
+            {
+                if (g.second - g.first >= large)
+                    parallel_sort(sa.begin() + g.first, sa.begin() + g.second + 1, by_key, threads);
+            }
+
+            // split the groups, collecting the new ones per thread
+            std::vector<std::vector<range_t> > split(threads);
+            parallel_for(threads, groups.size(), [&](ulint g, ulint t)
+            {
+                for (ulint i = groups[g].first, j; i <= groups[g].second; i = j + 1)
+                {
+                    j = i;
+                    while (j + 1 <= groups[g].second && key[sa[j+1]] == key[sa[i]]) ++j;
+                    for (ulint k = i; k <= j; ++k) rank[sa[k]] = j;
+                    if (j > i) split[t].push_back({i,j});
+                }
+            });
+
+            groups.clear();
+            for (auto& s: split) groups.insert(groups.end(), s.begin(), s.end());
+
+            h *= 2;
+        }
+
+        return sa;
+    }
+
+private:
+
+    /*
+     * calls f(i, thread) for i in [0, count), handing out blocks of
+     * indices to the threads as they finish
+     */
+    template<class F>
+    static void parallel_for(ulint threads, ulint count, F f, decltype(f(0,0))* = nullptr)
+    {
+        ulint block = std::max<ulint>(count / (64 * threads), 1);
+        std::atomic<ulint> next(0);
+
+        auto work = [&](ulint t)
+        {
+            for (ulint b = next.fetch_add(block); b < count; b = next.fetch_add(block))
+                for (ulint i = b; i < std::min(b + block, count); ++i) f(i,t);
+        };
+
+        std::vector<std::thread> workers;
+        for (ulint t = 1; t < threads; ++t) workers.emplace_back(work, t);
+        work(0);
+        for (auto& w: workers) w.join();
+    }
+
+    template<class F>
+    static void parallel_for(ulint threads, ulint count, F f, decltype(f(0))* = nullptr)
+    {
+        parallel_for(threads, count, [&](ulint i, ulint) { f(i); });
+    }
+
+    /*
+     * std::sort of blocks in parallel, then rounds of pairwise merges
+     */
+    template<class iterator, class compare>
+    static void parallel_sort(iterator begin, iterator end, compare comp, ulint threads)
+    {
+        ulint n = end - begin;
+        ulint blocks = std::min<ulint>(threads, std::max<ulint>(n / 1024, 1));
+
+        std::vector<ulint> bounds;
+        for (ulint b = 0; b <= blocks; ++b) bounds.push_back(n * b / blocks);
+
+        parallel_for(blocks, blocks, [&](ulint b)
+        {
+            std::sort(begin + bounds[b], begin + bounds[b+1], comp);
+        });
+
+        for (ulint width = 1; width < blocks; width *= 2)
+        {
+            ulint merges = (blocks + 2 * width - 1) / (2 * width);
+            parallel_for(merges, merges, [&](ulint m)
+            {
+                ulint lo = 2 * width * m;
+                ulint mid = std::min(lo + width, blocks);
+                ulint hi = std::min(lo + 2 * width, blocks);
+                if (mid < hi)
+                    std::inplace_merge(begin + bounds[lo], begin + bounds[mid], begin + bounds[hi], comp);
+            });
+        }
+    }
+
+};
+
+};
+
+#endif /* INCLUDED_SUFFIX_SORT_HPP */
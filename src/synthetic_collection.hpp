@@ -0,0 +1,286 @@
+/*
+ * synthetic_collection: pangenome-like repetitive collections and read sets
+ * for benchmarks (bri-gen)
+ *
+ *  a random base genome is followed by copies of it, each mutated on its
+ *  own with substitutions (SNPs) and indels at the given rates per base, so
+ *  that n grows with the number of copies and r with the number of
+ *  mutations. mutation sites are drawn with geometric gaps, in time
+ *  proportional to the output. reads are substrings of a random sequence,
+ *  reverse complemented with probability 1/2 over ACGT, with substitutions
+ *  and indels at their own rates, or exactly k substitutions; all reads
+ *  have the same length. everything is determined by the seed.
+ */
+
+#ifndef INCLUDED_SYNTHETIC_COLLECTION_HPP
+#define INCLUDED_SYNTHETIC_COLLECTION_HPP
+
+#include <random>
+#include <stdexcept>
+
+#include "definitions.hpp"
+
+namespace bri {
+
+struct synthetic_config {
+
+    // length of the base genome, and number of mutated copies
+    ulint length = 1000000;
+    ulint copies = 10;
+
+    // rates per base of the copies
+    double snp_rate = 0.001;
+    double indel_rate = 0.0001;
+
+    // mean length of an indel (geometric)
+    ulint indel_length = 3;
+
+    // ACGT for 4, then other letters and digits
+    ulint sigma = 4;
+
+    ulint seed = 1;
+
+};
+
+struct synthetic_read_config {
+
+    ulint count = 0;
+    ulint length = 100;
+
+    // rates per base
+    double sub_rate = 0.01;
+    double indel_rate = 0;
+
+    // if >= 0, exactly this many substitutions per read instead of sub_rate
+    long exact_subs = -1;
+
+};
+
+struct synthetic_read {
+
+    // sequence, position in it, strand
+    ulint sequence = 0;
+    ulint pos = 0;
+    bool reverse = false;
+
+    ulint subs = 0;
+    ulint indels = 0;
+
+    std::string seq;
+
+};
+
+class synthetic_collection {
+
+public:
+
+    static std::string alphabet(ulint sigma)
+    {
+        const std::string letters = "ACGTBDEFHIJKLMNOPQRSUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+        if (sigma < 2 || sigma > letters.size())
+            throw std::invalid_argument("the alphabet size must be between 2 and " + std::to_string(letters.size()));
+        return letters.substr(0, sigma);
+    }
+
+    synthetic_collection(synthetic_config const& config) : config(config), gen(config.seed)
+    {
+        if (config.length == 0) throw std::invalid_argument("the base genome must not be empty");
+        if (config.snp_rate < 0 || config.indel_rate < 0 || config.snp_rate + config.indel_rate > 1)
+            throw std::invalid_argument("mutation rates must be non-negative, with sum at most 1");
+
+        sigma = alphabet(config.sigma);
+        for (ulint c = 0; c < 256; ++c) code[c] = 0;
+        for (ulint a = 0; a < sigma.size(); ++a) code[(uchar)sigma[a]] = a;
+
+        std::string base(config.length, 0);
+        std::uniform_int_distribution<ulint> letter(0, sigma.size() - 1);
+        for (auto& c: base) c = sigma[letter(gen)];
+
+        seqs.push_back(base);
+        names.push_back("base");
+        for (ulint i = 1; i <= config.copies; ++i)
+        {
+            seqs.push_back(mutate(seqs[0], config.snp_rate, config.indel_rate, snps, indels));
+            names.push_back("copy_" + std::to_string(i));
+        }
+    }
+
+    /*
+     * the base genome, then the copies
+     */
+    std::vector<std::string> const& sequences() const { return seqs; }
+
+    std::vector<std::string> const& sequence_names() const { return names; }
+
+    ulint total_length() const
+    {
+        ulint n = 0;
+        for (auto& s: seqs) n += s.size();
+        return n;
+    }
+
+    // mutations applied to the copies
+    ulint snps = 0;
+    ulint indels = 0;
+
+    void write_fasta(std::ostream& out, ulint width = 80) const
+    {
+        for (ulint i = 0; i < seqs.size(); ++i)
+        {
+            out << '>' << names[i] << '\n';
+            for (ulint j = 0; j < seqs[i].size(); j += width) out << seqs[i].substr(j, width) << '\n';
+        }
+    }
+
+    // the concatenation of the sequences
+    void write_text(std::ostream& out) const
+    {
+        for (auto& s: seqs) out << s;
+    }
+
+    /*
+     * a read of rc.length characters. the reads are drawn from their own
+     * generator, seeded by the seed of the collection
+     */
+    synthetic_read next_read(synthetic_read_config const& rc)
+    {
+        if (rc.length == 0) throw std::invalid_argument("reads must not be empty");
+        if (rc.sub_rate < 0 || rc.indel_rate < 0 || rc.sub_rate + rc.indel_rate > 1)
+            throw std::invalid_argument("read error rates must be non-negative, with sum at most 1");
+        if (rc.exact_subs > (long)rc.length)
+            throw std::invalid_argument("more substitutions than characters in a read");
+
+        bool exact = rc.exact_subs >= 0;
+        double sub_rate = exact ? 0 : rc.sub_rate;
+
+        synthetic_read r;
+        for (ulint attempt = 0; ; ++attempt)
+        {
+            if (attempt == 1000) throw std::invalid_argument("the sequences are too short for the reads");
+
+            std::uniform_int_distribution<ulint> which(0, seqs.size() - 1);
+            r.sequence = which(read_gen);
+            auto& s = seqs[r.sequence];
+            if (s.size() < rc.length) continue;
+
+            // the indels of the read may consume more or less than rc.length characters
+            std::uniform_int_distribution<ulint> start(0, s.size() - rc.length);
+            r.pos = start(read_gen);
+            ulint subs = 0, ins_del = 0;
+            r.seq = mutate(s.substr(r.pos, std::min<ulint>(s.size() - r.pos, 2 * rc.length)), sub_rate, rc.indel_rate,
+                           subs, ins_del, read_gen, rc.length);
+            if (r.seq.size() < rc.length) continue;
+
+            r.subs = subs;
+            r.indels = ins_del;
+            break;
+        }
+
+        if (exact)
+        {
+            // exact_subs distinct positions
+            std::vector<ulint> positions(rc.length);
+            for (ulint i = 0; i < rc.length; ++i) positions[i] = i;
+            for (long k = 0; k < rc.exact_subs; ++k)
+            {
+                std::uniform_int_distribution<ulint> pick(k, rc.length - 1);
+                std::swap(positions[k], positions[pick(read_gen)]);
+                r.seq[positions[k]] = substitute(r.seq[positions[k]], read_gen);
+            }
+            r.subs = rc.exact_subs;
+        }
+
+        r.reverse = sigma == "ACGT" && std::bernoulli_distribution(0.5)(read_gen);
+        if (r.reverse)
+        {
+            std::reverse(r.seq.begin(), r.seq.end());
+            for (auto& c: r.seq) c = c == 'A' ? 'T' : c == 'C' ? 'G' : c == 'G' ? 'C' : 'A';
+        }
+        return r;
+    }
+
+private:
+
+    std::string mutate(std::string const& src, double sub_rate, double indel_rate, ulint& subs, ulint& ins_del)
+    {
+        return mutate(src, sub_rate, indel_rate, subs, ins_del, gen, std::string::npos);
+    }
+
+    /*
+     * src with substitutions and indels at the given rates per base, up to
+     * the first limit characters of the result
+     */
+    std::string mutate(std::string const& src, double sub_rate, double indel_rate,
+                       ulint& subs, ulint& ins_del, std::mt19937_64& g, ulint limit)
+    {
+        double p = sub_rate + indel_rate;
+        if (p <= 0) return src.substr(0, limit);
+
+        std::string res;
+        res.reserve(src.size() + src.size() / 64);
+
+        std::geometric_distribution<ulint> gap(std::min(p, 1.0));
+        std::geometric_distribution<ulint> extra(1.0 / std::max<ulint>(config.indel_length, 1));
+        std::uniform_real_distribution<double> kind(0, p);
+        std::uniform_int_distribution<ulint> letter(0, sigma.size() - 1);
+
+        ulint i = 0;
+        while (true)
+        {
+            // unchanged characters before the next mutation
+            ulint skip = gap(g);
+            if (skip >= src.size() - i || res.size() + skip >= limit)
+            {
+                res.append(src, i, std::string::npos);
+                break;
+            }
+            res.append(src, i, skip);
+            i += skip;
+
+            double u = kind(g);
+            ulint len = 1 + extra(g);
+            if (u < sub_rate)
+            {
+                res.push_back(substitute(src[i], g));
+                subs++;
+                i++;
+            }
+            else if (u < sub_rate + indel_rate / 2)
+            {
+                // insertion before src[i]
+                for (ulint k = 0; k < len; ++k) res.push_back(sigma[letter(g)]);
+                ins_del++;
+            }
+            else
+            {
+                i += std::min(len, src.size() - i);
+                ins_del++;
+            }
+            if (i == src.size() || res.size() >= limit) break;
+        }
+        if (res.size() > limit) res.resize(limit);
+        return res;
+    }
+
+    // another character of the alphabet
+    char substitute(char c, std::mt19937_64& g)
+    {
+        std::uniform_int_distribution<ulint> shift(1, sigma.size() - 1);
+        return sigma[(code[(uchar)c] + shift(g)) % sigma.size()];
+    }
+
+    synthetic_config config;
+    std::mt19937_64 gen;
+    std::mt19937_64 read_gen{gen()};
+
+    std::string sigma;
+    ulint code[256];
+
+    std::vector<std::string> seqs;
+    std::vector<std::string> names;
+
+};
+
+};
+
+#endif /* INCLUDED_SYNTHETIC_COLLECTION_HPP */
@@ -1,13 +1,35 @@
 #include "iutest.hpp"
 #include <vector>
 #include <fstream>
+#include <map>
 #include <string>
 
 #include "../src/br_index.hpp"
 #include "../src/br_index_naive.hpp"
+#include "../src/br_index_nplcp.hpp"
+#include "../src/bwt_merge.hpp"
+#include "../src/sharded_index.hpp"
+#include "../src/index_bench.hpp"
+#include "../src/kmer_spectrum.hpp"
+#include "../src/paired_end.hpp"
 
 using namespace bri;
 
+/*
+ * copies of a sequence, each with a substitution more than the one before
+ */
+static std::string repetitive_text(int copies = 30)
+{
+    std::string s;
+    std::string base("ACGTTGCAAGGCTTACGATCGGATCCTAGCTAGGCATCG");
+    for (int i = 0; i < copies; ++i)
+    {
+        s += base;
+        base[(i * 7) % base.size()] = "ACGT"[i % 4];
+    }
+    return s;
+}
+
 template<class T>
 void print_vec(std::vector<T>& vec)
 {
@@ -304,3 +326,606 @@ IUTEST(BrIndexNaiveTest, DNALikeTextLocate)
     IUTEST_EXPECT_EQ(8,vec[1]);
     IUTEST_EXPECT_EQ(11,vec[2]);
 }
+
+IUTEST(BrIndexTest, FastaSequences)
+{
+    std::string s(">a\nAACCGG\n>b\nTTAACC\n");
+    std::vector<ulint> starts;
+    std::vector<std::string> names;
+    sequence_boundaries<>::parse_fasta(s,starts,names);
+
+    br_index<> idx(s);
+    idx.set_sequences(starts,names);
+
+    // "GGATT" only matches "GG#TT" by substituting the separator
+    IUTEST_ASSERT_EQ(0,idx.locate_with_mismatch("GGATT",1).size());
+
+    std::vector<ulint> occs = idx.locate_with_mismatch("AACC",0);
+    std::sort(occs.begin(),occs.end());
+    IUTEST_ASSERT_EQ(2,occs.size());
+    IUTEST_ASSERT_EQ(0,idx.sequence_position(occs[0]).first);
+    IUTEST_ASSERT_EQ(0,idx.sequence_position(occs[0]).second);
+    IUTEST_ASSERT_EQ("b",idx.sequence_name(idx.sequence_position(occs[1]).first));
+    IUTEST_ASSERT_EQ(2,idx.sequence_position(occs[1]).second);
+}
+
+IUTEST(BrIndexTest, DocumentListing)
+{
+    // similar documents, as in a pangenome
+    std::string s;
+    for (int d = 0; d < 6; ++d)
+    {
+        s += ">doc" + std::to_string(d) + "\n";
+        for (int i = 0; i < 200; ++i)
+            s.push_back((i * 7 + i / 5 + (i % (d + 3) == 0 ? d : 0)) % 5 == 0 ? 'A' : "CGTA"[(i * i + d * (i % 11 == 0)) % 4]);
+        s += "\n";
+    }
+    std::vector<ulint> starts;
+    std::vector<std::string> names;
+    sequence_boundaries<>::parse_fasta(s,starts,names);
+
+    br_index<> idx(s);
+    idx.set_sequences(starts,names);
+    IUTEST_ASSERT_EQ(6,idx.number_of_documents());
+
+    br_index_nplcp<> idx_nplcp(s);
+    idx_nplcp.set_sequences(starts,names);
+
+    for (ulint len = 1; len <= 8; ++len)
+    {
+        for (ulint i = 0; i + len <= 200; i += 7)
+        {
+            std::string p = s.substr(i,len);
+
+            std::vector<ulint> expected;
+            for (auto o: idx.locate(p)) expected.push_back(idx.sequence_position(o).first);
+            std::sort(expected.begin(),expected.end());
+            expected.erase(std::unique(expected.begin(),expected.end()),expected.end());
+
+            // a Phi or PhiI step per document listed, not per occurrence
+            std::vector<ulint> docs;
+            query_stats stats = query_stats::counted([&]() { docs = idx.list_documents(p); });
+            IUTEST_ASSERT_EQ(expected,docs);
+            IUTEST_ASSERT_GE(expected.size()+1,stats.phi_calls);
+            IUTEST_ASSERT_EQ(expected.size(),idx.count_documents(p));
+
+            stats = query_stats::counted([&]() { docs = idx_nplcp.list_documents(p); });
+            IUTEST_ASSERT_EQ(expected,docs);
+            IUTEST_ASSERT_GE(expected.size()+1,stats.phi_calls);
+        }
+    }
+
+    auto samples = idx.search_with_mismatch(s.substr(0,6),1);
+    std::vector<ulint> expected;
+    for (auto o: idx.locate_samples(samples)) expected.push_back(idx.sequence_position(o).first);
+    std::sort(expected.begin(),expected.end());
+    expected.erase(std::unique(expected.begin(),expected.end()),expected.end());
+    IUTEST_ASSERT_EQ(expected,idx.list_documents_samples(samples));
+}
+
+IUTEST(BrIndexTest, PrefixFreeParseConstruction)
+{
+    std::string s = repetitive_text();
+
+    // the index built from the parse is the same as the one built from SA
+    {
+        std::stringstream expected, res;
+        br_index<>(s).serialize(expected);
+        br_index<>(s,true,1,true).serialize(res);
+        IUTEST_ASSERT_EQ(expected.str(),res.str());
+
+        std::stringstream res_mt;
+        br_index<>(s,true,2,true).serialize(res_mt);
+        IUTEST_ASSERT_EQ(expected.str(),res_mt.str());
+    }
+    {
+        std::stringstream expected, res;
+        br_index_nplcp<>(s).serialize(expected);
+        br_index_nplcp<>(s,true,1,true).serialize(res);
+        IUTEST_ASSERT_EQ(expected.str(),res.str());
+    }
+}
+
+IUTEST(BrIndexTest, RamBudgetConstruction)
+{
+    std::string s = repetitive_text();
+
+    // a budget too small for divsufsort and concurrent sorting
+    build_config config(false,2,false);
+    config.tmp_dir = "test-tmp";
+    config.max_ram = 4 * s.size();
+
+    build_config fitted = config;
+    fitted.fit_suffix_sort(s.size());
+    IUTEST_ASSERT_TRUE(fitted.sorter->semi_external());
+    IUTEST_ASSERT_EQ(1u,fitted.threads);
+
+    // the index does not depend on the budget
+    {
+        std::stringstream expected, res;
+        br_index<>(s,false,2).serialize(expected);
+        br_index<>(s,config).serialize(res);
+        IUTEST_ASSERT_EQ(expected.str(),res.str());
+    }
+    {
+        std::stringstream expected, res;
+        br_index_nplcp<>(s,false,2).serialize(expected);
+        br_index_nplcp<>(s,config).serialize(res);
+        IUTEST_ASSERT_EQ(expected.str(),res.str());
+    }
+}
+
+IUTEST(BrIndexTest, ParallelSuffixSortConstruction)
+{
+    std::string s = repetitive_text();
+
+    for (ulint threads: {1, 4})
+    {
+        build_config config;
+        config.sorter = std::make_shared<parallel_suffix_sorter>();
+        config.threads = threads;
+
+        std::stringstream expected, res;
+        br_index<>(s).serialize(expected);
+        br_index<>(s,config).serialize(res);
+        IUTEST_ASSERT_EQ(expected.str(),res.str());
+
+        std::stringstream expected_n, res_n;
+        br_index_nplcp<>(s).serialize(expected_n);
+        br_index_nplcp<>(s,config).serialize(res_n);
+        IUTEST_ASSERT_EQ(expected_n.str(),res_n.str());
+    }
+}
+
+IUTEST(BrIndexTest, SharedConstruction)
+{
+    std::string s = repetitive_text();
+
+    std::stringstream expected, expected_n;
+    br_index<>(s).serialize(expected);
+    br_index_nplcp<>(s).serialize(expected_n);
+
+    // both indexes from a single suffix sorting (or parse) of each text
+    for (bool pfp: {false, true})
+    {
+        bwt_construction bc(s,build_config(true,1,pfp),true);
+
+        std::stringstream res, res_n;
+        br_index<>(s,bc).serialize(res);
+        br_index_nplcp<>(s,bc).serialize(res_n);
+        IUTEST_ASSERT_EQ(expected.str(),res.str());
+        IUTEST_ASSERT_EQ(expected_n.str(),res_n.str());
+    }
+}
+
+IUTEST(BrIndexTest, MergeBatch)
+{
+    std::string s = repetitive_text();
+
+    // same alphabet, new characters on both sides, a single character,
+    // a copy of the text, and a text of a single character. then sequences
+    // closed by a separator, whose first prefixes repeat after separators,
+    // and texts whose prefixes all repeat after a small character
+    std::vector<std::pair<std::string,std::string> > cases = {
+        {s, "GATTACAGATTACA"}, {s, "!ACGTzzACGT"}, {s, "T"}, {s, s}, {"A", "AAAB"}, {"mississippi", "ssi"},
+        {"ACGTACG#ACGTTCG#ACGAACG#ACGTACG", "ACGTAC#"}, {"ACGT#ACGT", "ACGT#"}, {"AAAA", "AA"}, {"ABABAB", "B"}
+    };
+
+    for (auto& t: cases)
+    {
+        br_index<> idx(t.first);
+        IUTEST_ASSERT_EQ(t.first,idx.get_text());
+
+        std::stringstream expected;
+        br_index<>(t.second + t.first).serialize(expected);
+
+        for (ulint threads: {1, 2})
+        {
+            bwt_construction bc = bwt_merge::merge(idx,t.second,threads);
+
+            std::stringstream res;
+            br_index<>(bc).serialize(res);
+            IUTEST_ASSERT_EQ(expected.str(),res.str());
+        }
+    }
+
+    // FASTA batches, whose sequences are numbered first: the documents and
+    // the ILCP merged with the BWT
+    std::string a = ">a\n" + s.substr(0,400) + "\n>b\n" + s.substr(300,500) + "\n>c\n" + s.substr(0,200) + "\n";
+    std::vector<std::pair<std::string,std::string> > fasta = {
+        {a, ">x\n" + s.substr(100,300) + "\n>y\n" + s.substr(0,250) + "\n"}, {a, a},
+        {">a\nACGT\n>b\nACGA\n", ">x\nACG\n"}, {">a\nACGT\n", ">x\nACGT\n>y\nACGT\n"}
+    };
+
+    for (auto& t: fasta)
+    {
+        std::string text = t.first, batch = t.second, all = t.second + t.first;
+        std::vector<ulint> starts, batch_starts, all_starts;
+        std::vector<std::string> names, batch_names, all_names;
+        sequence_boundaries<>::parse_fasta(text,starts,names);
+        sequence_boundaries<>::parse_fasta(batch,batch_starts,batch_names);
+        sequence_boundaries<>::parse_fasta(all,all_starts,all_names);
+        batch.push_back(SEQUENCE_SEPARATOR);
+
+        br_index<> idx(text);
+        idx.set_sequences(starts,names);
+
+        std::stringstream expected;
+        {
+            br_index<> full(all);
+            full.set_sequences(all_starts,all_names);
+            full.serialize(expected);
+        }
+
+        for (ulint threads: {1, 2})
+        {
+            bwt_construction bc = bwt_merge::merge(idx,batch,threads);
+
+            br_index<> merged(bc);
+            merged.set_sequences(all_starts,all_names,bc);
+
+            std::stringstream res;
+            merged.serialize(res);
+            IUTEST_ASSERT_EQ(expected.str(),res.str());
+        }
+    }
+}
+
+IUTEST(BrIndexTest, ShardedIndex)
+{
+    std::string s = repetitive_text();
+
+    br_index<> idx(s);
+    sharded_index<>::build(s,4,20,"test-tmp/sharded",build_config());
+
+    std::vector<std::string> patterns = {"A", "GCA", "TTACGATCGG", "GGCATCGACGTTGCAAGGCT", "CCCCCCCC"};
+    for (ulint i = 0; i < s.size(); i += 97) patterns.push_back(s.substr(i,15));
+
+    // shards served by threads and by child processes
+    for (bool processes: {false, true})
+    {
+        sharded_index<> shards("test-tmp/sharded.brs",processes);
+        IUTEST_ASSERT_EQ(4,shards.number_of_shards());
+        IUTEST_ASSERT_EQ(s.size(),shards.text_size());
+
+        for (auto& p: patterns)
+        {
+            for (ulint mis: {0, 1, 2})
+            {
+                auto expected = idx.locate_with_mismatch(p,mis);
+                std::sort(expected.begin(),expected.end());
+
+                IUTEST_ASSERT_EQ(expected,shards.locate(p,mis));
+                IUTEST_ASSERT_EQ(idx.count_with_mismatch(p,mis),shards.count(p,mis));
+            }
+        }
+
+        // occurrences across a shard boundary need the overlap
+        IUTEST_ASSERT_THROW(shards.count(s.substr(0,22)),std::invalid_argument);
+    }
+
+    // a shard that cannot be loaded fails at construction
+    IUTEST_ASSERT_THROW(shard_process<br_index<> >("test-tmp/missing.bri",10),std::runtime_error);
+    IUTEST_ASSERT_THROW(shard_thread<br_index<> >("test-tmp/missing.bri",10),std::runtime_error);
+}
+
+IUTEST(BrIndexTest, PrimitiveBenchmark)
+{
+    std::string s = repetitive_text();
+    br_index<> idx(s);
+
+    // cold passes of 10 queries, each after a flush
+    index_bench bench(100, 1, 1 << 16, nullptr, 10);
+    auto results = bench.run(idx);
+
+    // 13 primitives, 2 access patterns, 2 cache states
+    IUTEST_ASSERT_EQ(13 * 4,results.size());
+    for (auto& res: results) IUTEST_ASSERT_TRUE(res.ns_per_op >= 0);
+
+    std::stringstream json;
+    index_bench::write_json(json,"idx.bri",idx,100,results,nullptr,10);
+    std::string str = json.str();
+    IUTEST_ASSERT_TRUE(str.find("\"op\": \"predecessor_rank_circular\", \"access\": \"sequential\", \"cache\": \"cold\"") != std::string::npos);
+    IUTEST_ASSERT_TRUE(str.find("\"n\": " + std::to_string(s.size() + 1)) != std::string::npos);
+    IUTEST_ASSERT_TRUE(str.find("\"cold_ops\": 10,") != std::string::npos);
+}
+
+IUTEST(BrIndexTest, QueryStats)
+{
+    // run_tests is built with BRI_OP_COUNTERS
+    IUTEST_ASSERT_TRUE(query_stats::enabled);
+
+    std::string s;
+    std::string base = repetitive_text(1);
+    for (int i = 0; i < 10; ++i) s += base;
+
+    br_index<> idx(s);
+    std::string p = base.substr(3,12);
+
+    // exact search: an LF step, and two ranks, per character, no DFS
+    std::unordered_map<range_t,br_sample,range_hash> samples;
+    query_stats stats = query_stats::counted([&]() { samples = idx.search_with_mismatch(p,0); });
+    IUTEST_ASSERT_EQ(0,stats.dfs_nodes);
+    IUTEST_ASSERT_EQ(0,stats.phi_calls);
+    IUTEST_ASSERT_EQ(0,stats.plcp_lookups);
+    IUTEST_ASSERT_EQ(1,stats.hash_inserts);
+    IUTEST_ASSERT_LE(p.size(),stats.lf_calls);
+    IUTEST_ASSERT_LE(2*stats.lf_calls,stats.rank_calls);
+
+    // a Phi or PhiI step per occurrence after the first, plus at most two
+    // failing ones, each checked against PLCP
+    std::vector<ulint> occs;
+    stats = query_stats::counted([&]() { occs = idx.locate_samples(samples); });
+    IUTEST_ASSERT_EQ(10,occs.size());
+    IUTEST_ASSERT_EQ(0,stats.lf_calls);
+    IUTEST_ASSERT_LE(occs.size()-1,stats.phi_calls);
+    IUTEST_ASSERT_GE(occs.size()+1,stats.phi_calls);
+    IUTEST_ASSERT_LE(stats.phi_calls,stats.plcp_lookups);
+
+    stats = query_stats::counted([&]() { samples = idx.search_with_mismatch(p,2); });
+    IUTEST_ASSERT_LT(0,stats.dfs_nodes);
+    IUTEST_ASSERT_LT(0,stats.dfs_pruned);
+    IUTEST_ASSERT_LT(stats.dfs_nodes,stats.lf_calls);
+    IUTEST_ASSERT_LE(samples.size(),stats.hash_inserts);
+
+    // counters are per thread
+    query_stats::local().reset();
+    std::async(std::launch::async, [&]() { idx.search_with_mismatch(p,2); }).get();
+    IUTEST_ASSERT_EQ(0,query_stats::local().lf_calls);
+}
+
+IUTEST(BrIndexTest, SpaceTree)
+{
+    std::string s(">a\nACGTTGCAAGGCTTACGATCGGATCCTAG\n>b\nACGTTGCAAGGCTTACGATCGGTTCCTAG\n");
+    std::vector<ulint> starts;
+    std::vector<std::string> names;
+    sequence_boundaries<>::parse_fasta(s,starts,names);
+
+    br_index<> idx(s);
+    idx.set_sequences(starts,names);
+
+    // the footprint computed in memory is what serialize writes
+    std::ofstream out("test-tmp/space.bri");
+    ulint written = idx.serialize(out);
+    out.close();
+
+    space_node space = idx.space_tree();
+    IUTEST_ASSERT_EQ(written,space.bytes);
+    IUTEST_ASSERT_EQ(written,idx.size_in_bytes());
+    IUTEST_ASSERT_EQ(written,idx.get_space());
+
+    ulint children = 0;
+    for (auto& c: space.children) children += c.bytes;
+    IUTEST_ASSERT_LE(children,space.bytes);
+
+    IUTEST_ASSERT_TRUE(space.find("bwt/runs/select") != nullptr);
+    IUTEST_ASSERT_TRUE(space.find("plcp/ones") != nullptr);
+    IUTEST_ASSERT_TRUE(space.find("docs_first") != nullptr);
+    IUTEST_ASSERT_TRUE(space.find("bwt/nothing") == nullptr);
+    IUTEST_ASSERT_LT(0,space.support_bytes);
+    IUTEST_ASSERT_EQ(space.find("bwt/runs/select")->bytes,space.find("bwt/runs/select")->support_bytes);
+
+    std::stringstream json;
+    idx.write_space_json(json);
+    IUTEST_ASSERT_NE(std::string::npos,json.str().find("\"bits_per_run\""));
+    IUTEST_ASSERT_NE(std::string::npos,json.str().find("\"name\": \"samples_lastR\""));
+
+    br_index_nplcp<> idx_nplcp(s);
+    std::ofstream out_nplcp("test-tmp/space.brin");
+    written = idx_nplcp.serialize(out_nplcp);
+    IUTEST_ASSERT_EQ(written,idx_nplcp.size_in_bytes());
+    IUTEST_ASSERT_TRUE(idx_nplcp.space_tree().find("inv_order_last") != nullptr);
+}
+
+IUTEST(BrIndexTest, SearchBatch)
+{
+    std::string s;
+    std::string base = repetitive_text(1);
+    for (int i = 0; i < 5; ++i) s += base + base.substr(i, 7);
+
+    br_index<> idx(s);
+    br_index_nplcp<> idx_nplcp(s);
+
+    // all the 6-mers of the text, and some absent patterns
+    std::vector<std::string> patts;
+    for (ulint i = 0; i + 6 <= s.size(); i += 2) patts.push_back(s.substr(i, 6));
+    patts.push_back("ACGTAA");
+    patts.push_back("AAAAAAAA");
+    patts.push_back("TCG");
+
+    auto counts = idx.count_batch(patts);
+    auto locs = idx.locate_batch(patts);
+    auto samples = idx.search_batch(patts);
+    auto counts_nplcp = idx_nplcp.count_batch(patts);
+    auto samples_nplcp = idx_nplcp.search_batch(patts);
+    IUTEST_ASSERT_EQ(patts.size(),counts.size());
+
+    for (ulint i = 0; i < patts.size(); ++i)
+    {
+        IUTEST_ASSERT_EQ(idx.count(patts[i]),counts[i]);
+        IUTEST_ASSERT_EQ(idx.count(patts[i]),counts_nplcp[i]);
+
+        auto a = idx.locate(patts[i]);
+        std::sort(a.begin(),a.end());
+        std::sort(locs[i].begin(),locs[i].end());
+        IUTEST_ASSERT_EQ(a,locs[i]);
+
+        // full samples are those of backward_search
+        auto b = idx.backward_search(patts[i],0,patts[i].size()-1,idx.get_initial_sample());
+        IUTEST_ASSERT_EQ(b.is_invalid(),samples[i].is_invalid());
+        if (b.is_invalid()) continue;
+        IUTEST_ASSERT_EQ(b.range,samples[i].range);
+        IUTEST_ASSERT_EQ(b.rangeR,samples[i].rangeR);
+        IUTEST_ASSERT_EQ(b.j-b.d,samples[i].j-samples[i].d);
+        IUTEST_ASSERT_EQ(b.range,samples_nplcp[i].range);
+        IUTEST_ASSERT_EQ(b.rangeR,samples_nplcp[i].rangeR);
+    }
+    IUTEST_ASSERT_EQ(0,counts[patts.size()-2]);
+    IUTEST_ASSERT_EQ(s.size()+1,idx.count_batch({"","A"})[0]);
+
+    // the shared suffixes are searched once
+    ulint lf_single = query_stats::counted([&]() { for (auto& p: patts) idx.count(p); }).lf_calls;
+    ulint lf_batch = query_stats::counted([&]() { idx.count_batch(patts); }).lf_calls;
+    IUTEST_ASSERT_LT(lf_batch,lf_single);
+}
+
+IUTEST(BrIndexTest, KmerSpectrum)
+{
+    std::string s;
+    std::string base = repetitive_text(1);
+    for (int i = 0; i < 6; ++i) s += base.substr(0, 20 + i) + "N" + base.substr(i);
+
+    br_index<> idx(s);
+    br_index_nplcp<> idx_nplcp(s);
+    IUTEST_ASSERT_EQ(std::string("ACGNT"),idx.alphabet());
+
+    // all-symbol LF: the ranges of the right extensions, in order
+    std::vector<std::pair<uchar,range_t> > ext;
+    for (std::string p: {"", "A", "GC", "CTAG", "TTTT"})
+    {
+        br_sample sample(idx.get_initial_sample(true));
+        if (!p.empty()) sample = idx.forward_search(p,0,p.size()-1,sample);
+        idx.right_ranges(sample.rangeR,ext);
+
+        std::vector<std::pair<uchar,range_t> > expected;
+        if (!sample.is_invalid())
+        {
+            for (char c: idx.alphabet())
+            {
+                br_sample next = idx.right_extension(c,sample);
+                if (!next.is_invalid()) expected.push_back({(uchar)c,next.rangeR});
+            }
+        }
+        IUTEST_ASSERT_EQ(expected,ext);
+    }
+
+    for (ulint k: {1, 5, 12})
+    {
+        // the k-mers over ACGT, counted on the text
+        std::map<std::string,ulint> expected;
+        for (ulint i = 0; i + k <= s.size(); ++i)
+            if (s.substr(i,k).find('N') == std::string::npos) expected[s.substr(i,k)]++;
+
+        for (ulint threads: {1, 4})
+        {
+            kmer_spectrum<br_index<> > spectrum(idx,k,"ACGT");
+            std::vector<std::pair<std::string,ulint> > res;
+            spectrum.enumerate(threads,[&](ulint const* kmer, ulint count)
+            {
+                res.push_back({spectrum.get_codec().unpack(kmer),count});
+            });
+            std::vector<std::pair<std::string,ulint> > sorted(expected.begin(),expected.end());
+            IUTEST_ASSERT_EQ(sorted,res);
+            IUTEST_ASSERT_EQ(expected.size(),spectrum.distinct);
+        }
+
+        // count filters
+        kmer_spectrum<br_index_nplcp<> > filtered(idx_nplcp,k,"ACGT",2,5);
+        ulint n = 0;
+        filtered.enumerate(2,[&](ulint const* kmer, ulint count)
+        {
+            IUTEST_ASSERT_EQ(expected[filtered.get_codec().unpack(kmer)],count);
+            IUTEST_ASSERT_LE(2,count);
+            IUTEST_ASSERT_GE(5,count);
+            n++;
+        });
+        ulint m = 0;
+        for (auto& e: expected) m += e.second >= 2 && e.second <= 5;
+        IUTEST_ASSERT_EQ(m,n);
+    }
+
+    kmer_spectrum<br_index<> > spectrum(idx,8,"ACGNT");
+    IUTEST_ASSERT_EQ(spectrum.write("test-tmp/spectrum.brk",3),spectrum.distinct);
+    IUTEST_ASSERT_EQ(s.size()-7,spectrum.total);
+
+    kmer_file_reader in("test-tmp/spectrum.brk");
+    std::string kmer, prev;
+    ulint count, total = 0;
+    while (in.next(kmer,count))
+    {
+        IUTEST_ASSERT_LT(prev,kmer);
+        prev = kmer;
+        total += count;
+    }
+    IUTEST_ASSERT_EQ(s.size()-7,total);
+}
+
+template<class index_t>
+void check_paired_window(index_t& idx, std::string const& s, std::string const& unique, std::string const& repeat, ulint allowed)
+{
+    auto occurs = [&](std::string const& p, ulint i)
+    {
+        ulint mis = 0;
+        for (ulint k = 0; k < p.size(); ++k) mis += s[i+k] != p[k];
+        return mis <= allowed;
+    };
+
+    // occurrences with their rows, and the text around them
+    auto samples = idx.search_with_mismatch(unique,allowed);
+    std::vector<ulint> located;
+    for (auto& e: samples)
+    {
+        ulint row = e.second.range.first;
+        for (auto occ: idx.locate_rows(e.second))
+        {
+            IUTEST_ASSERT_EQ(row++,occ.second);
+            IUTEST_ASSERT_EQ(s.substr(occ.first,30),idx.extract(occ.second,30,true));
+            ulint len = std::min<ulint>(occ.first,30);
+            IUTEST_ASSERT_EQ(s.substr(occ.first-len,len),idx.extract(occ.second,30));
+            located.push_back(occ.first);
+        }
+        IUTEST_ASSERT_EQ(e.second.range.second+1,row);
+    }
+    std::sort(located.begin(),located.end());
+    std::vector<ulint> expected_occ;
+    for (ulint i = 0; i + unique.size() <= s.size(); ++i)
+        if (occurs(unique,i)) expected_occ.push_back(i);
+    IUTEST_ASSERT_EQ(expected_occ,located);
+
+    // the unique mate forward and the repetitive one reverse complemented, and vice versa
+    for (bool fwd: {true, false})
+    {
+        std::vector<mate_pair> res;
+        join_window(idx,samples,fwd,unique.size(),repeat,allowed,40,200,res);
+
+        std::string const& f_mate = fwd ? unique : repeat;
+        std::string const& r_mate = fwd ? repeat : unique;
+        std::vector<std::pair<ulint,ulint> > expected, pairs;
+        for (ulint f = 0; f + f_mate.size() <= s.size(); ++f)
+            for (ulint b = f; b + r_mate.size() <= s.size() && b + r_mate.size() <= f + 200; ++b)
+                if (b + r_mate.size() >= f + 40 && occurs(f_mate,f) && occurs(r_mate,b)) expected.push_back({f,b});
+        for (auto& h: res)
+        {
+            IUTEST_ASSERT_EQ(h.rev + r_mate.size() - h.fwd,h.insert);
+            pairs.push_back({h.fwd,h.rev});
+        }
+        IUTEST_ASSERT_EQ(expected,pairs);
+    }
+}
+
+IUTEST(BrIndexTest, PairedRepetitiveMate)
+{
+    // a unique mate, and a repetitive one occurring every 37 characters
+    std::string unique("GATTACAGGCTTCAGT");
+    std::string repeat("CCGTAAGT");
+    std::string s;
+    ulint x = 7;
+    for (ulint i = 0; s.size() < 1500; ++i)
+    {
+        if (i % 37 == 0) s += repeat;
+        else if (i == 400 || i == 1100) s += unique;
+        else
+        {
+            x = x * 1103515245 + 12345;
+            s.push_back("ACGT"[(x >> 16) % 4]);
+        }
+    }
+
+    br_index<> idx(s);
+    br_index_nplcp<> idx_nplcp(s);
+    for (ulint allowed: {0, 1})
+    {
+        check_paired_window(idx,s,unique,repeat,allowed);
+        check_paired_window(idx_nplcp,s,unique,repeat,allowed);
+    }
+}
@@ -0,0 +1,79 @@
+#include "iutest.hpp"
+#include <vector>
+#include <fstream>
+#include <string>
+
+#include "../src/fastx_reader.hpp"
+
+using namespace bri;
+
+IUTEST(FastxReaderTest, FastqChunks)
+{
+    {
+        std::ofstream ofs("test-tmp/fastx_reader_test.fq");
+        for (int i = 0; i < 10; ++i)
+            ofs << "@read" << i << "\nACGTACGT\n+\nIIIIIIII\n";
+    }
+
+    fastx_reader reader("test-tmp/fastx_reader_test.fq");
+    std::vector<read_record> chunk(4);
+
+    IUTEST_ASSERT_EQ(4,reader.read_chunk(chunk));
+    IUTEST_ASSERT_EQ("read0",chunk[0].id);
+    IUTEST_ASSERT_EQ("ACGTACGT",chunk[0].read);
+    IUTEST_ASSERT_EQ("IIIIIIII",chunk[0].qual);
+    IUTEST_ASSERT_EQ(4,reader.read_chunk(chunk));
+    IUTEST_ASSERT_EQ("read4",chunk[0].id);
+    IUTEST_ASSERT_EQ(2,reader.read_chunk(chunk));
+    IUTEST_ASSERT_EQ("read9",chunk[1].id);
+    IUTEST_ASSERT_EQ(0,reader.read_chunk(chunk));
+    IUTEST_ASSERT_EQ(reader.file_size(),reader.bytes_read());
+}
+
+IUTEST(FastxReaderTest, MultiLineFasta)
+{
+    {
+        std::ofstream ofs("test-tmp/fastx_reader_test.fa");
+        ofs << ">seq0 first\nACGT\nTTTT\n\n>seq1\nGG\n>seq2\nA\nC\nG";
+    }
+
+    fastx_reader reader("test-tmp/fastx_reader_test.fa");
+    std::vector<read_record> chunk(2);
+
+    IUTEST_ASSERT_EQ(2,reader.read_chunk(chunk));
+    IUTEST_ASSERT_EQ("seq0 first",chunk[0].id);
+    IUTEST_ASSERT_EQ("ACGTTTTT",chunk[0].read);
+    IUTEST_ASSERT_EQ("seq1",chunk[1].id);
+    IUTEST_ASSERT_EQ("GG",chunk[1].read);
+    IUTEST_ASSERT_EQ(1,reader.read_chunk(chunk));
+    IUTEST_ASSERT_EQ("seq2",chunk[0].id);
+    IUTEST_ASSERT_EQ("ACG",chunk[0].read);
+    IUTEST_ASSERT_EQ(0,reader.read_chunk(chunk));
+}
+
+IUTEST(FastxReaderTest, DoubleBufferedStream)
+{
+    {
+        std::ofstream ofs("test-tmp/fastx_reader_test2.fq");
+        for (int i = 0; i < 1000; ++i)
+            ofs << "@read" << i << "\n" << std::string(i % 50 + 1,'A') << "\n+\n" << std::string(i % 50 + 1,'I') << "\n";
+    }
+
+    fastx_stream stream("test-tmp/fastx_reader_test2.fq",7);
+    std::vector<read_record> const* chunk;
+
+    ulint total = 0;
+    while (ulint k = stream.next(chunk))
+    {
+        IUTEST_ASSERT_LE(k,7);
+        for (ulint i = 0; i < k; ++i)
+        {
+            IUTEST_ASSERT_EQ("read" + std::to_string(total),(*chunk)[i].id);
+            IUTEST_ASSERT_EQ(total % 50 + 1,(*chunk)[i].read.size());
+            total++;
+        }
+    }
+    IUTEST_ASSERT_EQ(1000,total);
+    IUTEST_ASSERT_EQ(100,stream.progress());
+    IUTEST_ASSERT_EQ(0,stream.next(chunk));
+}
@@ -0,0 +1,100 @@
+#include "iutest.hpp"
+#include <vector>
+#include <fstream>
+#include <string>
+
+#include "../src/gz_input.hpp"
+
+using namespace bri;
+
+std::string gz_test_text()
+{
+    std::string s;
+    for (int i = 0; i < 100000; ++i) s.push_back("ACGT\n"[(i * 7 + i / 13) % 5]);
+    return s;
+}
+
+/*
+ * write s as BGZF with blocks of block_size bytes and an empty EOF block
+ */
+void write_bgzf(std::string const& path, std::string const& s, size_t block_size)
+{
+    std::ofstream ofs(path, std::ios::binary);
+    for (size_t pos = 0; pos <= s.size(); pos += block_size)
+    {
+        std::string chunk = s.substr(pos, block_size);
+
+        z_stream zs;
+        std::memset(&zs, 0, sizeof(zs));
+        deflateInit2(&zs, 6, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+        std::vector<char> cdata(deflateBound(&zs, chunk.size()));
+        zs.next_in = (Bytef*)chunk.data();
+        zs.avail_in = chunk.size();
+        zs.next_out = (Bytef*)cdata.data();
+        zs.avail_out = cdata.size();
+        deflate(&zs, Z_FINISH);
+        cdata.resize(zs.total_out);
+        deflateEnd(&zs);
+
+        ulint bsize = 12 + 6 + cdata.size() + 8;
+        ulint crc = crc32(crc32(0L, Z_NULL, 0), (const Bytef*)chunk.data(), chunk.size());
+        uchar header[18] = {0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0,
+                            (uchar)((bsize - 1) & 0xff), (uchar)((bsize - 1) >> 8)};
+        uchar trailer[8] = {(uchar)crc, (uchar)(crc >> 8), (uchar)(crc >> 16), (uchar)(crc >> 24),
+                            (uchar)chunk.size(), (uchar)(chunk.size() >> 8), 0, 0};
+
+        ofs.write((char*)header, 18);
+        ofs.write(cdata.data(), cdata.size());
+        ofs.write((char*)trailer, 8);
+
+        if (chunk.empty()) break;
+    }
+}
+
+IUTEST(GzInputTest, PlainFile)
+{
+    std::string s = gz_test_text();
+    {
+        std::ofstream ofs("test-tmp/gz_input_test.txt");
+        ofs << s;
+    }
+
+    gz_input in("test-tmp/gz_input_test.txt");
+    IUTEST_ASSERT_EQ(false,in.is_compressed());
+    IUTEST_ASSERT_EQ(s,gz_input::read_all("test-tmp/gz_input_test.txt"));
+}
+
+IUTEST(GzInputTest, GzipFile)
+{
+    std::string s = gz_test_text();
+    {
+        gzFile gz = gzopen("test-tmp/gz_input_test.txt.gz","wb");
+        gzwrite(gz,s.data(),s.size());
+        gzclose(gz);
+    }
+
+    gz_input in("test-tmp/gz_input_test.txt.gz");
+    IUTEST_ASSERT_EQ(true,in.is_compressed());
+    IUTEST_ASSERT_EQ(false,in.is_bgzf());
+    IUTEST_ASSERT_EQ(s,gz_input::read_all("test-tmp/gz_input_test.txt.gz"));
+    IUTEST_ASSERT_EQ("test-tmp/gz_input_test.txt",gz_input::strip_ext("test-tmp/gz_input_test.txt.gz"));
+}
+
+IUTEST(GzInputTest, BgzfFileParallel)
+{
+    std::string s = gz_test_text();
+    write_bgzf("test-tmp/gz_input_test.bgz",s,100);
+
+    for (ulint threads = 1; threads <= 4; ++threads)
+    {
+        gz_input in("test-tmp/gz_input_test.bgz",threads);
+        IUTEST_ASSERT_EQ(true,in.is_bgzf());
+
+        std::string res;
+        std::vector<char> buf(333);
+        while (ulint len = in.read(buf.data(),buf.size())) res.append(buf.data(),len);
+
+        IUTEST_ASSERT_EQ(s,res);
+        IUTEST_ASSERT_EQ(in.file_size(),in.compressed_offset());
+    }
+}
@@ -0,0 +1,141 @@
+#include "iutest.hpp"
+#include <vector>
+#include <sstream>
+#include <string>
+
+#include "../src/interleaved_lcp.hpp"
+
+using namespace bri;
+
+/*
+ * SA, LCP and ILCP of text with a terminator smaller than all its
+ * characters, with the documents starting at starts
+ */
+void interleaved_lcp_of(std::string const& text, std::vector<ulint> const& starts,
+                        std::vector<ulint>& sa, std::vector<ulint>& lcp, std::vector<ulint>& doc, std::vector<ulint>& ilcp)
+{
+    std::string t = text + '\1';
+    ulint n = t.size();
+
+    sa.resize(n);
+    for (ulint i = 0; i < n; ++i) sa[i] = i;
+    std::sort(sa.begin(), sa.end(), [&](ulint a, ulint b) { return t.compare(a, n, t, b, n) < 0; });
+
+    auto common = [&](ulint a, ulint b)
+    {
+        ulint l = 0;
+        while (a + l < n && b + l < n && t[a+l] == t[b+l]) ++l;
+        return l;
+    };
+
+    lcp.assign(n, 0);
+    doc.assign(n, 0);
+    ilcp.assign(n, 0);
+    for (ulint i = 0; i < n; ++i)
+    {
+        if (i > 0) lcp[i] = common(sa[i-1], sa[i]);
+        doc[i] = std::upper_bound(starts.begin(), starts.end(), std::min(sa[i], n - 2)) - starts.begin() - 1;
+        for (ulint k = i; k-- > 0; )
+        {
+            if (doc[k] == doc[i])
+            {
+                ilcp[i] = common(sa[k], sa[i]);
+                break;
+            }
+        }
+    }
+}
+
+IUTEST(InterleavedLcpTest, RunsAndValues)
+{
+    // similar documents
+    std::string text;
+    std::vector<ulint> starts;
+    for (ulint d = 0; d < 5; ++d)
+    {
+        starts.push_back(text.size());
+        for (ulint i = 0; i < 60; ++i) text.push_back("ACGT"[(i * i + (i % (d + 4) == 0 ? d : 0)) % 4]);
+        text.push_back('#');
+    }
+
+    std::vector<ulint> sa, lcp, doc, expected;
+    interleaved_lcp_of(text, starts, sa, lcp, doc, expected);
+    ulint n = sa.size();
+
+    ulint i = 0;
+    interleaved_lcp<> ilcp(n, starts.size(), [&](ulint& s, ulint& l, ulint& d)
+    {
+        s = sa[i];
+        l = lcp[i];
+        d = doc[i];
+        i++;
+    });
+
+    std::stringstream ss;
+    ilcp.serialize(ss);
+    interleaved_lcp<> loaded;
+    loaded.load(ss);
+
+    ulint runs = 0;
+    for (ulint k = 0; k < n; ++k) runs += k == 0 || expected[k] != expected[k-1];
+    IUTEST_ASSERT_EQ(runs, loaded.runs());
+
+    for (ulint k = 0; k < n; ++k)
+    {
+        ulint run = loaded.run_of(k);
+        IUTEST_ASSERT_EQ(expected[k], loaded.value(run));
+        IUTEST_ASSERT_LE(loaded.head(run), k);
+        IUTEST_ASSERT_EQ(sa[loaded.head(run)], loaded.sample(run));
+    }
+
+    // the runs below m in a range of runs
+    for (ulint a = 0; a < runs; a += 3)
+    {
+        for (ulint b = a; b < runs; b += 5)
+        {
+            for (ulint m: {1, 2, 4, 8})
+            {
+                std::vector<ulint> res;
+                loaded.runs_below(a, b, m, [&](ulint k) { res.push_back(k); });
+
+                std::vector<ulint> brute;
+                for (ulint k = a; k <= b; ++k)
+                    if (loaded.value(k) < m) brute.push_back(k);
+                IUTEST_ASSERT_EQ(brute, res);
+            }
+        }
+    }
+}
+
+IUTEST(InterleavedLcpTest, FirstOccurrencePerDocument)
+{
+    std::string text;
+    std::vector<ulint> starts;
+    for (ulint d = 0; d < 4; ++d)
+    {
+        starts.push_back(text.size());
+        text += "GATTACA";
+        for (ulint i = 0; i < 20; ++i) text.push_back("ACGT"[(i * 3 + d * (i % 7 == 0)) % 4]);
+        text.push_back('#');
+    }
+
+    std::vector<ulint> sa, lcp, doc, ilcp;
+    interleaved_lcp_of(text, starts, sa, lcp, doc, ilcp);
+
+    // in the SA range of each pattern, the rows of ILCP below its length
+    // are one per document containing it
+    for (std::string p: {"A", "GATTACA", "CA", "TT", "ACG", "GA"})
+    {
+        std::vector<ulint> expected, listed;
+        for (ulint i = 0; i < sa.size(); ++i)
+        {
+            if (text.compare(std::min<ulint>(sa[i], text.size()), p.size(), p) != 0) continue;
+            expected.push_back(doc[i]);
+            if (ilcp[i] < p.size()) listed.push_back(doc[i]);
+        }
+        std::sort(expected.begin(), expected.end());
+        expected.erase(std::unique(expected.begin(), expected.end()), expected.end());
+        std::sort(listed.begin(), listed.end());
+        IUTEST_ASSERT_EQ(expected, listed);
+    }
+}
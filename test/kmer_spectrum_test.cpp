@@ -0,0 +1,74 @@
+#include "iutest.hpp"
+#include <vector>
+#include <string>
+
+#include "../src/kmer_spectrum.hpp"
+
+using namespace bri;
+
+IUTEST(KmerSpectrumTest, Codec)
+{
+    // 3 bits per character: the 22nd character straddles two words
+    kmer_codec codec("ACGTX", 30);
+    IUTEST_ASSERT_EQ(3u, codec.bits);
+    IUTEST_ASSERT_EQ(2u, codec.words);
+
+    std::string a = "ACGTXXGTCAACGTTGCAXTCAGTTXGCAT";
+    std::string b = "ACGTXXGTCAACGTTGCAXTCAGTTXGCTA";
+    std::vector<ulint> pa(2), pb(2);
+    codec.pack(a, pa.data());
+    codec.pack(b, pb.data());
+    IUTEST_ASSERT_EQ(a, codec.unpack(pa.data()));
+    IUTEST_ASSERT_EQ(b, codec.unpack(pb.data()));
+
+    // the order of the words is the order of the k-mers
+    IUTEST_ASSERT_TRUE(pa < pb);
+
+    kmer_codec dna("ACGT", 32);
+    IUTEST_ASSERT_EQ(2u, dna.bits);
+    IUTEST_ASSERT_EQ(1u, dna.words);
+
+    kmer_codec unary("A", 3);
+    IUTEST_ASSERT_EQ(1u, unary.bits);
+
+    IUTEST_ASSERT_THROW(kmer_codec("CA", 3), std::invalid_argument);
+    IUTEST_ASSERT_THROW(kmer_codec("", 3), std::invalid_argument);
+    IUTEST_ASSERT_THROW(kmer_codec("ACGT", 0), std::invalid_argument);
+}
+
+IUTEST(KmerSpectrumTest, File)
+{
+    kmer_codec codec("ACGT", 40);
+    std::vector<std::string> kmers = {"AAAACCCCGGGGTTTTAAAACCCCGGGGTTTTAAAACCCC",
+                                      "ACGTACGTACGTACGTACGTACGTACGTACGTACGTACGT",
+                                      "TTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTT"};
+
+    kmer_file_writer out("test-tmp/kmers.brk", codec);
+    std::vector<ulint> buf(codec.words);
+    for (ulint i = 0; i < kmers.size(); ++i)
+    {
+        codec.pack(kmers[i], buf.data());
+        out.write(buf.data(), i + 1);
+    }
+    out.close();
+
+    kmer_file_reader in("test-tmp/kmers.brk");
+    IUTEST_ASSERT_EQ(3u, in.size());
+    IUTEST_ASSERT_EQ(40u, in.get_codec().k);
+    IUTEST_ASSERT_EQ(std::string("ACGT"), in.get_codec().alphabet);
+
+    std::string kmer;
+    ulint count;
+    for (ulint i = 0; i < kmers.size(); ++i)
+    {
+        IUTEST_ASSERT_TRUE(in.next(kmer, count));
+        IUTEST_ASSERT_EQ(kmers[i], kmer);
+        IUTEST_ASSERT_EQ(i + 1, count);
+    }
+    IUTEST_ASSERT_FALSE(in.next(kmer, count));
+
+    std::ofstream bad("test-tmp/kmers.bad");
+    bad << "BRITRACE";
+    bad.close();
+    IUTEST_ASSERT_THROW(kmer_file_reader r("test-tmp/kmers.bad"), std::runtime_error);
+}
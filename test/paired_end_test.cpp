@@ -0,0 +1,74 @@
+#include "iutest.hpp"
+#include <vector>
+
+#include "../src/paired_end.hpp"
+
+using namespace bri;
+
+IUTEST(PairedEndTest, JoinInsertWindow)
+{
+    std::vector<ulint> fwd = {10, 100, 1000};
+    std::vector<ulint> rev = {5, 60, 150, 200, 1300};
+    std::vector<mate_pair> res;
+
+    // insert = rev + 50 - fwd in [100,200]
+    join_mates(fwd,rev,50,100,200,res);
+
+    IUTEST_ASSERT_EQ(4,res.size());
+    IUTEST_ASSERT_EQ(10,res[0].fwd);
+    IUTEST_ASSERT_EQ(60,res[0].rev);
+    IUTEST_ASSERT_EQ(100,res[0].insert);
+    IUTEST_ASSERT_EQ(150,res[1].rev);
+    IUTEST_ASSERT_EQ(190,res[1].insert);
+    IUTEST_ASSERT_EQ(100,res[2].fwd);
+    IUTEST_ASSERT_EQ(150,res[2].rev);
+    IUTEST_ASSERT_EQ(100,res[3].fwd);
+    IUTEST_ASSERT_EQ(200,res[3].rev);
+    IUTEST_ASSERT_EQ(150,res[3].insert);
+}
+
+IUTEST(PairedEndTest, JoinMatchesBruteForce)
+{
+    std::vector<ulint> fwd;
+    std::vector<ulint> rev;
+    for (ulint i = 0; i < 300; ++i)
+    {
+        if ((i * 37) % 11 < 3) fwd.push_back(i * 13);
+        if ((i * 53) % 7 < 2) rev.push_back(i * 11);
+    }
+
+    std::vector<mate_pair> res;
+    join_mates(fwd,rev,30,40,300,res);
+
+    std::vector<mate_pair> expected;
+    for (auto f: fwd)
+        for (auto b: rev)
+            if (b >= f && b + 30 >= f + 40 && b + 30 <= f + 300) expected.push_back({f, b, b + 30 - f});
+
+    IUTEST_ASSERT_EQ(expected.size(),res.size());
+    for (ulint i = 0; i < res.size(); ++i)
+    {
+        IUTEST_ASSERT_EQ(expected[i].fwd,res[i].fwd);
+        IUTEST_ASSERT_EQ(expected[i].rev,res[i].rev);
+        IUTEST_ASSERT_EQ(expected[i].insert,res[i].insert);
+    }
+}
+
+IUTEST(PairedEndTest, ScanMate)
+{
+    std::vector<ulint> res;
+    scan_mate("ACGTACGAACGT","ACGT",0,res);
+
+    std::vector<ulint> expected = {0, 8};
+    IUTEST_ASSERT_EQ(expected,res);
+
+    // and ACGA with one mismatch
+    res.clear();
+    scan_mate("ACGTACGAACGT","ACGT",1,res);
+    expected = {0, 4, 8};
+    IUTEST_ASSERT_EQ(expected,res);
+
+    res.clear();
+    scan_mate("ACG","ACGT",1,res);
+    IUTEST_ASSERT_EQ(0,res.size());
+}
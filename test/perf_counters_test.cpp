@@ -0,0 +1,51 @@
+#include "iutest.hpp"
+#include <vector>
+#include <string>
+#include <sstream>
+
+#include "../src/perf_counters.hpp"
+
+using namespace bri;
+
+IUTEST(PerfCountersTest, Disabled)
+{
+    perf_counters perf(false);
+    IUTEST_ASSERT_FALSE(perf.available());
+
+    perf.add("search", perf.now(), perf.now());
+    IUTEST_ASSERT_EQ(0,perf.calls("search"));
+
+    std::stringstream ss;
+    perf.print(ss);
+    IUTEST_ASSERT_EQ("",ss.str());
+}
+
+IUTEST(PerfCountersTest, Phases)
+{
+    // the counters may not be available here (no PMU, perf_event_paranoid)
+    perf_counters perf;
+    if (!perf.available())
+    {
+        IUTEST_ASSERT_NE("",perf.error());
+
+        std::stringstream ss;
+        perf.print(ss);
+        IUTEST_ASSERT_NE(std::string::npos,ss.str().find("not available"));
+        return;
+    }
+
+    std::vector<ulint> v(1 << 20, 1);
+    ulint sum = 0;
+    for (ulint k = 0; k < 3; ++k)
+    {
+        auto p1 = perf.now();
+        for (auto x: v) sum += x;
+        perf.add("sum", p1, perf.now());
+    }
+    IUTEST_ASSERT_EQ(3 << 20,sum);
+    IUTEST_ASSERT_EQ(3,perf.calls("sum"));
+    IUTEST_ASSERT_EQ(0,perf.calls("other"));
+
+    if (perf.available(perf_counters::INSTRUCTIONS))
+        IUTEST_ASSERT_LT(3 << 20,perf.total("sum",perf_counters::INSTRUCTIONS));
+}
@@ -0,0 +1,139 @@
+#include "iutest.hpp"
+#include <vector>
+#include <string>
+
+#include "../src/prefix_free_parse.hpp"
+#include "../src/permuted_lcp.hpp"
+
+using namespace bri;
+
+namespace {
+
+// identity remapping of the characters of the tests (all >= 2)
+std::vector<uchar> identity_remap()
+{
+    std::vector<uchar> remap(256,0);
+    for (ulint c = 2; c < 256; ++c) remap[c] = (uchar)c;
+    return remap;
+}
+
+// suffix array of s + terminator by sorting suffixes
+std::vector<ulint> naive_sa(std::string const& s)
+{
+    std::vector<ulint> sa(s.size() + 1);
+    for (ulint i = 0; i < sa.size(); ++i) sa[i] = i;
+    std::sort(sa.begin(), sa.end(), [&](ulint a, ulint b)
+    {
+        return s.compare(a, std::string::npos, s, b, std::string::npos) < 0;
+    });
+    return sa;
+}
+
+std::string repetitive_text(ulint n, ulint seed)
+{
+    std::string base;
+    for (ulint i = 0; i < 37; ++i) base.push_back("ACGT"[(i * i + seed) % 4]);
+
+    std::string s;
+    for (ulint i = 0; s.size() < n; ++i)
+    {
+        s += base;
+        // a few edits between the copies
+        base[(i * 13 + seed) % base.size()] = "ACGT"[(i + seed) % 4];
+    }
+    s.resize(n);
+    return s;
+}
+
+}
+
+IUTEST(PrefixFreeParseTest, BwtAndSamples)
+{
+    auto remap = identity_remap();
+
+    std::vector<std::string> texts = {
+        "A", "AB", "aaaaaaaaaaaaaaaaaaaa", "mississippi",
+        repetitive_text(500,1), repetitive_text(1000,2)
+    };
+
+    for (auto& s: texts)
+    {
+        for (bool reversed: {false, true})
+        {
+            std::string t = s;
+            if (reversed) std::reverse(t.begin(), t.end());
+            auto sa = naive_sa(t);
+
+            // expected BWT and samples, as sufsort computes them
+            std::string bwt;
+            for (auto x: sa) bwt.push_back(x > 0 ? t[x-1] : (char)prefix_free_parse::PADDING);
+
+            for (ulint w: {1, 3, 6})
+            {
+                for (ulint p: {2, 5, 11})
+                {
+                    prefix_free_parse parse(s,remap,reversed,w,p);
+
+                    std::vector<ulint> queries = {0, t.size() - 1, t.size() / 2};
+                    std::vector<ulint> rows;
+                    auto res = parse.bwt_and_samples(queries,rows);
+
+                    rle_string<> rle(std::get<0>(res));
+                    IUTEST_ASSERT_EQ(bwt.size(), rle.size());
+                    for (ulint i = 0; i < bwt.size(); ++i)
+                        IUTEST_ASSERT_EQ((uchar)bwt[i], rle[i]);
+
+                    auto& first = std::get<1>(res);
+                    auto& last = std::get<2>(res);
+                    ulint run = 0;
+                    for (ulint i = 0; i < sa.size(); ++i)
+                    {
+                        ulint sample = sa[i] > 0 ? sa[i] - 1 : sa.size() - 1;
+                        if (i == 0 || bwt[i] != bwt[i-1])
+                        {
+                            IUTEST_ASSERT_EQ(sample, first[run].first);
+                            IUTEST_ASSERT_EQ(run, first[run].second);
+                        }
+                        if (i == sa.size() - 1 || bwt[i] != bwt[i+1])
+                        {
+                            IUTEST_ASSERT_EQ(sample, last[run].first);
+                            run++;
+                        }
+                    }
+                    IUTEST_ASSERT_EQ(run, first.size());
+                    IUTEST_ASSERT_EQ(run, last.size());
+
+                    for (ulint i = 0; i < queries.size(); ++i)
+                        IUTEST_ASSERT_EQ(queries[i], sa[rows[i]]);
+                }
+            }
+        }
+    }
+}
+
+IUTEST(PrefixFreeParseTest, PlcpFromSamples)
+{
+    auto remap = identity_remap();
+
+    for (auto& s: {std::string("mississippi"), std::string("aaaaaaaaaa"), repetitive_text(800,3)})
+    {
+        auto sa = naive_sa(s);
+        std::vector<ulint> isa(sa.size());
+        for (ulint i = 0; i < sa.size(); ++i) isa[sa[i]] = i;
+
+        auto res = prefix_free_parse(s,remap,false,4,7).bwt_and_samples();
+        permuted_lcp<> plcp(s,std::get<1>(res),std::get<2>(res));
+
+        IUTEST_ASSERT_EQ(s.size() + 1, plcp.size());
+        for (ulint i = 0; i < sa.size(); ++i)
+        {
+            ulint lcp = 0;
+            if (isa[i] > 0)
+            {
+                ulint j = sa[isa[i]-1];
+                while (i + lcp < s.size() && j + lcp < s.size() && s[i+lcp] == s[j+lcp]) ++lcp;
+            }
+            IUTEST_ASSERT_EQ(lcp, plcp[i]);
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#include "iutest.hpp"
+#include <vector>
+#include <string>
+#include <sstream>
+
+#include "../src/query_stats.hpp"
+
+using namespace bri;
+
+IUTEST(QueryStatsTest, Buckets)
+{
+    // consecutive buckets, each within 1/64 of its values
+    ulint prev = 0;
+    for (ulint v = 1; v < (1ULL << 20); v += 1 + v / 100)
+    {
+        ulint b = latency_histogram::bucket_of(v);
+        IUTEST_ASSERT_LE(prev,b);
+        IUTEST_ASSERT_LE(v,latency_histogram::highest_value(b));
+        IUTEST_ASSERT_LE(latency_histogram::highest_value(b) - v,v / 64);
+        if (b > 0) IUTEST_ASSERT_LT(latency_histogram::highest_value(b-1),v);
+        prev = b;
+    }
+    IUTEST_ASSERT_EQ(~0ULL,latency_histogram::highest_value(latency_histogram::bucket_of(~0ULL)));
+}
+
+IUTEST(QueryStatsTest, Percentiles)
+{
+    latency_histogram h;
+    IUTEST_ASSERT_EQ(0,h.percentile(50));
+
+    for (ulint v = 1; v <= 100; ++v) h.record(v);
+    h.record(1000000);
+
+    IUTEST_ASSERT_EQ(101,h.count());
+    IUTEST_ASSERT_EQ(1000000,h.max());
+    IUTEST_ASSERT_EQ(51,h.percentile(50));
+    IUTEST_ASSERT_EQ(91,h.percentile(90));
+    IUTEST_ASSERT_EQ(100,h.percentile(99));
+    IUTEST_ASSERT_EQ(1000000,h.percentile(99.9));
+    IUTEST_ASSERT_EQ(1,h.percentile(0));
+
+    latency_histogram g;
+    for (ulint v = 101; v <= 199; ++v) g.record(v);
+    g.merge(h);
+    IUTEST_ASSERT_EQ(200,g.count());
+    IUTEST_ASSERT_EQ(1000000,g.max());
+    ulint p50 = g.percentile(50);
+    IUTEST_ASSERT_LE(100,p50);
+    IUTEST_ASSERT_GE(101,p50);
+}
+
+IUTEST(QueryStatsTest, Slowest)
+{
+    slowest_queries slow(3);
+    query_stats stats;
+    for (ulint i = 0; i < 10; ++i)
+    {
+        stats.dfs_nodes = i;
+        slow.push("read" + std::to_string(i) + " comment", '+', (i * 7) % 10, 1, i, stats);
+    }
+
+    auto res = slow.sorted();
+    IUTEST_ASSERT_EQ(3,res.size());
+    IUTEST_ASSERT_EQ("read7",res[0].id);
+    IUTEST_ASSERT_EQ(10,res[0].total());
+    IUTEST_ASSERT_EQ(7,res[0].stats.dfs_nodes);
+    IUTEST_ASSERT_EQ("read4",res[1].id);
+    IUTEST_ASSERT_EQ("read1",res[2].id);
+
+    // nothing is kept with k = 0
+    slowest_queries none;
+    none.push("read",'+',1,1,1,stats);
+    IUTEST_ASSERT_EQ(0,none.sorted().size());
+}
@@ -0,0 +1,89 @@
+#include "iutest.hpp"
+#include <vector>
+#include <string>
+#include <fstream>
+
+#include "../src/query_trace.hpp"
+
+using namespace bri;
+
+IUTEST(QueryTraceTest, WriteRead)
+{
+    std::vector<trace_record> records;
+    for (ulint i = 0; i < 100; ++i)
+    {
+        trace_record r;
+        r.op = i % 4 == 0 ? trace_record::COUNT : i % 4 == 1 ? trace_record::LOCATE
+             : i % 4 == 2 ? trace_record::DOCUMENTS : trace_record::SEED_EXTEND;
+        r.mismatches = i % 3;
+        r.m1 = i;
+        r.m2 = i * 1000;
+        r.occ = i * i * i * i * i * i * i;
+        r.start_ns = i << 40;
+        r.latency_ns = i == 99 ? ~0ULL : 127 + i;
+        r.pattern = std::string(i, "ACGT"[i % 4]);
+        records.push_back(r);
+    }
+
+    {
+        query_trace_writer w("test-tmp/trace");
+        for (auto& r: records) w.write(r);
+    }
+
+    auto res = query_trace_reader::read_all("test-tmp/trace");
+    IUTEST_ASSERT_EQ(records.size(),res.size());
+    for (ulint i = 0; i < res.size(); ++i)
+    {
+        IUTEST_ASSERT_EQ(records[i].op,res[i].op);
+        IUTEST_ASSERT_EQ(records[i].mismatches,res[i].mismatches);
+        IUTEST_ASSERT_EQ(records[i].m1,res[i].m1);
+        IUTEST_ASSERT_EQ(records[i].m2,res[i].m2);
+        IUTEST_ASSERT_EQ(records[i].occ,res[i].occ);
+        IUTEST_ASSERT_EQ(records[i].start_ns,res[i].start_ns);
+        IUTEST_ASSERT_EQ(records[i].latency_ns,res[i].latency_ns);
+        IUTEST_ASSERT_EQ(records[i].pattern,res[i].pattern);
+    }
+
+    // an empty trace
+    {
+        query_trace_writer w("test-tmp/trace");
+    }
+    IUTEST_ASSERT_EQ(0,query_trace_reader::read_all("test-tmp/trace").size());
+}
+
+IUTEST(QueryTraceTest, Malformed)
+{
+    {
+        std::ofstream out("test-tmp/trace");
+        out << "not a trace";
+    }
+    IUTEST_ASSERT_THROW(query_trace_reader::read_all("test-tmp/trace"),std::runtime_error);
+    IUTEST_ASSERT_THROW(query_trace_reader::read_all("test-tmp/no-trace"),std::runtime_error);
+
+    trace_record r;
+    r.pattern = "GATTACA";
+    {
+        query_trace_writer w("test-tmp/trace");
+        w.write(r);
+    }
+
+    // truncated record
+    std::string s;
+    {
+        std::ifstream in("test-tmp/trace");
+        s.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    {
+        std::ofstream out("test-tmp/trace");
+        out << s.substr(0, s.size() - 1);
+    }
+    IUTEST_ASSERT_THROW(query_trace_reader::read_all("test-tmp/trace"),std::runtime_error);
+
+    // unknown operation
+    s[9] = 'x';
+    {
+        std::ofstream out("test-tmp/trace");
+        out << s;
+    }
+    IUTEST_ASSERT_THROW(query_trace_reader::read_all("test-tmp/trace"),std::runtime_error);
+}
@@ -0,0 +1,87 @@
+#include "iutest.hpp"
+#include <vector>
+#include <string>
+
+#include "../src/read_cache.hpp"
+
+using namespace bri;
+
+static std::string reverse_complement(std::string s)
+{
+    std::reverse(s.begin(), s.end());
+    for (auto& c: s) c = c == 'A' ? 'T' : c == 'C' ? 'G' : c == 'G' ? 'C' : c == 'T' ? 'A' : c;
+    return s;
+}
+
+IUTEST(ReadCacheTest, FindInsert)
+{
+    read_cache cache(1 << 20);
+
+    std::string read = "TTGCA";
+    std::string rc = reverse_complement(read);
+
+    cached_read res;
+    IUTEST_ASSERT_FALSE(cache.find(read, rc, res));
+
+    cached_read value;
+    value.values[0] = {3, 7};
+    value.values[1] = {11};
+    value.occ[0] = 2;
+    value.occ[1] = 1;
+    cache.insert(read, rc, value);
+
+    IUTEST_ASSERT_TRUE(cache.find(read, rc, res));
+    IUTEST_ASSERT_EQ(value.values[0], res.values[0]);
+    IUTEST_ASSERT_EQ(value.values[1], res.values[1]);
+    IUTEST_ASSERT_EQ(2u, res.occ[0]);
+
+    // the reverse complement has the strands swapped
+    IUTEST_ASSERT_TRUE(cache.find(rc, read, res));
+    IUTEST_ASSERT_EQ(value.values[1], res.values[0]);
+    IUTEST_ASSERT_EQ(value.values[0], res.values[1]);
+    IUTEST_ASSERT_EQ(1u, res.occ[0]);
+    IUTEST_ASSERT_EQ(2u, res.occ[1]);
+
+    IUTEST_ASSERT_EQ(2u, cache.hits());
+    IUTEST_ASSERT_EQ(1u, cache.misses());
+    IUTEST_ASSERT_EQ(1u, cache.entries());
+
+    // not over ACGT: no reverse complement sharing
+    std::string n_read = "TTNCA";
+    cache.insert(n_read, reverse_complement(n_read), value);
+    IUTEST_ASSERT_TRUE(cache.find(n_read, reverse_complement(n_read), res));
+    IUTEST_ASSERT_FALSE(cache.find(reverse_complement(n_read), n_read, res));
+}
+
+IUTEST(ReadCacheTest, Eviction)
+{
+    const ulint budget = 64 << 10;
+    read_cache cache(budget, 4);
+
+    cached_read value;
+    value.values[0] = std::vector<ulint>(20, 1);
+    value.occ[0] = 20;
+
+    std::vector<std::string> reads;
+    for (ulint i = 0; i < 5000; ++i)
+    {
+        std::string read;
+        for (ulint j = i; read.size() < 24; j /= 4) read.push_back("ACGT"[j % 4]);
+        reads.push_back(read);
+        cache.insert(read, reverse_complement(read), value);
+        IUTEST_ASSERT_LE(cache.bytes(), budget);
+    }
+    IUTEST_ASSERT_LT(0u, cache.evictions());
+    IUTEST_ASSERT_EQ(5000u, cache.entries() + cache.evictions());
+
+    // the most recent reads are kept
+    cached_read res;
+    IUTEST_ASSERT_TRUE(cache.find(reads.back(), reverse_complement(reads.back()), res));
+    IUTEST_ASSERT_FALSE(cache.find(reads[0], reverse_complement(reads[0]), res));
+
+    // larger than a quarter of a shard
+    value.values[0] = std::vector<ulint>(budget / 16 / sizeof(ulint), 1);
+    cache.insert("ACGT", "ACGT", value);
+    IUTEST_ASSERT_EQ(1u, cache.too_large());
+    IUTEST_ASSERT_FALSE(cache.find("ACGT", "ACGT", res));
+}
@@ -21,6 +21,23 @@ IUTEST(RleStringTest, BasicStats)
     IUTEST_ASSERT_EQ(bytes, bytes2);
 }
 
+IUTEST(RleStringTest, SpaceTree)
+{
+    std::string s;
+    for (int i = 0; i < 1000; ++i) s.push_back("ACGT"[(i / 7) % 4]);
+    rle_string<> rl(s);
+
+    std::stringstream out;
+    ulint written = rl.serialize(out);
+
+    space_node space = rl.space_tree();
+    IUTEST_ASSERT_EQ(written, space.bytes);
+    IUTEST_ASSERT_EQ(written, rl.size_in_bytes());
+    IUTEST_ASSERT_EQ(space.find("runs")->bytes + space.find("runs_per_letter")->bytes + space.find("run_heads")->bytes
+                     + 3 * sizeof(ulint), space.bytes);
+    IUTEST_ASSERT_EQ(space.find("runs/select")->bytes, space.find("runs/select")->support_bytes);
+}
+
 IUTEST(RleStringTest, BasicRunAt)
 {
     std::string s;
@@ -266,4 +283,65 @@ IUTEST(RleStringTest, TwoCharTextOperations)
 
     }
 
-}
\ No newline at end of file
+}
+
+IUTEST(RleStringTest, Builder)
+{
+    std::string s;
+    rle_string_builder builder(4);
+    for (ulint i = 0; i < 300; ++i)
+    {
+        uchar c = "abcab"[i % 5];
+        ulint len = 1 + (i * 7) % 5;
+        s.append(len,c);
+
+        // pushes of the same character extend the current run
+        builder.push(c,len - 1);
+        builder.push(c);
+    }
+    IUTEST_ASSERT_EQ(s.size(),builder.size());
+
+    rle_string<> expected(s,4);
+    rle_string<> rl(builder);
+
+    IUTEST_ASSERT_EQ(expected.number_of_runs(),rl.number_of_runs());
+    for (ulint i = 0; i < s.size(); ++i)
+    {
+        IUTEST_ASSERT_EQ((uchar)s[i],rl[i]);
+        IUTEST_ASSERT_EQ(expected.rank(i,'b'),rl.rank(i,'b'));
+    }
+
+    std::stringstream s1, s2;
+    expected.serialize(s1);
+    rl.serialize(s2);
+    IUTEST_ASSERT_EQ(s1.str(),s2.str());
+}
+
+IUTEST(RleStringTest, IntervalSymbols)
+{
+    std::string s;
+    for (ulint i = 0; i < 200; ++i) s.append(1 + (i * 7) % 4, "abcad"[i % 5]);
+    rle_string<> rl(s,2);
+
+    std::vector<uchar> cs;
+    std::vector<ulint> rank_i, rank_j;
+    for (ulint i = 0; i <= s.size(); i += 7)
+    {
+        for (ulint j = i; j <= s.size() && j < i + 60; j += 3)
+        {
+            // the same characters and ranks as rank() on each of them
+            ulint k = rl.interval_symbols(i,j,cs,rank_i,rank_j);
+            std::string expected = s.substr(i,j-i);
+            std::sort(expected.begin(),expected.end());
+            expected.erase(std::unique(expected.begin(),expected.end()),expected.end());
+            IUTEST_ASSERT_EQ(expected.size(),k);
+
+            for (ulint t = 0; t < k; ++t)
+            {
+                IUTEST_ASSERT_NE(std::string::npos,expected.find((char)cs[t]));
+                IUTEST_ASSERT_EQ(rl.rank(i,cs[t]),rank_i[t]);
+                IUTEST_ASSERT_EQ(rl.rank(j,cs[t]),rank_j[t]);
+            }
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#include "iutest.hpp"
+#include <vector>
+#include <string>
+#include <fstream>
+
+#include "../src/sequence_boundaries.hpp"
+
+using namespace bri;
+
+IUTEST(SequenceBoundariesTest, ParseFasta)
+{
+    std::string s(">chr1 first\nACGT\nAC\n\n>chr2\r\nGG\r\n>chr3\nTTA");
+    std::vector<ulint> starts;
+    std::vector<std::string> names;
+    sequence_boundaries<>::parse_fasta(s,starts,names);
+
+    IUTEST_ASSERT_EQ("ACGTAC#GG#TTA",s);
+    IUTEST_ASSERT_EQ(3,starts.size());
+    IUTEST_ASSERT_EQ(0,starts[0]);
+    IUTEST_ASSERT_EQ(7,starts[1]);
+    IUTEST_ASSERT_EQ(10,starts[2]);
+    IUTEST_ASSERT_EQ("chr1",names[0]);
+    IUTEST_ASSERT_EQ("chr2",names[1]);
+    IUTEST_ASSERT_EQ("chr3",names[2]);
+}
+
+IUTEST(SequenceBoundariesTest, EmptySequence)
+{
+    // an empty last record would start at the end of the text
+    for (std::string s: {">a\nACGT\n>b\n", ">a\nACGT\n>b\n>c\nGT\n", ">a\n>b\nGT"})
+    {
+        std::vector<ulint> starts;
+        std::vector<std::string> names;
+        IUTEST_ASSERT_THROW(sequence_boundaries<>::parse_fasta(s,starts,names), std::runtime_error);
+    }
+}
+
+IUTEST(SequenceBoundariesTest, SequencePosition)
+{
+    std::vector<ulint> starts = {0,7,10};
+    std::vector<std::string> names = {"chr1","chr2","chr3"};
+    sequence_boundaries<> seqs(starts,names,13);
+
+    IUTEST_ASSERT_EQ(3,seqs.size());
+    IUTEST_ASSERT_EQ(0,seqs.sequence_of(5));
+    IUTEST_ASSERT_EQ(1,seqs.sequence_of(7));
+    IUTEST_ASSERT_EQ(2,seqs.sequence_of(12));
+    IUTEST_ASSERT_EQ(1,seqs.to_sequence_position(8).first);
+    IUTEST_ASSERT_EQ(1,seqs.to_sequence_position(8).second);
+    IUTEST_ASSERT_EQ(10,seqs.start(2));
+
+    std::ofstream out("test-tmp/sequence_boundaries_test.bin");
+    seqs.serialize(out);
+    out.close();
+
+    std::ifstream in("test-tmp/sequence_boundaries_test.bin");
+    sequence_boundaries<> loaded;
+    loaded.load(in);
+    IUTEST_ASSERT_EQ(3,loaded.size());
+    IUTEST_ASSERT_EQ("chr2",loaded.name(1));
+    IUTEST_ASSERT_EQ(2,loaded.to_sequence_position(12).first);
+    IUTEST_ASSERT_EQ(2,loaded.to_sequence_position(12).second);
+}
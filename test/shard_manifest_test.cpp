@@ -0,0 +1,65 @@
+#include "iutest.hpp"
+#include <vector>
+#include <string>
+#include <fstream>
+
+#include "../src/shard_manifest.hpp"
+
+using namespace bri;
+
+IUTEST(ShardManifestTest, Split)
+{
+    shard_manifest m(100,3,10,"dir/text");
+
+    IUTEST_ASSERT_EQ(3,m.size());
+    IUTEST_ASSERT_EQ(11,m.max_pattern_length());
+
+    ulint next = 0;
+    for (ulint i = 0; i < m.size(); ++i)
+    {
+        IUTEST_ASSERT_EQ("dir/text." + std::to_string(i) + ".bri",m[i].file);
+        IUTEST_ASSERT_EQ(next,m[i].start);
+        next += m[i].owned;
+
+        // the owned positions and the overlap, within the text
+        IUTEST_ASSERT_EQ(std::min<ulint>(m[i].owned + 10,100 - m[i].start),m[i].length);
+    }
+    IUTEST_ASSERT_EQ(100,next);
+
+    IUTEST_ASSERT_EQ(0,m.shard_of(0));
+    IUTEST_ASSERT_EQ(0,m.shard_of(m[1].start - 1));
+    IUTEST_ASSERT_EQ(1,m.shard_of(m[1].start));
+    IUTEST_ASSERT_EQ(2,m.shard_of(99));
+
+    IUTEST_ASSERT_THROW(shard_manifest(5,6,1,"text"),std::invalid_argument);
+    IUTEST_ASSERT_THROW(shard_manifest(5,0,1,"text"),std::invalid_argument);
+}
+
+IUTEST(ShardManifestTest, SaveLoad)
+{
+    shard_manifest m(1000,4,25,"test-tmp/shards");
+    m.save("test-tmp/shards.brs");
+
+    shard_manifest res;
+    res.load("test-tmp/shards.brs");
+
+    IUTEST_ASSERT_EQ(m.text_length,res.text_length);
+    IUTEST_ASSERT_EQ(m.overlap,res.overlap);
+    IUTEST_ASSERT_EQ(m.size(),res.size());
+    for (ulint i = 0; i < m.size(); ++i)
+    {
+        // shard files are relative to the manifest
+        IUTEST_ASSERT_EQ(m[i].file,res[i].file);
+        IUTEST_ASSERT_EQ(m[i].start,res[i].start);
+        IUTEST_ASSERT_EQ(m[i].owned,res[i].owned);
+        IUTEST_ASSERT_EQ(m[i].length,res[i].length);
+    }
+
+    // shards not covering the text
+    {
+        std::ofstream out("test-tmp/bad.brs");
+        out << "br-index shards\ntext_length 100\noverlap 5\nshards 2\n0 40 45 a.0.bri\n50 50 50 a.1.bri\n";
+    }
+    IUTEST_ASSERT_THROW(res.load("test-tmp/bad.brs"),std::runtime_error);
+    IUTEST_ASSERT_THROW(res.load("test-tmp/missing.brs"),std::runtime_error);
+}
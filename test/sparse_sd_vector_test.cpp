@@ -171,4 +171,37 @@ IUTEST(SparseSdVectorTest, NumberOfOne)
         bri::sparse_sd_vector bv(vec);
         IUTEST_ASSERT_EQ(bv.number_of_1(),3);
     }
-}
\ No newline at end of file
+}
+
+IUTEST(SparseSdVectorTest, FromPositions)
+{
+    std::vector<bool> vec(10000,false);
+    std::vector<ulint> ones;
+    for (ulint i = 3; i < vec.size(); i += 1 + i % 17)
+    {
+        vec[i] = true;
+        ones.push_back(i);
+    }
+
+    bri::sparse_sd_vector expected(vec);
+    bri::sparse_sd_vector bv(ones,vec.size());
+
+    IUTEST_ASSERT_EQ(expected.size(),bv.size());
+    IUTEST_ASSERT_EQ(expected.number_of_1(),bv.number_of_1());
+    for (size_t i = 0; i < bv.size(); ++i)
+    {
+        IUTEST_ASSERT_EQ(expected[i],bv[i]);
+        IUTEST_ASSERT_EQ(expected.rank(i),bv.rank(i));
+    }
+
+    // both constructions give the same structure
+    std::stringstream s1, s2;
+    expected.serialize(s1);
+    bv.serialize(s2);
+    IUTEST_ASSERT_EQ(s1.str(),s2.str());
+
+    std::vector<ulint> none;
+    bri::sparse_sd_vector empty(none,100);
+    IUTEST_ASSERT_EQ(100,empty.size());
+    IUTEST_ASSERT_EQ(0,empty.number_of_1());
+}
@@ -0,0 +1,89 @@
+#include "iutest.hpp"
+#include <vector>
+#include <string>
+#include <sstream>
+
+#include "../src/suffix_sort.hpp"
+#include "../src/synthetic_collection.hpp"
+
+using namespace bri;
+
+namespace {
+
+// text + terminator as sufsort expects it
+std::vector<uchar> terminated(std::string const& s)
+{
+    std::vector<uchar> t(s.begin(), s.end());
+    t.push_back(0);
+    return t;
+}
+
+std::vector<ulint> naive_sa(std::vector<uchar> const& t)
+{
+    std::vector<ulint> sa(t.size());
+    for (ulint i = 0; i < sa.size(); ++i) sa[i] = i;
+    std::sort(sa.begin(), sa.end(), [&](ulint a, ulint b)
+    {
+        return std::lexicographical_compare(t.begin() + a, t.end(), t.begin() + b, t.end());
+    });
+    return sa;
+}
+
+}
+
+IUTEST(SuffixSortTest, ParallelPrefixDoubling)
+{
+    std::string periodic;
+    for (int i = 0; i < 3000; ++i) periodic += "ACGTTGCA";
+
+    synthetic_config config;
+    config.length = 400;
+    config.copies = 19;
+    config.snp_rate = 0.01;
+    std::stringstream repetitive;
+    synthetic_collection(config).write_text(repetitive);
+
+    std::vector<std::string> texts = {
+        "", "A", "mississippi", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", "\xff\xfe\xff\xfe\x02", periodic, repetitive.str()
+    };
+
+    for (auto& s: texts)
+    {
+        auto t = terminated(s);
+        auto expected = naive_sa(t);
+
+        for (ulint threads: {1, 2, 5})
+            IUTEST_ASSERT_EQ(expected, parallel_suffix_sorter::sort(t,threads));
+    }
+}
+
+IUTEST(SuffixSortTest, CachedSuffixArray)
+{
+    std::string s = "ACGTACGTTTGACGTAACGTACGTTGA";
+
+    sdsl::int_vector<8> text(s.size());
+    for (ulint i = 0; i < s.size(); ++i) text[i] = (uchar)s[i];
+    sdsl::append_zero_symbol(text);
+
+    sdsl::cache_config cc(true, "test-tmp");
+    sdsl::store_to_cache(text, sdsl::conf::KEY_TEXT, cc);
+
+    parallel_suffix_sorter().sort(cc,3);
+
+    auto expected = naive_sa(terminated(s));
+    sdsl::int_vector_buffer<> sa(sdsl::cache_file_name(sdsl::conf::KEY_SA, cc));
+    IUTEST_ASSERT_EQ(expected.size(), sa.size());
+    for (ulint i = 0; i < sa.size(); ++i)
+        IUTEST_ASSERT_EQ(expected[i], (ulint)sa[i]);
+
+    sdsl::remove(sdsl::cache_file_name(sdsl::conf::KEY_TEXT, cc));
+    sdsl::remove(sdsl::cache_file_name(sdsl::conf::KEY_SA, cc));
+}
+
+IUTEST(SuffixSortTest, SemiExternal)
+{
+    // the fallback of the RAM budget is found by property, not by name
+    IUTEST_ASSERT_TRUE(sdsl_suffix_sorter(sdsl::SE_SAIS).semi_external());
+    IUTEST_ASSERT_FALSE(sdsl_suffix_sorter(sdsl::LIBDIVSUFSORT).semi_external());
+    IUTEST_ASSERT_FALSE(parallel_suffix_sorter().semi_external());
+}
@@ -0,0 +1,118 @@
+#include "iutest.hpp"
+#include <vector>
+#include <string>
+
+#include "../src/synthetic_collection.hpp"
+
+using namespace bri;
+
+IUTEST(SyntheticCollectionTest, Deterministic)
+{
+    synthetic_config config;
+    config.length = 5000;
+    config.copies = 5;
+    config.snp_rate = 0.01;
+    config.indel_rate = 0.005;
+    config.seed = 42;
+
+    synthetic_read_config rc;
+    rc.length = 50;
+    rc.indel_rate = 0.02;
+
+    synthetic_collection a(config), b(config);
+    IUTEST_ASSERT_EQ(6u, a.sequences().size());
+    IUTEST_ASSERT_TRUE(a.sequences() == b.sequences());
+    IUTEST_ASSERT_EQ(a.snps, b.snps);
+    IUTEST_ASSERT_LT(0u, a.snps);
+    IUTEST_ASSERT_LT(0u, a.indels);
+
+    // the copies differ from the base, but not much
+    for (ulint i = 1; i < a.sequences().size(); ++i)
+    {
+        auto& s = a.sequences()[i];
+        IUTEST_ASSERT_NE(a.sequences()[0], s);
+        IUTEST_ASSERT_LT(4500u, s.size());
+        IUTEST_ASSERT_LT(s.size(), 5500u);
+    }
+
+    for (ulint i = 0; i < 100; ++i)
+    {
+        auto r = a.next_read(rc);
+        IUTEST_ASSERT_EQ(r.seq, b.next_read(rc).seq);
+        IUTEST_ASSERT_EQ(rc.length, r.seq.size());
+    }
+
+    config.seed = 43;
+    synthetic_collection c(config);
+    IUTEST_ASSERT_NE(a.sequences()[0], c.sequences()[0]);
+}
+
+IUTEST(SyntheticCollectionTest, ExactCopies)
+{
+    synthetic_config config;
+    config.length = 2000;
+    config.copies = 3;
+    config.snp_rate = 0;
+    config.indel_rate = 0;
+    config.sigma = 20;
+
+    synthetic_collection coll(config);
+    auto sigma = synthetic_collection::alphabet(20);
+    for (auto& s: coll.sequences())
+    {
+        IUTEST_ASSERT_EQ(coll.sequences()[0], s);
+        IUTEST_ASSERT_EQ(std::string::npos, s.find_first_not_of(sigma));
+    }
+    IUTEST_ASSERT_EQ(8000u, coll.total_length());
+    IUTEST_ASSERT_EQ(0u, coll.snps + coll.indels);
+
+    // error-free reads are substrings at their position, never reversed
+    // outside ACGT
+    synthetic_read_config rc;
+    rc.length = 30;
+    rc.sub_rate = 0;
+    for (ulint i = 0; i < 100; ++i)
+    {
+        auto r = coll.next_read(rc);
+        IUTEST_ASSERT_FALSE(r.reverse);
+        IUTEST_ASSERT_EQ(coll.sequences()[r.sequence].substr(r.pos, rc.length), r.seq);
+    }
+
+    IUTEST_ASSERT_THROW(synthetic_collection::alphabet(1), std::invalid_argument);
+    config.snp_rate = 0.8;
+    config.indel_rate = 0.8;
+    IUTEST_ASSERT_THROW(synthetic_collection c(config), std::invalid_argument);
+}
+
+IUTEST(SyntheticCollectionTest, ReadMismatches)
+{
+    synthetic_config config;
+    config.length = 3000;
+    config.copies = 2;
+
+    synthetic_collection coll(config);
+
+    synthetic_read_config rc;
+    rc.length = 40;
+    rc.exact_subs = 3;
+    for (ulint i = 0; i < 100; ++i)
+    {
+        auto r = coll.next_read(rc);
+        IUTEST_ASSERT_EQ(3u, r.subs);
+
+        std::string fwd = r.seq;
+        if (r.reverse)
+        {
+            std::reverse(fwd.begin(), fwd.end());
+            for (auto& c: fwd) c = c == 'A' ? 'T' : c == 'C' ? 'G' : c == 'G' ? 'C' : 'A';
+        }
+
+        auto src = coll.sequences()[r.sequence].substr(r.pos, rc.length);
+        ulint diff = 0;
+        for (ulint j = 0; j < rc.length; ++j) diff += src[j] != fwd[j];
+        IUTEST_ASSERT_EQ(3u, diff);
+    }
+
+    rc.exact_subs = 41;
+    IUTEST_ASSERT_THROW(coll.next_read(rc), std::invalid_argument);
+}